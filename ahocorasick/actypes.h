@@ -22,6 +22,7 @@
 #define _AC_TYPES_H_
 
 #include <stdlib.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -40,6 +41,12 @@ extern "C" {
  */
 typedef char AC_ALPHABET_t;
 
+/**
+ * State number of a finalized trie. The states of a finalized trie are kept
+ * in a flat array and refer to each other by their numbers.
+ */
+typedef uint32_t ACT_STATE_t;
+
 /**
  * The text (strings of alphabets) type that is used for input/output when 
  * dealing with the A.C. Trie. The text can contain zero value alphabets. 
@@ -120,7 +127,11 @@ typedef enum ac_status
     ACERR_DUPLICATE_PATTERN,    /**< Duplicate patterns */
     ACERR_LONG_PATTERN,         /**< Pattern length is too long */
     ACERR_ZERO_PATTERN,         /**< Empty pattern (zero length) */
-    ACERR_TRIE_CLOSED       /**< Trie is closed. */
+    ACERR_TRIE_CLOSED,      /**< The trie does not take the pattern: the 
+                             * byte patterns of a wide trie, or the wide 
+                             * ones of a byte trie. Finalized tries take 
+                             * patterns */
+    ACERR_PATTERN_NOT_FOUND /**< The trie does not have the pattern */
 } AC_STATUS_t;
 
 /**
@@ -155,6 +166,24 @@ typedef void (*MF_REPLACE_CALBACK_f)(AC_TEXT_t *, void *);
 #error "REPLACEMENT_BUFFER_SIZE must be bigger than AC_PATTRN_MAX_LENGTH"
 #endif
 
+/**
+ * Number of the entries of a byte map; see ac_trie_create_mapped()
+ */
+#define AC_MAP_SIZE 256
+
+/**
+ * Number of the texts that ac_trie_search_batch() searches in lockstep
+ */
+#define AC_SEARCH_BATCH_LANES 8
+
+/**
+ * Number of the first alphabets of the patterns that a truncated trie 
+ * indexes; see AC_FINALIZE_TRUNCATE
+ */
+#ifndef AC_TRUNCATE_DEPTH
+#define AC_TRUNCATE_DEPTH 16
+#endif
+
 typedef enum act_working_mode
 {
     AC_WORKING_MODE_SEARCH = 0, /* Default */
@@ -162,6 +191,76 @@ typedef enum act_working_mode
     AC_WORKING_MODE_REPLACE     /* Not used */
 } ACT_WORKING_MODE_t;
 
+/**
+ * Finalize options. They can be OR'ed together and passed to
+ * ac_trie_finalize_opt()
+ */
+typedef enum act_finalize_option
+{
+    AC_FINALIZE_DEFAULT = 0x00, /**< Choose the engine and the prefilter 
+                                 * from the statistics of the patterns */
+    AC_FINALIZE_DFA = 0x01,     /**< Compile the trie into a full DFA 
+                                 * transition table; it needs 4 bytes per
+                                 * byte class per state */
+    AC_FINALIZE_SHIFT = 0x02,   /**< Skip the text by the Wu-Manber shift 
+                                 * table even if the patterns are short */
+    AC_FINALIZE_SPARSE = 0x04,  /**< Search by walking the trie, even if
+                                 * the DFA would be small enough */
+    AC_FINALIZE_NO_PREFILTER = 0x08, /**< Do not build any prefilter */
+    AC_FINALIZE_HUGE_PAGES = 0x10,  /**< Map the search structures on huge
+                                     * pages; see ac_trie_warmup() */
+    AC_FINALIZE_TRUNCATE = 0x20,    /**< Index only the first 
+                                     * AC_TRUNCATE_DEPTH alphabets of the 
+                                     * patterns and compare the rest of 
+                                     * them on the text. It is ignored if 
+                                     * any pattern has a replacement. */
+    AC_FINALIZE_MINIMIZE = 0x40     /**< Truncate the trie and merge the 
+                                     * rest of the patterns into a graph 
+                                     * that shares their common suffixes;
+                                     * only for search, it is ignored too
+                                     * if any pattern has a replacement */
+} ACT_FINALIZE_OPTION_t;
+
+/**
+ * The search engines of a finalized trie
+ */
+typedef enum ac_engine
+{
+    AC_ENGINE_NONE = 0,     /**< The trie is not finalized yet */
+    AC_ENGINE_SPARSE,       /**< Walks the compact trie and its failures */
+    AC_ENGINE_DFA           /**< Looks up the full DFA transition table */
+} AC_ENGINE_t;
+
+/**
+ * The prefilters that skip the text while the engine is in the root state
+ */
+typedef enum ac_prefilter
+{
+    AC_PREFILTER_NONE = 0,  /**< No prefilter */
+    AC_PREFILTER_BYTES,     /**< Looks for the bytes that start a pattern */
+    AC_PREFILTER_TEDDY,     /**< Looks for the fingerprints of the patterns */
+    AC_PREFILTER_SHIFT,     /**< Wu-Manber shift table */
+    AC_PREFILTER_MEMMEM     /**< Looks for the first and the last bytes of 
+                             * one to four patterns */
+} AC_PREFILTER_t;
+
+/**
+ * Statistics of the pattern set, gathered when the trie is finalized. They
+ * are used to choose the engine and the prefilter.
+ */
+typedef struct ac_statistics
+{
+    size_t patterns_count;  /**< Number of the patterns */
+    size_t min_length;      /**< Length of the shortest pattern */
+    size_t max_length;      /**< Length of the longest pattern */
+    double mean_length;     /**< Mean length of the patterns */
+    size_t distinct_bytes;  /**< Number of the bytes used in the patterns */
+    size_t start_bytes;     /**< Number of the bytes that start a pattern */
+    size_t states_count;    /**< Number of the trie states */
+    size_t max_fanout;      /**< Most edges of a state */
+    double mean_fanout;     /**< Mean edges of the non-leaf states */
+} AC_STATISTICS_t;
+
 
 #ifdef __cplusplus
 }
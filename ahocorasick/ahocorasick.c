@@ -23,16 +23,22 @@
 #include <string.h>
 
 #include "node.h"
+#include "arena.h"
+#include "dfa.h"
+#include "skip.h"
+#include "pages.h"
+#include "tail.h"
+#include "dawg.h"
+#include "image.h"
+#include "delta.h"
+#include "wide.h"
 #include "ahocorasick.h"
 #include "mpool.h"
 
 /* Privates */
 
-static void ac_trie_set_failure
-    (ACT_NODE_t *node, AC_ALPHABET_t *alphas);
-
-static void ac_trie_traverse_setfailure 
-    (ACT_NODE_t *node, AC_ALPHABET_t *prefix);
+static void ac_trie_set_failures 
+    (AC_TRIE_t *thiz);
 
 static void ac_trie_traverse_action 
     (ACT_NODE_t *node, void(*func)(ACT_NODE_t *), int top_down);
@@ -43,6 +49,83 @@ static void ac_trie_reset
 static int ac_trie_match_handler 
     (AC_MATCH_t * matchp, void * param);
 
+static void ac_trie_release_nodes 
+    (AC_TRIE_t *thiz);
+
+static AC_PATTERN_t *ac_trie_alloc_matches 
+    (const AC_TRIE_t *thiz);
+
+static AC_TRIE_t *ac_trie_load_image 
+    (struct act_image *image, int verify);
+
+static AC_STATUS_t ac_trie_add_pattern 
+    (AC_TRIE_t *thiz, AC_PATTERN_t *patt, int copy);
+
+static AC_STATUS_t ac_trie_remove_pattern 
+    (AC_TRIE_t *thiz, AC_PATTERN_t *patt);
+
+static int ac_trie_search_text (AC_TRIE_t *thiz, AC_TEXT_t *text, 
+        size_t *position, ACT_STATE_t *last_state, size_t base_position, 
+        AC_PATTERN_t *matches, ACT_TAILS_t *tails, ACT_DELTA_SEARCH_t *delta,
+        AC_MATCH_CALBACK_f callback, void *user);
+
+static int ac_trie_search_delta (AC_TRIE_t *thiz, AC_TEXT_t *text, 
+        size_t *position, ACT_STATE_t *last_state, size_t base_position, 
+        AC_PATTERN_t *matches, ACT_TAILS_t *tails, ACT_DELTA_SEARCH_t *delta,
+        AC_MATCH_CALBACK_f callback, void *user);
+
+static int ac_trie_report_delta (AC_MATCH_t *match, void *param);
+
+static int ac_trie_search_dfa (AC_TRIE_t *thiz, AC_TEXT_t *text, 
+        size_t *position, ACT_STATE_t *last_state, size_t base_position, 
+        AC_PATTERN_t *matches, ACT_TAILS_t *tails, 
+        AC_MATCH_CALBACK_f callback, void *user);
+
+static int ac_trie_search_tails (AC_TRIE_t *thiz, AC_TEXT_t *text, 
+        size_t *position, ACT_STATE_t *last_state, size_t base_position, 
+        AC_PATTERN_t *matches, ACT_TAILS_t *tails, 
+        AC_MATCH_CALBACK_f callback, void *user);
+
+static int ac_trie_follow_tails (AC_TRIE_t *thiz, AC_TEXT_t *text, 
+        size_t *position, ACT_STATE_t *last_state, size_t base_position, 
+        AC_PATTERN_t *matches, ACT_TAILS_t *tails, 
+        AC_MATCH_CALBACK_f callback, void *user);
+
+static int ac_trie_report_tails (const ACT_ARENA_t *arena, 
+        ACT_STATE_t state, AC_TEXT_t *text, size_t pos, size_t base_position,
+        AC_PATTERN_t *matches, ACT_TAILS_t *tails, 
+        AC_MATCH_CALBACK_f callback, void *user);
+
+static ACT_STATE_t ac_trie_step (const AC_TRIE_t *thiz, ACT_STATE_t state,
+        ACT_CLASS_t cls);
+
+static uint32_t ac_trie_find_pattern (const AC_TRIE_t *thiz, 
+        const AC_PATTERN_t *patt);
+
+static AC_TRIE_t *ac_trie_rebuild (const AC_TRIE_t *thiz);
+static void ac_trie_merge (AC_TRIE_t *thiz);
+
+static ACT_DELTA_SEARCH_t *ac_trie_sync_delta (const AC_TRIE_t *thiz, 
+        ACT_DELTA_SEARCH_t **delta);
+
+static int ac_trie_has_replacement (ACT_NODE_t *node);
+
+static void ac_trie_truncate (ACT_NODE_t *node, ACT_DAWG_t *dawg);
+
+static AC_ENGINE_t ac_trie_choose_engine (const AC_TRIE_t *thiz, 
+        int options);
+
+static int ac_trie_compare_visits (const void *l, const void *r);
+
+struct ac_batch_lane;
+static int ac_trie_batch_step (const AC_TRIE_t *thiz, 
+        struct ac_batch_lane *lane, AC_PATTERN_t *matches, 
+        AC_MATCH_CALBACK_f callback, void **params);
+
+static int ac_trie_report (const ACT_ARENA_t *arena, ACT_STATE_t state, 
+        size_t position, AC_PATTERN_t *matches, 
+        AC_MATCH_CALBACK_f callback, void *user);
+
 /* Friends */
 
 extern void mf_repdata_init (AC_TRIE_t *thiz);
@@ -60,10 +143,25 @@ AC_TRIE_t *ac_trie_create (void)
 {
     AC_TRIE_t *thiz = (AC_TRIE_t *) malloc (sizeof(AC_TRIE_t));
     thiz->mp = mpool_create(0);
+    thiz->nodes_mp = mpool_create(0);
     
     thiz->root = node_create (thiz);
+    thiz->arena = NULL;
+    thiz->dfa = NULL;
+    thiz->skip = NULL;
+    thiz->matches = NULL;
+    thiz->tails = NULL;
+    thiz->dawg = NULL;
+    thiz->image = NULL;
+    thiz->delta = NULL;
+    thiz->delta_search = NULL;
+    thiz->generation = 0;
+    thiz->options = AC_FINALIZE_DEFAULT;
+    memset (&thiz->stats, 0, sizeof(AC_STATISTICS_t));
     
     thiz->patterns_count = 0;
+    thiz->map = NULL;
+    thiz->wide = NULL;
     
     mf_repdata_init (thiz);
     ac_trie_reset (thiz);    
@@ -76,6 +174,90 @@ AC_TRIE_t *ac_trie_create (void)
     return thiz;
 }
 
+/**
+ * @brief Creates a trie that maps every byte of the patterns and the text
+ * by the given table
+ * 
+ * A text byte matches a pattern byte if the table maps them to the same 
+ * byte, so the table can fold the case or the accents, or merge a set of
+ * bytes into one symbol. The mapping is done on the fly, while the patterns
+ * are added and the text is searched; neither of them is changed. The 
+ * patterns are reported as they were added, and the positions are those of
+ * the original text. The patterns that map to the same bytes are 
+ * duplicates.
+ * 
+ * The table is a part of the automaton, so the search is as fast as that of
+ * a trie without it.
+ * 
+ * @param map the byte that every byte is mapped to; it is copied
+ * @return The trie
+ *****************************************************************************/
+AC_TRIE_t *ac_trie_create_mapped (const unsigned char map[AC_MAP_SIZE])
+{
+    AC_TRIE_t *thiz = ac_trie_create ();
+    
+    thiz->map = (unsigned char *) malloc (AC_MAP_SIZE);
+    memcpy (thiz->map, map, AC_MAP_SIZE);
+    
+    return thiz;
+}
+
+/**
+ * @brief Creates a trie that ignores the case of the ASCII letters
+ * 
+ * It is a mapped trie that maps the upper case letters to lower case; see
+ * ac_trie_create_mapped().
+ * 
+ * @return The trie
+ *****************************************************************************/
+AC_TRIE_t *ac_trie_create_nocase (void)
+{
+    unsigned char map[AC_MAP_SIZE];
+    unsigned int i;
+    
+    for (i = 0; i < AC_MAP_SIZE; i++)
+        map[i] = (i >= 'A' && i <= 'Z') ? i - 'A' + 'a' : i;
+    
+    return ac_trie_create_mapped (map);
+}
+
+/**
+ * @brief Creates a trie of wide symbols
+ * 
+ * The patterns and the text of a wide trie are arrays of 8, 16 or 32-bit 
+ * symbols, e.g. the code points of UTF-32 text or the ids of tokens, 
+ * instead of bytes. The patterns are added by ac_trie_add_wide() and 
+ * ac_trie_remove_wide(), and the text is searched by ac_trie_search_wide();
+ * the lengths and the positions are counted in symbols.
+ * 
+ * Every symbol of the patterns is given a class code of one to four bytes 
+ * when it is first added, and all the symbols that are in no pattern share 
+ * one. The trie holds the patterns as the strings of the codes of their 
+ * symbols, and the search runs over the codes of the text, so all the 
+ * engines, prefilters and finalize options apply as they are. The codes are
+ * prefix free, and the matches of the codes are the matches of the symbols.
+ * The first WIDE_CODES1 (111) distinct symbols have single byte codes: with
+ * as many, the search costs one transition per symbol, as in a byte trie. 
+ * The next 1024 have 2-byte codes, and a pattern set can have up to 
+ * WIDE_CODES_MAX distinct symbols in all. The codes of a pattern must fit 
+ * in AC_PATTRN_MAX_LENGTH bytes.
+ * 
+ * @param width bytes per symbol: 1, 2 or 4
+ * @return The trie, or NULL if the width is not one of them
+ *****************************************************************************/
+AC_TRIE_t *ac_trie_create_wide (size_t width)
+{
+    AC_TRIE_t *thiz;
+    
+    if (width != 1 && width != 2 && width != 4)
+        return NULL;
+    
+    thiz = ac_trie_create ();
+    thiz->wide = wide_create (width);
+    
+    return thiz;
+}
+
 /**
  * @brief Initializes the trie; allocates memories and sets initial values
  *
@@ -96,334 +278,1958 @@ AC_TRIE_t *ac_create_from_dict(char *dict_path)
  * @param copy should trie make a copy of patten strings or not, if not, 
  * then user must keep the strings valid for the life-time of the trie. If
  * the pattern are available in the user program then call the function with 
- * copy = 0 and do not waste memory.
+ * copy = 0 and do not waste memory. Note that ac_trie_finalize() reads the 
+ * pattern strings again to build the shift tables and the prefilters, so a 
+ * string that is not copied must not be freed or reused before that either.
+ * 
+ * A pattern can be added to a finalized trie too. It is always copied. It 
+ * is not searched until the trie is finalized again: the searches before 
+ * that do not find it. Finalizing builds only the patterns added since; see
+ * ac_trie_finalize().
  * 
- * @return The return value indicates the success or failure of adding action
+ * @return The return value indicates the success or failure of adding action;
+ * ACERR_TRIE_CLOSED only for a trie of wide symbols, as a finalized trie 
+ * takes the pattern.
  *****************************************************************************/
 AC_STATUS_t ac_trie_add (AC_TRIE_t *thiz, AC_PATTERN_t *patt, int copy)
 {
-    size_t i;
-    ACT_NODE_t *n = thiz->root;
-    ACT_NODE_t *next;
-    AC_ALPHABET_t alpha;
+    if (thiz->wide)
+        return ACERR_TRIE_CLOSED;   /* It takes ac_trie_add_wide() */
+    
+    return ac_trie_add_pattern (thiz, patt, copy);
+}
+
+/**
+ * @brief Removes the pattern of the same text from the trie
+ * 
+ * In a trie that is not finalized, the node of the pattern stops accepting
+ * it, and the branch that is left without any pattern is cut off.
+ * 
+ * In a finalized trie, the removal is built in when the trie is finalized 
+ * again, as the additions are; see ac_trie_finalize(). The patterns are 
+ * flagged, and the search skips them. Their states are reclaimed when the 
+ * trie is rebuilt: when the delta has cost as much as a rebuild, when more 
+ * patterns are removed than left, or by ac_trie_compact().
+ * 
+ * @param thiz pointer to the trie
+ * @param patt the pattern; only its text is used
+ * @return ACERR_SUCCESS, or ACERR_PATTERN_NOT_FOUND if the trie does not 
+ * have the pattern, or ACERR_TRIE_CLOSED for a trie of wide symbols
+ *****************************************************************************/
+AC_STATUS_t ac_trie_remove (AC_TRIE_t *thiz, AC_PATTERN_t *patt)
+{
+    if (thiz->wide)
+        return ACERR_TRIE_CLOSED;   /* It takes ac_trie_remove_wide() */
+    
+    return ac_trie_remove_pattern (thiz, patt);
+}
+
+/**
+ * @brief Adds a pattern of wide symbols to the trie
+ * 
+ * The symbols are copied. As with ac_trie_add(), a pattern can be added to
+ * a finalized trie too, and it is searched after the trie is finalized 
+ * again.
+ * 
+ * @param thiz pointer to a trie made by ac_trie_create_wide()
+ * @param symbols array of the symbols of the width of the trie
+ * @param length number of the symbols
+ * @param id the id that the matches report
+ * @return ACERR_SUCCESS, ACERR_ZERO_PATTERN, ACERR_DUPLICATE_PATTERN, 
+ * ACERR_LONG_PATTERN if the codes of the symbols are longer than 
+ * AC_PATTRN_MAX_LENGTH or the trie has no code left for a new symbol, or 
+ * ACERR_TRIE_CLOSED if the trie is not a wide one
+ *****************************************************************************/
+AC_STATUS_t ac_trie_add_wide (AC_TRIE_t *thiz, const void *symbols, 
+        size_t length, AC_PATTID_t id)
+{
+    AC_PATTERN_t patt;
+    AC_STATUS_t status;
     
-    if(!thiz->trie_open)
+    if (!thiz->wide)
         return ACERR_TRIE_CLOSED;
     
-    if (!patt->ptext.length)
+    if (!length)
         return ACERR_ZERO_PATTERN;
     
-    if (patt->ptext.length > AC_PATTRN_MAX_LENGTH)
-        return ACERR_LONG_PATTERN;
+    if ((status = wide_encode_pattern (thiz->wide, symbols, length, 1, 
+            &patt.ptext)) != ACERR_SUCCESS)
+        return status;
     
-    for (i = 0; i < patt->ptext.length; i++)
+    patt.rtext.astring = NULL;
+    patt.rtext.length = 0;
+    patt.id = id;
+    
+    return ac_trie_add_pattern (thiz, &patt, 1);
+}
+
+/**
+ * @brief Removes the pattern of the same symbols from a wide trie
+ * 
+ * It is the ac_trie_remove() of the wide tries.
+ * 
+ * @param thiz pointer to a trie made by ac_trie_create_wide()
+ * @param symbols array of the symbols of the width of the trie
+ * @param length number of the symbols
+ * @return ACERR_SUCCESS, ACERR_PATTERN_NOT_FOUND, or ACERR_TRIE_CLOSED if 
+ * the trie is not a wide one
+ *****************************************************************************/
+AC_STATUS_t ac_trie_remove_wide (AC_TRIE_t *thiz, const void *symbols, 
+        size_t length)
+{
+    AC_PATTERN_t patt;
+    
+    if (!thiz->wide)
+        return ACERR_TRIE_CLOSED;
+    
+    /* A symbol that has no code is in no pattern */
+    if (!length || wide_encode_pattern (thiz->wide, symbols, length, 0, 
+            &patt.ptext) != ACERR_SUCCESS)
+        return ACERR_PATTERN_NOT_FOUND;
+    
+    return ac_trie_remove_pattern (thiz, &patt);
+}
+
+/**
+ * @brief Finalizes the preprocessing stage and gets the trie ready
+ * 
+ * Locates the failure node for all nodes and collects all matched 
+ * pattern for each node. It also sorts outgoing edges of node, so binary 
+ * search could be performed on them. After calling this function the automate 
+ * will be finalized.
+ * 
+ * Finalizing a finalized trie builds in the patterns that are added since. 
+ * They are kept in a small trie of their own, the delta; the text is 
+ * scanned for it in a pass of its own, while the main trie keeps its search
+ * loop. So the cost of finalizing depends on the added patterns, not on the
+ * whole trie, and the search does not change until the first pattern is 
+ * added. When finalizing the delta and scanning for it have cost as much as
+ * rebuilding the trie, or the delta has a pattern with a replacement, both 
+ * are rebuilt into one trie with the original options, by the next 
+ * finalize. A search that goes on over chunks keeps its state when the 
+ * delta is built again, and finds the patterns that are added since from 
+ * there on; the ones that span that point too, if the trie had a delta 
+ * already. It starts over when the trie is rebuilt. No search may run 
+ * while the trie is finalized.
+ * 
+ * The patterns that are removed from a finalized trie are built in the same
+ * way; see ac_trie_remove().
+ * 
+ * @param thiz pointer to the trie
+ *****************************************************************************/
+void ac_trie_finalize (AC_TRIE_t *thiz)
+{
+    ac_trie_finalize_opt (thiz, AC_FINALIZE_DEFAULT);
+}
+
+/**
+ * @brief Finalizes the trie with the given options
+ * 
+ * Does the same as ac_trie_finalize(). Then it gathers the statistics of the
+ * patterns, and builds the search engine and the prefilter that suit them, 
+ * unless @p options forces them. With AC_FINALIZE_TRUNCATE, the trie is cut 
+ * below AC_TRUNCATE_DEPTH first; with AC_FINALIZE_MINIMIZE, the cut tails
+ * are also merged into a minimized graph.
+ * 
+ * The options of a finalized trie can not be changed; they are ignored when
+ * it is finalized again.
+ * 
+ * @param thiz pointer to the trie
+ * @param options OR'ed values of ACT_FINALIZE_OPTION_t
+ *****************************************************************************/
+void ac_trie_finalize_opt (AC_TRIE_t *thiz, int options)
+{
+    if (!thiz->trie_open)
     {
-        alpha = patt->ptext.astring[i];
-        if ((next = node_find_next (n, alpha)))
+        /* Build in the patterns that are added since, or merge the delta 
+         * that has cost as much as a merge */
+        if (!thiz->delta)
+            return;
+        
+        if (delta_must_merge (thiz->delta, thiz->arena, thiz->patterns_count))
         {
-            n = next;
-            continue;
+            ac_trie_merge (thiz);
+            thiz->generation++;
         }
-        else
+        else if (thiz->delta->stale)
         {
-            next = node_create_next (n, alpha);
-            next->depth = n->depth + 1;
-            n = next;
+            delta_refresh (thiz->delta);
+            thiz->arena->removed = thiz->delta->removed;
         }
+        return;
     }
     
-    if(n->final)
-        return ACERR_DUPLICATE_PATTERN;
+    thiz->options = options;
+    
+    if ((options & (AC_FINALIZE_TRUNCATE | AC_FINALIZE_MINIMIZE)) && 
+            !ac_trie_has_replacement (thiz->root))
+    {
+        if (options & AC_FINALIZE_MINIMIZE)
+            thiz->dawg = dawg_create ();
+        
+        ac_trie_truncate (thiz->root, thiz->dawg);
+        
+        if (thiz->dawg && !thiz->dawg->states_count)
+        {
+            /* No pattern was long enough */
+            dawg_release (thiz->dawg);
+            thiz->dawg = NULL;
+        }
+        else if (thiz->dawg)
+        {
+            dawg_close (thiz->dawg, options & AC_FINALIZE_HUGE_PAGES);
+        }
+    }
+    
+    ac_trie_set_failures (thiz);
+    mf_repdata_allocbuf (&thiz->repdata);
+    
+    /* Convert the trie into the flat search structure. The nodes are not 
+     * needed anymore. */
+    thiz->arena = arena_create (thiz, options);
+    ac_trie_release_nodes (thiz);
+    thiz->matches = ac_trie_alloc_matches (thiz);
+    if (thiz->arena->tails_count)
+        thiz->tails = tails_create (thiz->arena, thiz->dawg, thiz->map);
+    
+    arena_statistics (thiz->arena, &thiz->stats);
+    thiz->skip = skip_create (thiz->arena, &thiz->stats, thiz->map, 
+            options);
+    
+    if (ac_trie_choose_engine (thiz, options) == AC_ENGINE_DFA)
+        thiz->dfa = dfa_create (thiz->arena, options);
+    
+    thiz->trie_open = 0; /* Do not accept patterns any more */
+}
+
+
+/**
+ * @brief Brings the search structures of the finalized trie into the memory
+ * 
+ * Touches every page of the search structures, so the first searches after
+ * finalizing or loading the trie do not pay for the page faults. If @p lock
+ * is set, the pages are also locked in the memory, so they can not be 
+ * swapped out; this may need a raised RLIMIT_MEMLOCK.
+ * 
+ * @param thiz pointer to the trie
+ * @param lock
+ * @return 0: success, -1: the trie is not finalized, -2: failed to lock
+ *****************************************************************************/
+int ac_trie_warmup (AC_TRIE_t *thiz, int lock)
+{
+    int failed = 0;
+    
+    if (thiz->trie_open)
+        return -1;
+    
+    failed |= pages_warm (thiz->arena->block, thiz->arena->block_size, lock);
+    
+    if (thiz->dfa)
+        failed |= pages_warm (thiz->dfa->delta, thiz->dfa->states_count * 
+                thiz->dfa->stride * sizeof(uint32_t), lock);
+    
+    if (thiz->dawg)
+        failed |= pages_warm (thiz->dawg->block, thiz->dawg->block_size, 
+                lock);
+    
+    if (thiz->skip)
+    {
+        failed |= pages_warm (thiz->skip, sizeof(ACT_SKIP_t), lock);
+        if (thiz->skip->shifts)
+        {
+            failed |= pages_warm (thiz->skip->shifts, 
+                    SKIP_SHIFT_TABLE_SIZE, lock);
+            failed |= pages_warm (thiz->skip->prefixes, 
+                    SKIP_SHIFT_TABLE_SIZE / 8, lock);
+        }
+    }
+    
+    return failed ? -2 : 0;
+}
+
+/**
+ * The visit count of a state, used by ac_trie_optimize()
+ */
+struct ac_visit
+{
+    uint64_t count;     /**< Number of visits */
+    uint32_t state;     /**< The state */
+};
+
+/**
+ * @brief Renumbers the states of the finalized trie by a sample input
+ * 
+ * Walks the trie over the sample texts and counts the visits of every 
+ * state. Then the states are laid out again in the order of their visit
+ * counts, so the states that the search touches most are packed together 
+ * in the fewest cache lines. The states that are never visited keep their
+ * BFS order after them. The search results do not change.
+ * 
+ * It must be called before searching, replacing or sharing the trie. The 
+ * search payloads that are made before start their next search over, as 
+ * after finalizing the trie again.
+ * 
+ * @param thiz pointer to the trie
+ * @param samples array of the sample texts
+ * @param count number of the sample texts
+ * @return 0: success, -1: the trie is not finalized, or it is a wide one
+ *****************************************************************************/
+int ac_trie_optimize (AC_TRIE_t *thiz, AC_TEXT_t *samples, size_t count)
+{
+    ACT_ARENA_t *arena = thiz->arena;
+    struct ac_visit *visits;
+    uint32_t *order;
+    size_t i, pos;
+    ACT_STATE_t current, next;
+    ACT_CLASS_t cls;
+    int huge;
+    
+    if (thiz->trie_open || thiz->wide)
+        return -1;
+    
+    visits = (struct ac_visit *) malloc 
+            (arena->states_count * sizeof(struct ac_visit));
+    for (i = 0; i < arena->states_count; i++)
+    {
+        visits[i].count = 0;
+        visits[i].state = i;
+    }
+    
+    for (i = 0; i < count; i++)
+    {
+        current = ARENA_ROOT;
+        
+        for (pos = 0; pos < samples[i].length; pos++)
+        {
+            cls = ARENA_CLASS(arena, samples[i].astring[pos]);
+            
+            if (cls == arena->void_class)
+            {
+                current = ARENA_ROOT;
+                continue;
+            }
+            
+            while ((next = arena_find_next (arena, current, cls)) == 
+                    ARENA_NONE && current != ARENA_ROOT)
+            {
+                visits[current].count++;
+                current = ARENA_FAILURE(arena, current);
+            }
+            
+            visits[current].count++;
+            current = (next == ARENA_NONE) ? ARENA_ROOT : next;
+        }
+    }
+    
+    /* The root stays the first state; the chain states keep their place
+     * after the explicit states */
+    qsort (&visits[1], arena->chain_base - 1, sizeof(struct ac_visit), 
+            ac_trie_compare_visits);
+    
+    order = (uint32_t *) malloc (arena->chain_base * sizeof(uint32_t));
+    for (i = 0; i < arena->chain_base; i++)
+        order[i] = visits[i].state;
+    
+    arena_reorder (arena, order);
+    
+    /* The state numbers of the search payloads are not valid any more */
+    thiz->generation++;
+    
+    if (thiz->dfa)
+    {
+        huge = thiz->dfa->delta_mapped == PAGES_MAPPED;
+        dfa_release (thiz->dfa);
+        thiz->dfa = dfa_create (arena, huge ? AC_FINALIZE_HUGE_PAGES : 0);
+    }
+    
+    ac_trie_reset (thiz);
+    
+    free (order);
+    free (visits);
+    
+    return 0;
+}
+
+/**
+ * @brief Writes the image of the finalized trie to a file
+ * 
+ * The image can be loaded by ac_trie_load() in any process, without adding
+ * and finalizing the patterns again; see image.h for its format. The 
+ * patterns are written with their texts and ids. The patterns that are 
+ * added after finalizing are merged into the trie first.
+ * 
+ * @param thiz pointer to the trie
+ * @param path the file
+ * @return 0: success, -1: the trie is not finalized, or it is a wide one,
+ * -2: failed to write
+ *****************************************************************************/
+int ac_trie_save (AC_TRIE_t *thiz, const char *path)
+{
+    FILE *file;
+    int failed;
+    
+    if (thiz->trie_open || thiz->wide)
+        return -1;
+    
+    if (thiz->delta)
+    {
+        ac_trie_merge (thiz);
+        thiz->generation++;
+    }
+    
+    if (!(file = fopen (path, "wb")))
+        return -2;
+    
+    failed = image_save (thiz, file);
+    failed |= fclose (file);
+    
+    return failed ? -2 : 0;
+}
+
+/**
+ * @brief Loads a finalized trie from the image written by ac_trie_save()
+ * 
+ * The file is mapped read-only, and the search structures are used in 
+ * place: they are not copied, and the processes that load the same file 
+ * share its pages. Every index in the search structures is range checked
+ * on loading, so that a damaged image fails to load instead of making the
+ * search read out of bounds; this reads the states, the DFA table and the
+ * minimized tails once. The file must not be changed while the trie is in
+ * use.
+ * 
+ * The loaded trie is finalized; it is searched, replaced and released as
+ * usual.
+ * 
+ * @param path the file
+ * @param verify compare the checksums of the whole image too; it reads 
+ * every page of the file, and finds the damage that leaves the indices in
+ * range, as in the patterns. The header and the indices are checked anyway.
+ * @return The trie, or NULL if the file can not be read or is not a valid
+ * image
+ *****************************************************************************/
+AC_TRIE_t *ac_trie_load (const char *path, int verify)
+{
+    ACT_IMAGE_t *image;
+    
+    if (!(image = image_open (path)))
+        return NULL;
+    
+    return ac_trie_load_image (image, verify);
+}
+
+/**
+ * @brief Publishes the finalized trie as a named shared memory object
+ * 
+ * The image of the trie (see ac_trie_save()) is written into a new POSIX 
+ * shared memory object, which any process of the host can attach to by 
+ * ac_trie_attach(). The attached tries share a single copy of the search
+ * structures, however many processes use them. An object of the same name
+ * is replaced; the tries that are attached to it keep using the old one.
+ * 
+ * The patterns that are added after finalizing are merged into the trie 
+ * first. For a file-backed segment, use ac_trie_save() and ac_trie_load(); 
+ * the processes that load the same file share its pages too.
+ * 
+ * @param thiz pointer to the trie
+ * @param name the name of the object: a slash followed by up to 254 
+ * characters, none of which are slashes
+ * @return 0: success, -1: the trie is not finalized, or it is a wide one,
+ * -2: failed to create the object
+ *****************************************************************************/
+int ac_trie_share (AC_TRIE_t *thiz, const char *name)
+{
+    if (thiz->trie_open || thiz->wide)
+        return -1;
+    
+    if (thiz->delta)
+    {
+        ac_trie_merge (thiz);
+        thiz->generation++;
+    }
+    
+    return image_share (thiz, name) ? -2 : 0;
+}
+
+/**
+ * @brief Attaches to a trie that is published by ac_trie_share()
+ * 
+ * The object is mapped read-only. The search state is kept in the returned
+ * trie, which is private to the calling process; the threads of the process
+ * can search it by ac_trie_search_thread_safe() as usual. It is released 
+ * by ac_trie_release(), which detaches it.
+ * 
+ * @param name the name that is given to ac_trie_share()
+ * @param verify compare the checksums of the whole image; see 
+ * ac_trie_load()
+ * @return The trie, or NULL if there is no such object or it is not a 
+ * valid image
+ *****************************************************************************/
+AC_TRIE_t *ac_trie_attach (const char *name, int verify)
+{
+    ACT_IMAGE_t *image;
+    
+    if (!(image = image_open_shared (name)))
+        return NULL;
+    
+    return ac_trie_load_image (image, verify);
+}
+
+/**
+ * @brief Removes the name of a trie that is published by ac_trie_share()
+ * 
+ * The tries that are attached already keep working; the memory is freed 
+ * when the last of them is released.
+ * 
+ * @param name
+ * @return 0: success, -1: there is no such object
+ *****************************************************************************/
+int ac_trie_unshare (const char *name)
+{
+    return pages_unlink_shared (name);
+}
+
+/**
+ * @brief Makes a finalized trie of the image
+ * 
+ * @param image the image; it is owned by the trie, or closed on failure
+ * @param verify
+ * @return The trie, or NULL if the image is not valid
+ *****************************************************************************/
+static AC_TRIE_t *ac_trie_load_image (ACT_IMAGE_t *image, int verify)
+{
+    AC_TRIE_t *thiz;
+    
+    thiz = ac_trie_create ();
+    ac_trie_release_nodes (thiz);
+    thiz->image = image;
+    
+    if (image_load (thiz, image, verify))
+    {
+        ac_trie_release (thiz);
+        return NULL;
+    }
+    
+    mf_repdata_allocbuf (&thiz->repdata);
+    thiz->matches = ac_trie_alloc_matches (thiz);
+    if (thiz->arena->tails_count)
+        thiz->tails = tails_create (thiz->arena, thiz->dawg, thiz->map);
+    
+    thiz->trie_open = 0;
+    
+    return thiz;
+}
+
+/**
+ * @brief Returns the search engine of the finalized trie
+ * 
+ * @param thiz pointer to the trie
+ * @return The engine, or AC_ENGINE_NONE if the trie is not finalized
+ *****************************************************************************/
+AC_ENGINE_t ac_trie_engine (AC_TRIE_t *thiz)
+{
+    if (thiz->dfa)
+        return AC_ENGINE_DFA;
+    
+    return thiz->arena ? AC_ENGINE_SPARSE : AC_ENGINE_NONE;
+}
+
+/**
+ * @brief Returns the prefilter of the finalized trie
+ * 
+ * @param thiz pointer to the trie
+ * @return The prefilter, or AC_PREFILTER_NONE if it has none
+ *****************************************************************************/
+AC_PREFILTER_t ac_trie_prefilter (AC_TRIE_t *thiz)
+{
+    if (!thiz->skip)
+        return AC_PREFILTER_NONE;
+    
+    switch (thiz->skip->kind)
+    {
+    case SKIP_KIND_TEDDY:
+        return AC_PREFILTER_TEDDY;
+    case SKIP_KIND_SHIFT:
+        return AC_PREFILTER_SHIFT;
+    case SKIP_KIND_MEMMEM:
+        return AC_PREFILTER_MEMMEM;
+    default:
+        return AC_PREFILTER_BYTES;
+    }
+}
+
+/**
+ * A text that is being searched by ac_trie_search_batch()
+ */
+struct ac_batch_lane
+{
+    const AC_ALPHABET_t *astring;   /**< The text */
+    size_t length;          /**< Length of the text */
+    size_t position;        /**< Current position in the text */
+    ACT_STATE_t state;      /**< Current state */
+    int pending;            /**< The state is not checked for a match yet */
+    size_t index;           /**< Index of the text in the batch */
+};
+
+/**
+ * @brief Searches a batch of independent texts
+ * 
+ * Searches up to AC_SEARCH_BATCH_LANES texts in lockstep: every round moves 
+ * each of them by one alphabet, and prefetches the state it will need next. 
+ * So while one text waits for its state to come from the memory, the others 
+ * proceed. A lane that reaches the end of its text picks up the next text 
+ * of the batch. This pays off when the automaton is much bigger than the 
+ * cache and the texts are many, e.g. log lines.
+ * 
+ * Every text is searched from its beginning as a whole; the search state of
+ * the trie is not used nor changed, so the trie can be shared by threads.
+ * The matches of the text i are reported to the @p callback with 
+ * @p params[i], in the order of their positions in that text. The matches 
+ * of different texts are interleaved. If the call-back returns non-zero, 
+ * the search of that text stops, and the others go on.
+ * 
+ * The lockstep is only for the plain tries. If the trie is truncated, so 
+ * its tail patterns are verified over the text that follows them, or has 
+ * patterns added since it was finalized, the texts are searched one by one 
+ * as ac_trie_search() would, each from the root state.
+ * 
+ * @param thiz pointer to the trie
+ * @param texts array of the texts
+ * @param count number of the texts
+ * @param callback call-back function
+ * @param params array of @p count user parameters, or NULL
+ * @return -1: failed; trie is not finalized, or it is a wide one, 
+ * 0: success
+ *****************************************************************************/
+int ac_trie_search_batch (AC_TRIE_t *thiz, AC_TEXT_t *texts, size_t count,
+        AC_MATCH_CALBACK_f callback, void **params)
+{
+    struct ac_batch_lane lanes[AC_SEARCH_BATCH_LANES];
+    struct ac_batch_lane *lane;
+    size_t i, active = 0, next_text = 0, position;
+    ACT_STATE_t current;
+    AC_PATTERN_t *matches;
+    ACT_TAILS_t *tails = NULL;
+    ACT_DELTA_SEARCH_t *delta = NULL;
+    
+    if (thiz->trie_open || thiz->wide)
+        return -1;  /* Trie must be finalized first. */
+    
+    matches = ac_trie_alloc_matches (thiz);
+    
+    if (ac_trie_sync_delta (thiz, &delta) || thiz->arena->tails_count)
+    {
+        /* The tail patterns are verified over the text that follows them,
+         * and the delta is walked along; the texts are searched one by 
+         * one */
+        if (thiz->arena->tails_count)
+            tails = tails_create (thiz->arena, thiz->dawg, thiz->map);
+        for (i = 0; i < count; i++)
+        {
+            position = 0;
+            current = ARENA_ROOT;
+            if (tails)
+                tails_reset (tails);
+            if (delta)
+                delta_search_reset (delta);
+            ac_trie_search_text (thiz, &texts[i], &position, &current, 0, 
+                    matches, tails, delta, callback, 
+                    params ? params[i] : NULL);
+        }
+        tails_release (tails);
+        delta_search_release (delta);
+        free (matches);
+        return 0;
+    }
+    
+    while (1)
+    {
+        /* Give the next texts to the idle lanes */
+        while (active < AC_SEARCH_BATCH_LANES && next_text < count)
+        {
+            if (texts[next_text].length)
+            {
+                lane = &lanes[active++];
+                lane->astring = texts[next_text].astring;
+                lane->length = texts[next_text].length;
+                lane->position = 0;
+                lane->state = ARENA_ROOT;
+                lane->pending = 0;
+                lane->index = next_text;
+            }
+            next_text++;
+        }
+        
+        if (active == 0)
+            break;
+        
+        for (i = 0; i < active; )
+        {
+            if (ac_trie_batch_step (thiz, &lanes[i], matches, 
+                    callback, params))
+                lanes[i] = lanes[--active]; /* The lane is done */
+            else
+                i++;
+        }
+    }
+    
+    free (matches);
+    
+    return 0;
+}
+
+/**
+ * @brief Initializes the search node; allocates memories and sets initial values
+ *
+ * The payload must be released by ac_search_payload_release().
+ *
+ * @return
+ *****************************************************************************/
+AC_SEARCH_PAYLOAD_t *ac_search_payload_create(const AC_TRIE_t *trie, const AC_ALPHABET_t *alphabet)
+{
+    AC_TEXT_t *text = (AC_TEXT_t*) malloc(sizeof(AC_TEXT_t));
+    text->astring = alphabet;
+    text->length = strlen(text->astring);
+
+    AC_SEARCH_PAYLOAD_t *search;
+    search = (AC_SEARCH_PAYLOAD_t *) malloc(sizeof(AC_SEARCH_PAYLOAD_t));
+    search->position = 0;
+    search->last_state = ARENA_ROOT;
+    search->base_position = 0;
+    search->text = text;
+    search->matches = trie->arena ? ac_trie_alloc_matches (trie) : NULL;
+    search->tails = (trie->arena && trie->arena->tails_count) ? 
+            tails_create (trie->arena, trie->dawg, trie->map) : NULL;
+    search->generation = trie->generation;
+    search->delta_search = NULL;
+
+    return search;
+}
+
+/**
+ * @brief Releases the search payload
+ *
+ * @param search_payload
+ *****************************************************************************/
+void ac_search_payload_release (AC_SEARCH_PAYLOAD_t *search_payload)
+{
+    free (search_payload->matches);
+    tails_release (search_payload->tails);
+    delta_search_release (search_payload->delta_search);
+    free (search_payload->text);
+    free (search_payload);
+}
+
+/**
+ * @brief Search in the input text using the given trie.
+ * 
+ * @param thiz pointer to the trie
+ * @param text input text to be searched
+ * @param keep indicated that if the input text the successive chunk of the 
+ * previous given text or not
+ * @param callback when a match occurs this function will be called. The 
+ * call-back function in turn after doing its job, will return an integer 
+ * value, 0 means continue search, and non-0 value means stop search and return 
+ * to the caller.
+ * @param user this parameter will be send to the call-back function
+ * 
+ * @return
+ * -1:  failed; trie is not finalized, or it is a wide one
+ *  0:  success; input text was searched to the end
+ *  1:  success; input text was searched partially. (callback broke the loop)
+ *****************************************************************************/
+int ac_trie_search (AC_TRIE_t *thiz, AC_TEXT_t *text, int keep, 
+        AC_MATCH_CALBACK_f callback, void *user)
+{
+    size_t position;
+    ACT_STATE_t current;
+
+    if (thiz->trie_open || thiz->wide)
+        return -1;  /* Trie must be finalized first. */
+    
+    if (thiz->wm == AC_WORKING_MODE_FINDNEXT)
+        position = thiz->position;
+    else
+        position = 0;
+    
+    if (!keep)
+        ac_trie_reset (thiz);
+
+    current = thiz->last_state;
+    
+    if (ac_trie_search_text (thiz, text, &position, &current, 
+            thiz->base_position, thiz->matches, thiz->tails, 
+            ac_trie_sync_delta (thiz, &thiz->delta_search), callback, user))
+    {
+        if (thiz->wm == AC_WORKING_MODE_FINDNEXT) {
+            thiz->position = position;
+            thiz->last_state = current;
+        }
+        return 1;
+    }
+    
+    /* Save status variables */
+    thiz->last_state = current;
+    thiz->base_position += position;
+    
+    return 0;
+}
+
+/**
+ * @brief Searches a text of wide symbols
+ * 
+ * The text is searched block by block: the symbols of a block are mapped to
+ * their codes by a single loop for every width, and the codes are searched
+ * by the search loop of the byte tries. The patterns of a match are 
+ * reported in symbols, but they are valid in the call-back function only.
+ * 
+ * If the call-back function stops the search, the rest of the text is not 
+ * searched, and the next search starts over, as if @p keep were 0.
+ * 
+ * @param thiz pointer to a trie made by ac_trie_create_wide()
+ * @param text array of the symbols of the width of the trie
+ * @param length number of the symbols
+ * @param keep the text is the sequel of the previous one: 1, or not: 0
+ * @param callback the match call-back function
+ * @param user this parameter will be send to the call-back function
+ * @return
+ * -1:  failed; trie is not finalized, or it is not a wide one
+ *  0:  success; input text was searched to the end
+ *  1:  success; input text was searched partially. (callback broke the loop)
+ *****************************************************************************/
+int ac_trie_search_wide (AC_TRIE_t *thiz, const void *text, size_t length,
+        int keep, AC_MATCH_CALBACK_f callback, void *user)
+{
+    ACT_WIDE_t *wide = thiz->wide;
+    AC_TEXT_t block;
+    size_t done, count, position;
+    ACT_STATE_t current;
+    
+    if (!wide || thiz->trie_open)
+        return -1;
+    
+    if (!keep)
+    {
+        ac_trie_reset (thiz);
+        wide->symbols_base = 0;
+    }
+    
+    wide->callback = callback;
+    wide->user = user;
+    
+    for (done = 0; done < length; done += count)
+    {
+        count = wide_encode_block (wide, 
+                (const char *) text + done * wide->width, length - done, 
+                &block);
+        wide->code_base = thiz->base_position;
+        
+        position = 0;
+        current = thiz->last_state;
+        
+        if (ac_trie_search_text (thiz, &block, &position, &current, 
+                thiz->base_position, thiz->matches, thiz->tails, 
+                ac_trie_sync_delta (thiz, &thiz->delta_search), 
+                wide_report, wide))
+        {
+            /* The held matches would be of this block */
+            ac_trie_reset (thiz);
+            wide->symbols_base = 0;
+            return 1;
+        }
+        
+        thiz->last_state = current;
+        thiz->base_position += block.length;
+        wide->symbols_base += count;
+    }
+    
+    return 0;
+}
+
+/**
+ * @brief Search in the input text using the given trie.
+ *
+ * @param thiz pointer to the trie
+ * @param search_payload input text to be searched and storage of searching status
+ * @param keep indicated that if the input text the successive chunk of the
+ * previous given text or not
+ * @param callback when a match occurs this function will be called. The
+ * call-back function in turn after doing its job, will return an integer
+ * value, 0 means continue search_payload, and non-0 value means stop search_payload and return
+ * to the caller.
+ * @param user this parameter will be send to the call-back function
+ *
+ * @return
+ * -1:  failed; trie is not finalized, or it is a wide one
+ *  0:  success; input text was searched to the end
+ *  1:  success; input text was searched partially. (callback broke the loop)
+ *****************************************************************************/
+int ac_trie_search_thread_safe (AC_TRIE_t *thiz, AC_SEARCH_PAYLOAD_t *search_payload, int keep,
+                                AC_MATCH_CALBACK_f callback, void *user)
+{
+    size_t position;
+    ACT_STATE_t current;
+
+    if (thiz->trie_open || thiz->wide)
+        return -1;  /* Trie must be finalized first. */
+
+    if (thiz->wm == AC_WORKING_MODE_FINDNEXT)
+        position = search_payload->position;
+    else
+        position = 0;
+
+    if (search_payload->generation != thiz->generation)
+    {
+        /* The trie is finalized again; start over on the new structures */
+        free (search_payload->matches);
+        search_payload->matches = NULL;
+        tails_release (search_payload->tails);
+        search_payload->tails = NULL;
+        delta_search_release (search_payload->delta_search);
+        search_payload->delta_search = NULL;
+        search_payload->last_state = ARENA_ROOT;
+        search_payload->generation = thiz->generation;
+    }
+
+    if (!search_payload->matches)
+        search_payload->matches = ac_trie_alloc_matches (thiz);
+    if (!search_payload->tails && thiz->arena->tails_count)
+        search_payload->tails = tails_create 
+                (thiz->arena, thiz->dawg, thiz->map);
+
+    if (!keep)
+    {
+        /* Only the payload is reset; the trie may be searched by other
+         * threads */
+        search_payload->last_state = ARENA_ROOT;
+        search_payload->base_position = 0;
+        if (search_payload->tails)
+            tails_reset (search_payload->tails);
+        if (search_payload->delta_search)
+            delta_search_reset (search_payload->delta_search);
+    }
+
+    current = search_payload->last_state;
+
+    if (ac_trie_search_text (thiz, search_payload->text, &position, 
+            &current, search_payload->base_position, search_payload->matches,
+            search_payload->tails, 
+            ac_trie_sync_delta (thiz, &search_payload->delta_search), 
+            callback, user))
+    {
+        if (thiz->wm == AC_WORKING_MODE_FINDNEXT) {
+            search_payload->position = position;
+            search_payload->last_state = current;
+        }
+        return 1;
+    }
+
+    /* Save status variables */
+    search_payload->last_state = current;
+    search_payload->base_position += position;
+
+    return 0;
+}
+
+/**
+ * @brief sets the input text to be searched by a function call to _findnext()
+ * 
+ * @param thiz The pointer to the trie
+ * @param text The text to be searched. The owner of the text is the 
+ * calling program and no local copy is made, so it must be valid until you 
+ * have done with it.
+ * @param keep Indicates that if the given text is the sequel of the previous
+ * one or not; 1: it is, 0: it is not
+ *****************************************************************************/
+void ac_trie_settext (AC_TRIE_t *thiz, AC_TEXT_t *text, int keep)
+{
+    if (!keep)
+        ac_trie_reset (thiz);
+    
+    thiz->text = text;
+    thiz->position = 0;
+}
+
+/**
+ * @brief finds the next match in the input text which is set by _settext()
+ * 
+ * @param thiz The pointer to the trie
+ * @return A pointer to the matched structure
+ *****************************************************************************/
+AC_MATCH_t ac_trie_findnext (AC_TRIE_t *thiz)
+{
+    AC_MATCH_t match;
+    
+    thiz->wm = AC_WORKING_MODE_FINDNEXT;
+    match.size = 0;
+    
+    ac_trie_search (thiz, thiz->text, 1, 
+            ac_trie_match_handler, (void *)&match);
+    
+    thiz->wm = AC_WORKING_MODE_SEARCH;
+    
+    return match;
+}
+
+/**
+ * @brief Builds a compact copy of the finalized trie
+ * 
+ * The copy has the patterns of the trie, with the ones that are added or 
+ * removed since it was finalized, and is finalized with the same options. 
+ * It has no delta, nor the states of the removed patterns.
+ * 
+ * Compacting costs as much as building the trie anew: every pattern is 
+ * added to the copy, and the copy is finalized; the states are not pruned 
+ * in place. So it pays off after many removals, not after each one.
+ * 
+ * The trie is only read, so the threads that search it with their own 
+ * payloads go on meanwhile. The program then searches the copy instead, and
+ * releases the trie once those searches are done.
+ * 
+ * @param thiz pointer to the trie
+ * @return The copy, or NULL if the trie is not finalized, or it is a wide
+ * one
+ *****************************************************************************/
+AC_TRIE_t *ac_trie_compact (const AC_TRIE_t *thiz)
+{
+    if (thiz->trie_open || thiz->wide)
+        return NULL;
+    
+    return ac_trie_rebuild (thiz);
+}
+
+/**
+ * @brief Release all allocated memories to the trie
+ * 
+ * @param thiz pointer to the trie
+ *****************************************************************************/
+void ac_trie_release (AC_TRIE_t *thiz)
+{
+    if (thiz->root)
+        ac_trie_release_nodes (thiz);
+    
+    mf_repdata_release (&thiz->repdata);
+    arena_release (thiz->arena);
+    dfa_release (thiz->dfa);
+    skip_release (thiz->skip);
+    tails_release (thiz->tails);
+    dawg_release (thiz->dawg);
+    delta_release (thiz->delta);
+    delta_search_release (thiz->delta_search);
+    free (thiz->matches);
+    free (thiz->map);
+    wide_release (thiz->wide);
+    mpool_free(thiz->mp);
+    image_close (thiz->image);
+    free(thiz);
+}
+
+/**
+ * @brief Prints the trie to output in human readable form. It is useful 
+ * for debugging purpose.
+ * 
+ * @param thiz pointer to the trie
+ *****************************************************************************/
+void ac_trie_display (AC_TRIE_t *thiz)
+{
+    if (thiz->arena)
+        arena_display (thiz->arena);
+    else
+        ac_trie_traverse_action (thiz->root, node_display, 1);
+}
+
+/**
+ * @brief Allocates a buffer that can hold the patterns of any match of the
+ * finalized trie
+ * 
+ * @param thiz pointer to the trie
+ * @return
+ *****************************************************************************/
+static AC_PATTERN_t *ac_trie_alloc_matches (const AC_TRIE_t *thiz)
+{
+    size_t size = thiz->arena->matches_max ? thiz->arena->matches_max : 1;
+    
+    return (AC_PATTERN_t *) malloc (size * sizeof(AC_PATTERN_t));
+}
+
+/**
+ * @brief Releases the trie nodes
+ * 
+ * @param thiz pointer to the trie
+ *****************************************************************************/
+static void ac_trie_release_nodes (AC_TRIE_t *thiz)
+{
+    /* It must be called with a 0 top-down parameter */
+    ac_trie_traverse_action (thiz->root, node_release_vectors, 0);
+    
+    mpool_free (thiz->nodes_mp);
+    thiz->nodes_mp = NULL;
+    thiz->root = NULL;
+}
+
+/**
+ * @brief Adds the pattern to the trie; see ac_trie_add()
+ * 
+ * @param thiz pointer to the trie
+ * @param patt
+ * @param copy
+ * @return
+ *****************************************************************************/
+static AC_STATUS_t ac_trie_add_pattern (AC_TRIE_t *thiz, AC_PATTERN_t *patt, 
+        int copy)
+{
+    size_t i;
+    ACT_NODE_t *n = thiz->root;
+    ACT_NODE_t *next;
+    AC_ALPHABET_t alpha;
+    AC_STATUS_t status;
+    
+    if (!patt->ptext.length)
+        return ACERR_ZERO_PATTERN;
+    
+    if (patt->ptext.length > AC_PATTRN_MAX_LENGTH)
+        return ACERR_LONG_PATTERN;
+    
+    if (!thiz->trie_open)
+    {
+        /* The trie is finalized; the pattern goes to the delta */
+        if (ac_trie_find_pattern (thiz, patt) != ARENA_NONE)
+            return ACERR_DUPLICATE_PATTERN;
+        
+        if (!thiz->delta)
+            thiz->delta = delta_create (thiz);
+        
+        if ((status = delta_add (thiz->delta, patt)) == ACERR_SUCCESS)
+            thiz->patterns_count++;
+        
+        return status;
+    }
+    
+    for (i = 0; i < patt->ptext.length; i++)
+    {
+        alpha = patt->ptext.astring[i];
+        if (thiz->map)
+            alpha = thiz->map[(unsigned char) alpha];
+        if ((next = node_find_next (n, alpha)))
+        {
+            n = next;
+            continue;
+        }
+        else
+        {
+            next = node_create_next (n, alpha);
+            next->depth = n->depth + 1;
+            n = next;
+        }
+    }
+    
+    if(n->final)
+        return ACERR_DUPLICATE_PATTERN;
+    
+    n->final = 1;
+    node_accept_pattern (n, patt, copy);
+    thiz->patterns_count++;
+    
+    return ACERR_SUCCESS;
+}
+
+/**
+ * @brief Removes the pattern from the trie; see ac_trie_remove()
+ * 
+ * @param thiz pointer to the trie
+ * @param patt
+ * @return
+ *****************************************************************************/
+static AC_STATUS_t ac_trie_remove_pattern (AC_TRIE_t *thiz, 
+        AC_PATTERN_t *patt)
+{
+    size_t i;
+    ACT_NODE_t *n = thiz->root;
+    ACT_NODE_t *keep = NULL;    /* The last node that the pattern shares */
+    AC_ALPHABET_t alpha, keep_alpha = 0;
+    uint32_t index;
+    
+    if (!thiz->trie_open)
+    {
+        if (thiz->delta && delta_remove (thiz->delta, patt) == ACERR_SUCCESS)
+        {
+            thiz->patterns_count--;
+            return ACERR_SUCCESS;
+        }
+        
+        if ((index = ac_trie_find_pattern (thiz, patt)) == ARENA_NONE)
+            return ACERR_PATTERN_NOT_FOUND;
+        
+        if (!thiz->delta)
+            thiz->delta = delta_create (thiz);
+        
+        delta_remove_matched (thiz->delta, thiz->arena, index);
+        thiz->patterns_count--;
+        
+        return ACERR_SUCCESS;
+    }
+    
+    for (i = 0; i < patt->ptext.length && n; i++)
+    {
+        alpha = patt->ptext.astring[i];
+        if (thiz->map)
+            alpha = thiz->map[(unsigned char) alpha];
+        if (!keep || n->final || n->outgoing_size > 1)
+        {
+            keep = n;
+            keep_alpha = alpha;
+        }
+        n = node_find_next (n, alpha);
+    }
+    
+    if (!n || !n->final || !patt->ptext.length)
+        return ACERR_PATTERN_NOT_FOUND;
+    
+    n->final = 0;
+    n->matched_size = 0;
+    thiz->patterns_count--;
+    
+    if (!n->outgoing_size)
+        node_cut_edge (keep, keep_alpha);
+    
+    return ACERR_SUCCESS;
+}
+
+/**
+ * @brief The main search loop; searches the text from the given position 
+ * and state to the end of the text, or until the call-back function asks to 
+ * stop.
+ * 
+ * @param thiz pointer to the trie
+ * @param text input text
+ * @param position the position to start from; on return it holds the 
+ * position that the loop stopped at
+ * @param last_state the state to start from; on return it holds the state 
+ * that the loop stopped at
+ * @param base_position position of the text related to the whole input
+ * @param matches the buffer to assemble the matched patterns in
+ * @param tails the tail patterns being verified, or NULL if the trie is not
+ * truncated
+ * @param delta the search in the delta, or NULL if the trie has no delta
+ * @param callback the match call-back function
+ * @param user this parameter will be send to the call-back function
+ * 
+ * @return 0: the text was searched to the end, 1: call-back broke the loop
+ *****************************************************************************/
+static int ac_trie_search_text (AC_TRIE_t *thiz, AC_TEXT_t *text, 
+        size_t *position, ACT_STATE_t *last_state, size_t base_position, 
+        AC_PATTERN_t *matches, ACT_TAILS_t *tails, ACT_DELTA_SEARCH_t *delta,
+        AC_MATCH_CALBACK_f callback, void *user)
+{
+    const ACT_ARENA_t *arena = thiz->arena;
+    const ACT_SKIP_t *skip = thiz->skip;
+    const AC_ALPHABET_t *astring = text->astring;
+    size_t pos;
+    ACT_STATE_t current;
+    ACT_STATE_t next;
+    ACT_CLASS_t cls;
+    
+    if (delta)
+        return ac_trie_search_delta (thiz, text, position, last_state, 
+                base_position, matches, tails, delta, callback, user);
+    
+    /* Go on with the tail patterns of the previous chunk first */
+    if (tails && tails->count && ac_trie_search_tails (thiz, text, position, 
+            last_state, base_position, matches, tails, callback, user))
+        return 1;
+    
+    if (thiz->dfa)
+        return ac_trie_search_dfa (thiz, text, position, last_state, 
+                base_position, matches, tails, callback, user);
+    
+    pos = *position;
+    current = *last_state;
+    
+    /* This is the main search loop.
+     * It must be kept as lightweight as possible.
+     */
+    while (pos < text->length)
+    {
+        if (current == ARENA_ROOT && skip)
+        {
+            /* Jump to the next alphabet that starts a pattern */
+            pos = SKIP_SCAN(skip, &astring[pos], &astring[text->length]) - 
+                    astring;
+            if (pos == text->length)
+                break;
+        }
+        
+        cls = ARENA_CLASS(arena, astring[pos]);
+        
+        if (cls == arena->void_class)
+        {
+            /* No state has a transition for this alphabet */
+            current = ARENA_ROOT;
+            pos++;
+            continue;
+        }
+        
+        next = arena_find_next (arena, current, cls);
+        
+        if (next == ARENA_NONE)
+        {
+            if (current != ARENA_ROOT)
+                current = ARENA_FAILURE(arena, current);
+            else
+                pos++;
+            
+            /* We do not report a match after a fail transition, because 
+             * it has already been reported */
+            continue;
+        }
+        
+        current = next;
+        pos++;
+        
+        if (!ARENA_IS_MARKED(arena, current))
+            continue;
+        
+        if (tails)
+        {
+            *position = pos;
+            *last_state = current;
+            if (ac_trie_follow_tails (thiz, text, position, last_state, 
+                    base_position, matches, tails, callback, user))
+                return 1;
+            pos = *position;
+            current = *last_state;
+        }
+        else if (ac_trie_report (arena, current, pos + base_position, 
+                matches, callback, user))
+        {
+            *position = pos;
+            *last_state = current;
+            return 1;
+        }
+    }
+    
+    *position = pos;
+    *last_state = current;
+    
+    return 0;
+}
+
+/**
+ * @brief The search loop of a trie that is compiled into a DFA
+ * 
+ * Every input alphabet costs one class map and one table lookup; there is 
+ * no failure loop. It has the same parameters as ac_trie_search_text().
+ *****************************************************************************/
+static int ac_trie_search_dfa (AC_TRIE_t *thiz, AC_TEXT_t *text, 
+        size_t *position, ACT_STATE_t *last_state, size_t base_position, 
+        AC_PATTERN_t *matches, ACT_TAILS_t *tails, 
+        AC_MATCH_CALBACK_f callback, void *user)
+{
+    const ACT_DFA_t *dfa = thiz->dfa;
+    const ACT_CLASS_t *classes = thiz->arena->classes;
+    const uint32_t *delta = dfa->delta;
+    const ACT_SKIP_t *skip = thiz->skip;
+    const AC_ALPHABET_t *astring = text->astring;
+    size_t pos = *position;
+    uint32_t state = *last_state;
+    
+    while (pos < text->length)
+    {
+        if (state == ARENA_ROOT && skip)
+        {
+            pos = SKIP_SCAN(skip, &astring[pos], &astring[text->length]) - 
+                    astring;
+            if (pos == text->length)
+                break;
+        }
+        
+        state = delta[DFA_INDEX(dfa, state, 
+                classes[(unsigned char) astring[pos++]])];
+        
+        if (!(state & DFA_MATCH_FLAG))
+            continue;
+        
+        state &= DFA_STATE_MASK;
+        
+        if (tails)
+        {
+            *position = pos;
+            *last_state = state;
+            if (ac_trie_follow_tails (thiz, text, position, last_state, 
+                    base_position, matches, tails, callback, user))
+                return 1;
+            pos = *position;
+            state = *last_state;
+        }
+        else if (ac_trie_report (thiz->arena, state, pos + base_position, 
+                matches, callback, user))
+        {
+            *position = pos;
+            *last_state = state;
+            return 1;
+        }
+    }
+    
+    *position = pos;
+    *last_state = state & DFA_STATE_MASK;
+    
+    return 0;
+}
+
+/**
+ * @brief Searches the text alphabet by alphabet while any tail pattern is
+ * being verified
+ * 
+ * It has the same parameters as ac_trie_search_text(), and returns when the
+ * text is over or no tail pattern is left.
+ *****************************************************************************/
+static int ac_trie_search_tails (AC_TRIE_t *thiz, AC_TEXT_t *text, 
+        size_t *position, ACT_STATE_t *last_state, size_t base_position, 
+        AC_PATTERN_t *matches, ACT_TAILS_t *tails, 
+        AC_MATCH_CALBACK_f callback, void *user)
+{
+    const ACT_ARENA_t *arena = thiz->arena;
+    size_t pos = *position;
+    ACT_STATE_t current = *last_state;
+    AC_ALPHABET_t alpha;
+    
+    while (tails->count && pos < text->length)
+    {
+        alpha = text->astring[pos++];
+        current = ac_trie_step (thiz, current, ARENA_CLASS(arena, alpha));
+        tails_advance (tails, alpha, pos + base_position);
+        
+        if ((ARENA_IS_MARKED(arena, current) || tails->done_size) && 
+                ac_trie_report_tails (arena, current, text, pos, 
+                        base_position, matches, tails, callback, user))
+        {
+            *position = pos;
+            *last_state = current;
+            return 1;
+        }
+    }
+    
+    *position = pos;
+    *last_state = current;
+    
+    return 0;
+}
+
+/**
+ * @brief Handles a marked state of a truncated trie that the search has 
+ * just reached, then searches on by ac_trie_search_tails() while it has 
+ * tail patterns to verify
+ * 
+ * It has the same parameters as ac_trie_search_text().
+ *****************************************************************************/
+static int ac_trie_follow_tails (AC_TRIE_t *thiz, AC_TEXT_t *text, 
+        size_t *position, ACT_STATE_t *last_state, size_t base_position, 
+        AC_PATTERN_t *matches, ACT_TAILS_t *tails, 
+        AC_MATCH_CALBACK_f callback, void *user)
+{
+    if (ac_trie_report_tails (thiz->arena, *last_state, text, *position, 
+            base_position, matches, tails, callback, user))
+        return 1;
+    
+    return tails->count ? ac_trie_search_tails (thiz, text, position, 
+            last_state, base_position, matches, tails, callback, user) : 0;
+}
+
+/**
+ * @brief Starts the tail patterns of the state, and reports the patterns 
+ * that end at the position: the tail patterns that ended, the longest 
+ * first, and then the patterns of the state
+ * 
+ * @param arena
+ * @param state the state that the search has just reached
+ * @param text input text
+ * @param pos position of the search in the text
+ * @param base_position position of the text related to the whole input
+ * @param matches the buffer to assemble the matched patterns in
+ * @param tails the tail patterns being verified
+ * @param callback the match call-back function
+ * @param user this parameter will be send to the call-back function
+ * 
+ * @return the return value of the call-back function, or 0 if there was no
+ * match
+ *****************************************************************************/
+static int ac_trie_report_tails (const ACT_ARENA_t *arena, 
+        ACT_STATE_t state, AC_TEXT_t *text, size_t pos, size_t base_position,
+        AC_PATTERN_t *matches, ACT_TAILS_t *tails, 
+        AC_MATCH_CALBACK_f callback, void *user)
+{
+    AC_MATCH_t match;
+    uint8_t flags = ARENA_IS_MARKED(arena, state) ? 
+            arena->states[state].flags : 0;
+    
+    if (flags & ARENA_STATE_TAIL)
+        tails_start (tails, state, text, pos, base_position);
+    
+    if (!tails->done_size)
+        return (flags & ARENA_STATE_FINAL) ? ac_trie_report (arena, state, 
+                pos + base_position, matches, callback, user) : 0;
+    
+    match.position = pos + base_position;
+    match.patterns = tails->done;
+    match.size = tails->done_size;
+    
+    if (flags & ARENA_STATE_FINAL)
+        match.size += arena_collect_matches (arena, state, 
+                &tails->done[tails->done_size]);
+    
+    tails->done_size = 0;
+    
+    return callback (&match, user);
+}
+
+/**
+ * The call-back of the main trie while it is searched along with a delta
+ */
+struct ac_delta_report
+{
+    ACT_DELTA_SEARCH_t *delta;      /**< The search in the delta */
+    AC_MATCH_CALBACK_f callback;    /**< The call-back of the caller */
+    void *user;                     /**< The parameter of the callback */
+};
+
+/**
+ * @brief The search loop of a trie that has a delta
+ * 
+ * The chunk is scanned for the delta first, by its own search loop, and 
+ * its matches are queued. Then the main trie searches the chunk by its own
+ * loop, and every match of it is reported after the queued matches before 
+ * it, and along with the one at the same position; the rest are reported 
+ * at the end of the chunk. It has the same parameters as 
+ * ac_trie_search_text().
+ *****************************************************************************/
+static int ac_trie_search_delta (AC_TRIE_t *thiz, AC_TEXT_t *text, 
+        size_t *position, ACT_STATE_t *last_state, size_t base_position, 
+        AC_PATTERN_t *matches, ACT_TAILS_t *tails, ACT_DELTA_SEARCH_t *delta,
+        AC_MATCH_CALBACK_f callback, void *user)
+{
+    struct ac_delta_report report;
+    size_t from, pos;
+    
+    /* In the find-next mode, the chunk is scanned by the first call */
+    from = delta->scanned > base_position ? delta->scanned - base_position : 0;
+    
+    if (from < text->length)
+    {
+        pos = from;
+        ac_trie_search_text (thiz->delta->trie, text, &pos, &delta->state, 
+                base_position, delta->patterns, NULL, NULL, 
+                delta_search_queue, delta);
+        delta_search_keep (delta, &text->astring[from], text->length - from);
+        delta->scanned = base_position + text->length;
+        atomic_fetch_add_explicit (&thiz->delta->scanned, 
+                text->length - from, memory_order_relaxed);
+    }
+    
+    if (delta_search_resume (delta, callback, user))
+        return 1;
+    
+    report.delta = delta;
+    report.callback = callback;
+    report.user = user;
+    
+    if (ac_trie_search_text (thiz, text, position, last_state, 
+            base_position, matches, tails, NULL, ac_trie_report_delta, 
+            &report))
+        return 1;
+    
+    return delta_search_flush (delta, callback, user);
+}
+
+/**
+ * @brief Reports a match of the main trie in order with the matches of the
+ * delta; see delta_search_report()
+ * 
+ * @param match
+ * @param param the ac_delta_report of the search
+ * @return the return value of the call-back function of the caller
+ *****************************************************************************/
+static int ac_trie_report_delta (AC_MATCH_t *match, void *param)
+{
+    struct ac_delta_report *report = (struct ac_delta_report *) param;
+    
+    return delta_search_report (report->delta, match, report->callback, 
+            report->user);
+}
+
+/**
+ * @brief Makes the search state of the delta ready
+ * 
+ * When the delta trie is built again, the state of the new trie is found 
+ * from the last bytes that the search has scanned, so the search goes on 
+ * over the chunks.
+ * 
+ * @param thiz pointer to the trie
+ * @param delta the search state of the context; it is made if needed
+ * @return The search state, or NULL if the trie has no delta to search
+ *****************************************************************************/
+static ACT_DELTA_SEARCH_t *ac_trie_sync_delta (const AC_TRIE_t *thiz, 
+        ACT_DELTA_SEARCH_t **delta)
+{
+    const AC_TRIE_t *dtrie;
+    ACT_DELTA_SEARCH_t *search = *delta;
+    size_t i, first;
+    
+    if (!thiz->delta || !(dtrie = thiz->delta->trie))
+    {
+        /* The kept bytes would not be followed */
+        if (search)
+            search->history_size = 0;
+        return NULL;
+    }
+    
+    if (search && search->generation == thiz->delta->generation)
+        return search;
+    
+    *delta = search = delta_search_sync (search, thiz->delta);
+    
+    first = search->history_next + DELTA_HISTORY_SIZE - search->history_size;
+    for (i = 0; i < search->history_size; i++)
+        search->state = ac_trie_step (dtrie, search->state, 
+                ARENA_CLASS(dtrie->arena, search->history
+                [(first + i) % DELTA_HISTORY_SIZE]));
+    
+    return search;
+}
+
+/**
+ * @brief Finds the pattern of the same text in the finalized trie
+ * 
+ * The patterns that are removed since it was built are not found.
+ * 
+ * @param thiz pointer to the trie
+ * @param patt
+ * @return Index of the pattern in the matched array, or ARENA_NONE
+ *****************************************************************************/
+static uint32_t ac_trie_find_pattern (const AC_TRIE_t *thiz, 
+        const AC_PATTERN_t *patt)
+{
+    const ACT_ARENA_t *arena = thiz->arena;
+    const AC_ALPHABET_t *astring = patt->ptext.astring;
+    const uint8_t *removing = thiz->delta ? thiz->delta->removing : NULL;
+    const struct act_tail *tail;
+    const AC_PATTERN_t *other;
+    ACT_STATE_t state = ARENA_ROOT, next;
+    ACT_CLASS_t cls;
+    uint32_t index = ARENA_NONE;
+    size_t i, j, k;
+    
+    for (i = 0; i < patt->ptext.length; i++, state = next)
+    {
+        cls = ARENA_CLASS(arena, astring[i]);
+        if (cls == arena->void_class || 
+                (next = arena_find_next (arena, state, cls)) == ARENA_NONE)
+            break;
+    }
+    
+    if (i == patt->ptext.length)
+    {
+        /* A final state may match the suffixes only; the own pattern 
+         * counts */
+        if (!ARENA_IS_CHAIN(arena, state) && arena->infos[state].matched_size)
+            index = arena->infos[state].matched;
+    }
+    else if (ARENA_IS_MARKED(arena, state) && 
+            (arena->states[state].flags & ARENA_STATE_TAIL))
+    {
+        /* A long pattern may be a tail pattern of the state */
+        tail = arena_find_tail (arena, state);
+        
+        for (j = 0; j < tail->patterns_size && index == ARENA_NONE; j++)
+        {
+            other = &arena->matched[tail->patterns + j];
+            if (other->ptext.length != patt->ptext.length)
+                continue;
+            
+            for (k = i; k < patt->ptext.length; k++)
+                if (thiz->map ? 
+                        thiz->map[(unsigned char) other->ptext.astring[k]] != 
+                        thiz->map[(unsigned char) astring[k]] : 
+                        other->ptext.astring[k] != astring[k])
+                    break;
+            
+            if (k == patt->ptext.length)
+                index = tail->patterns + j;
+        }
+    }
     
-    n->final = 1;
-    node_accept_pattern (n, patt, copy);
-    thiz->patterns_count++;
+    if (index != ARENA_NONE && removing && removing[index])
+        return ARENA_NONE;
     
-    return ACERR_SUCCESS;
+    return index;
 }
 
 /**
- * @brief Finalizes the preprocessing stage and gets the trie ready
+ * @brief Builds a new trie of the patterns of the trie and its delta
  * 
- * Locates the failure node for all nodes and collects all matched 
- * pattern for each node. It also sorts outgoing edges of node, so binary 
- * search could be performed on them. After calling this function the automate 
- * will be finalized and you can not add new patterns to the automate.
+ * The removed patterns are left out, and the new trie is finalized with the 
+ * options of this one. The trie itself is not changed.
  * 
  * @param thiz pointer to the trie
+ * @return The new trie
  *****************************************************************************/
-void ac_trie_finalize (AC_TRIE_t *thiz)
+static AC_TRIE_t *ac_trie_rebuild (const AC_TRIE_t *thiz)
 {
-    AC_ALPHABET_t prefix[AC_PATTRN_MAX_LENGTH]; 
+    AC_TRIE_t *fresh = thiz->map ? ac_trie_create_mapped (thiz->map) : 
+            ac_trie_create ();
+    const ACT_DELTA_t *delta = thiz->delta;
+    size_t i;
     
-    /* 'prefix' defined here, because ac_trie_traverse_setfailure() calls
-     * itself recursively */
-    ac_trie_traverse_setfailure (thiz->root, prefix);
+    for (i = 0; i < thiz->arena->matched_count; i++)
+        if (!delta || !delta->removing || !delta->removing[i])
+            ac_trie_add (fresh, &thiz->arena->matched[i], 1);
+    for (i = 0; delta && i < delta->count; i++)
+        ac_trie_add (fresh, &delta->patterns[i], 1);
     
-    ac_trie_traverse_action (thiz->root, node_collect_matches, 1);
-    mf_repdata_allocbuf (&thiz->repdata);
+    ac_trie_finalize_opt (fresh, thiz->options);
     
-    thiz->trie_open = 0; /* Do not accept patterns any more */
+    return fresh;
 }
 
-
 /**
- * @brief Initializes the search node; allocates memories and sets initial values
- *
- * @return
+ * @brief Rebuilds the trie with the changes of its delta
+ * 
+ * The trie takes over the structures of the rebuilt one.
+ * 
+ * @param thiz pointer to the trie
  *****************************************************************************/
-AC_SEARCH_PAYLOAD_t *ac_search_payload_create(const AC_TRIE_t *trie, const AC_ALPHABET_t *alphabet)
+static void ac_trie_merge (AC_TRIE_t *thiz)
 {
-    AC_TEXT_t *text = (AC_TEXT_t*) malloc(sizeof(AC_TEXT_t));
-    text->astring = alphabet;
-    text->length = strlen(text->astring);
-
-    AC_SEARCH_PAYLOAD_t *search;
-    search = (AC_SEARCH_PAYLOAD_t *) malloc(sizeof(AC_SEARCH_PAYLOAD_t));
-    search->position = 0;
-    search->last_node = trie->root;
-    search->base_position = 0;
-    search->text = text;
-
-    return search;
+    AC_TRIE_t *fresh = ac_trie_rebuild (thiz);
+    AC_TRIE_t old;
+    
+    /* Swap the tries; the old structures go with the fresh one */
+    old = *thiz;
+    *thiz = *fresh;
+    *fresh = old;
+    thiz->repdata.trie = thiz;
+    fresh->repdata.trie = fresh;
+    thiz->generation = old.generation;
+    thiz->wide = old.wide;
+    fresh->wide = NULL;
+    
+    ac_trie_release (fresh);
 }
 
 /**
- * @brief Search in the input text using the given trie.
+ * @brief Moves from the state by the class, following the failures if 
+ * needed
  * 
  * @param thiz pointer to the trie
- * @param text input text to be searched
- * @param keep indicated that if the input text the successive chunk of the 
- * previous given text or not
- * @param callback when a match occurs this function will be called. The 
- * call-back function in turn after doing its job, will return an integer 
- * value, 0 means continue search, and non-0 value means stop search and return 
- * to the caller.
- * @param user this parameter will be send to the call-back function
- * 
- * @return
- * -1:  failed; trie is not finalized
- *  0:  success; input text was searched to the end
- *  1:  success; input text was searched partially. (callback broke the loop)
+ * @param state
+ * @param cls
+ * @return The next state
  *****************************************************************************/
-int ac_trie_search (AC_TRIE_t *thiz, AC_TEXT_t *text, int keep, 
-        AC_MATCH_CALBACK_f callback, void *user)
+static ACT_STATE_t ac_trie_step (const AC_TRIE_t *thiz, ACT_STATE_t state,
+        ACT_CLASS_t cls)
 {
-    size_t position;
-    ACT_NODE_t *current;
-    ACT_NODE_t *next;
-    AC_MATCH_t match;
-
-    if (thiz->trie_open)
-        return -1;  /* Trie must be finalized first. */
-    
-    if (thiz->wm == AC_WORKING_MODE_FINDNEXT)
-        position = thiz->position;
-    else
-        position = 0;
+    const ACT_ARENA_t *arena = thiz->arena;
+    ACT_STATE_t next;
     
-    if (!keep)
-        ac_trie_reset (thiz);
-
-    current = thiz->last_node;
+    if (thiz->dfa)
+        return thiz->dfa->delta[DFA_INDEX(thiz->dfa, state, cls)] & 
+                DFA_STATE_MASK;
     
-    /* This is the main search loop.
-     * It must be kept as lightweight as possible.
-     */
-    while (position < text->length)
-    {
-        if (!(next = node_find_next_bs (current, text->astring[position])))
-        {
-            if(current->failure_node /* We are not in the root node */)
-                current = current->failure_node;
-            else
-                position++;
-        }
-        else
-        {
-            current = next;
-            position++;
-        }
-        
-        if (current->final && next)
-        /* We check 'next' to find out if we have come here after a alphabet
-         * transition or due to a fail transition. in second case we should not 
-         * report match, because it has already been reported */
-        {
-            /* Found a match! */
-            match.position = position + thiz->base_position;
-            match.size = current->matched_size;
-            match.patterns = current->matched;
-            
-            /* Do call-back */
-            if (callback(&match, user))
-            {
-                if (thiz->wm == AC_WORKING_MODE_FINDNEXT) {
-                    thiz->position = position;
-                    thiz->last_node = current;
-                }
-                return 1;
-            }
-        }
-    }
+    if (cls == arena->void_class)
+        return ARENA_ROOT;
     
-    /* Save status variables */
-    thiz->last_node = current;
-    thiz->base_position += position;
+    while ((next = arena_find_next (arena, state, cls)) == ARENA_NONE && 
+            state != ARENA_ROOT)
+        state = ARENA_FAILURE(arena, state);
     
-    return 0;
+    return (next == ARENA_NONE) ? ARENA_ROOT : next;
 }
 
 /**
- * @brief Search in the input text using the given trie.
- *
+ * @brief Chooses the search engine from the options and the statistics
+ * 
+ * The DFA costs a table lookup per input alphabet, which is faster than 
+ * walking the trie as long as the table stays in the cache. 
+ * 
  * @param thiz pointer to the trie
- * @param search_payload input text to be searched and storage of searching status
- * @param keep indicated that if the input text the successive chunk of the
- * previous given text or not
- * @param callback when a match occurs this function will be called. The
- * call-back function in turn after doing its job, will return an integer
- * value, 0 means continue search_payload, and non-0 value means stop search_payload and return
- * to the caller.
- * @param user this parameter will be send to the call-back function
- *
+ * @param options OR'ed values of ACT_FINALIZE_OPTION_t
  * @return
- * -1:  failed; trie is not finalized
- *  0:  success; input text was searched to the end
- *  1:  success; input text was searched partially. (callback broke the loop)
- *****************************************************************************/
-int ac_trie_search_thread_safe (AC_TRIE_t *thiz, AC_SEARCH_PAYLOAD_t *search_payload, int keep,
-                                AC_MATCH_CALBACK_f callback, void *user)
-{
-    size_t position;
-    ACT_NODE_t *current;
-    ACT_NODE_t *next;
-    AC_MATCH_t match;
-
-    if (thiz->trie_open)
-        return -1;  /* Trie must be finalized first. */
-
-    if (thiz->wm == AC_WORKING_MODE_FINDNEXT)
-        position = search_payload->position;
-    else
-        position = 0;
-
-    current = search_payload->last_node;
-
-    if (!keep)
-        ac_trie_reset (thiz);
-
-    /* This is the main search loop.
-     * It must be kept as lightweight as possible.
-     */
-    while (position < search_payload->text->length)
-    {
-        if (!(next = node_find_next_bs (current, search_payload->text->astring[position])))
-        {
-            if(current->failure_node /* We are not in the root node */)
-                current = current->failure_node;
-            else
-                position++;
-        }
-        else
-        {
-            current = next;
-            position++;
-        }
-
-        if (current->final && next)
-            /* We check 'next' to find out if we have come here after a alphabet
-             * transition or due to a fail transition. in second case we should not
-             * report match, because it has already been reported */
-        {
-            /* Found a match! */
-            match.position = position + search_payload->base_position;
-            match.size = current->matched_size;
-            match.patterns = current->matched;
-
-            /* Do call-back */
-            if (callback(&match, user))
-            {
-                if (thiz->wm == AC_WORKING_MODE_FINDNEXT) {
-                    search_payload->position = position;
-                    search_payload->last_node = current;
-                }
-                return 1;
-            }
-        }
-    }
-
-    /* Save status variables */
-    search_payload->last_node = current;
-    search_payload->base_position += position;
-
-    return 0;
-}
-
-/**
- * @brief sets the input text to be searched by a function call to _findnext()
- * 
- * @param thiz The pointer to the trie
- * @param text The text to be searched. The owner of the text is the 
- * calling program and no local copy is made, so it must be valid until you 
- * have done with it.
- * @param keep Indicates that if the given text is the sequel of the previous
- * one or not; 1: it is, 0: it is not
  *****************************************************************************/
-void ac_trie_settext (AC_TRIE_t *thiz, AC_TEXT_t *text, int keep)
+static AC_ENGINE_t ac_trie_choose_engine (const AC_TRIE_t *thiz, 
+        int options)
 {
-    if (!keep)
-        ac_trie_reset (thiz);
+    size_t dfa_size;
     
-    thiz->text = text;
-    thiz->position = 0;
+    if (options & AC_FINALIZE_DFA)
+        return AC_ENGINE_DFA;
+    if (options & AC_FINALIZE_SPARSE)
+        return AC_ENGINE_SPARSE;
+    
+    dfa_size = thiz->stats.states_count * thiz->arena->classes_count * 
+            sizeof(uint32_t);
+    
+    return dfa_size <= DFA_AUTO_MAX_SIZE ? AC_ENGINE_DFA : AC_ENGINE_SPARSE;
 }
 
 /**
- * @brief finds the next match in the input text which is set by _settext()
+ * @brief Moves a lane of ac_trie_search_batch() by one alphabet
  * 
- * @param thiz The pointer to the trie
- * @return A pointer to the matched structure
+ * Prefetches the memory that the next step of the lane will read. With the
+ * DFA, the next transition is prefetched and a match is reported at once.
+ * Otherwise the new state is prefetched, and it is checked for a match at 
+ * the next step of the lane, when its memory has (hopefully) arrived.
+ * 
+ * @param thiz pointer to the trie
+ * @param lane
+ * @param matches
+ * @param callback
+ * @param params
+ * @return 1 if the lane is done with its text, 0 otherwise
  *****************************************************************************/
-AC_MATCH_t ac_trie_findnext (AC_TRIE_t *thiz)
+static int ac_trie_batch_step (const AC_TRIE_t *thiz, 
+        struct ac_batch_lane *lane, AC_PATTERN_t *matches, 
+        AC_MATCH_CALBACK_f callback, void **params)
 {
-    AC_MATCH_t match;
+    const ACT_ARENA_t *arena = thiz->arena;
+    const ACT_DFA_t *dfa = thiz->dfa;
+    const AC_ALPHABET_t *astring = lane->astring;
+    void *user = params ? params[lane->index] : NULL;
+    size_t pos = lane->position;
+    ACT_STATE_t current = lane->state;
+    ACT_STATE_t next;
+    ACT_CLASS_t cls;
     
-    thiz->wm = AC_WORKING_MODE_FINDNEXT;
-    match.size = 0;
+    if (lane->pending)
+    {
+        lane->pending = 0;
+        if (ARENA_IS_FINAL(arena, current) && 
+                ac_trie_report (arena, current, pos, matches, callback, user))
+            return 1;
+        if (pos == lane->length)
+            return 1;
+    }
     
-    ac_trie_search (thiz, thiz->text, 1, 
-            ac_trie_match_handler, (void *)&match);
+    if (current == ARENA_ROOT && thiz->skip)
+    {
+        pos = SKIP_SCAN(thiz->skip, &astring[pos], &astring[lane->length]) - 
+                astring;
+        if (pos == lane->length)
+            return 1;
+    }
     
-    thiz->wm = AC_WORKING_MODE_SEARCH;
+    cls = ARENA_CLASS(arena, astring[pos++]);
     
-    return match;
+    if (dfa)
+    {
+        next = dfa->delta[DFA_INDEX(dfa, current, cls)];
+        lane->position = pos;
+        lane->state = next & DFA_STATE_MASK;
+        
+        if ((next & DFA_MATCH_FLAG) && ac_trie_report (arena, lane->state, 
+                pos, matches, callback, user))
+            return 1;
+        if (pos == lane->length)
+            return 1;
+        
+        ARENA_PREFETCH(&dfa->delta[DFA_INDEX(dfa, lane->state, 
+                ARENA_CLASS(arena, astring[pos]))]);
+        return 0;
+    }
+    
+    if (cls == arena->void_class)
+    {
+        /* No state has a transition for this alphabet */
+        current = ARENA_ROOT;
+    }
+    else
+    {
+        while ((next = arena_find_next (arena, current, cls)) == ARENA_NONE
+                && current != ARENA_ROOT)
+            current = ARENA_FAILURE(arena, current);
+        
+        if (next != ARENA_NONE)
+        {
+            current = next;
+            lane->pending = 1;
+            if (ARENA_IS_CHAIN(arena, current))
+                ARENA_PREFETCH(&arena->chains[current - arena->chain_base]);
+            else
+                ARENA_PREFETCH(&arena->states[current]);
+        }
+    }
+    
+    lane->position = pos;
+    lane->state = current;
+    
+    if (pos < lane->length)
+        return 0;
+    
+    /* The text is over; the last state can not wait for another step */
+    if (lane->pending && ARENA_IS_FINAL(arena, current))
+        ac_trie_report (arena, current, pos, matches, callback, user);
+    
+    return 1;
 }
 
 /**
- * @brief Release all allocated memories to the trie
+ * @brief Compares the visit counts for sorting them in descending order; 
+ * the states with equal counts keep their order
  * 
- * @param thiz pointer to the trie
+ * @param l
+ * @param r
+ * @return
  *****************************************************************************/
-void ac_trie_release (AC_TRIE_t *thiz)
+static int ac_trie_compare_visits (const void *l, const void *r)
 {
-    /* It must be called with a 0 top-down parameter */
-    ac_trie_traverse_action (thiz->root, node_release_vectors, 0);
+    const struct ac_visit *lv = (const struct ac_visit *) l;
+    const struct ac_visit *rv = (const struct ac_visit *) r;
     
-    mf_repdata_release (&thiz->repdata);
-    mpool_free(thiz->mp);
-    free(thiz);
+    if (lv->count != rv->count)
+        return (lv->count > rv->count) ? -1 : 1;
+    
+    return (lv->state > rv->state) - (lv->state < rv->state);
 }
 
 /**
- * @brief Prints the trie to output in human readable form. It is useful 
- * for debugging purpose.
+ * @brief Reports the patterns matched at the given state to the caller
  * 
- * @param thiz pointer to the trie
+ * If the state has no output link, its own patterns are reported in place;
+ * otherwise the patterns of the output chain are assembled in @p matches.
+ * 
+ * @param arena
+ * @param state the final state
+ * @param position the end position of the matched patterns
+ * @param matches the buffer to assemble the matched patterns in
+ * @param callback the match call-back function
+ * @param user this parameter will be send to the call-back function
+ * 
+ * @return the return value of the call-back function
  *****************************************************************************/
-void ac_trie_display (AC_TRIE_t *thiz)
+static int ac_trie_report (const ACT_ARENA_t *arena, ACT_STATE_t state, 
+        size_t position, AC_PATTERN_t *matches, 
+        AC_MATCH_CALBACK_f callback, void *user)
 {
-    ac_trie_traverse_action (thiz->root, node_display, 1);
+    AC_MATCH_t match;
+    const struct act_state_info *info = &arena->infos[state];
+    
+    /* Found a match! */
+    match.position = position;
+    
+    if (info->output == ARENA_NONE && !arena->removed)
+    {
+        match.size = info->matched_size;
+        match.patterns = &arena->matched[info->matched];
+    }
+    else
+    {
+        match.size = arena_collect_matches (arena, state, matches);
+        match.patterns = matches;
+        
+        /* All the patterns may be removed */
+        if (!match.size)
+            return 0;
+    }
+    
+    /* Do call-back */
+    return callback (&match, user);
 }
 
 /**
@@ -449,70 +2255,129 @@ static int ac_trie_match_handler (AC_MATCH_t * matchp, void * param)
  *****************************************************************************/
 static void ac_trie_reset (AC_TRIE_t *thiz)
 {
-    thiz->last_node = thiz->root;
+    thiz->last_state = ARENA_ROOT;
     thiz->base_position = 0;
+    if (thiz->tails)
+        tails_reset (thiz->tails);
+    if (thiz->delta_search)
+        delta_search_reset (thiz->delta_search);
     mf_repdata_reset (&thiz->repdata);
 }
 
 /**
- * @brief Finds and bookmarks the failure transition for the given node.
+ * @brief Sets the failure transition node for all nodes
+ * 
+ * Traverses all trie nodes using BFS (Breadth First Search). The failure 
+ * node of a node is derived from the failure node of its parent, which is 
+ * already set because it is shallower. Meanwhile, the edges of every node 
+ * are sorted before its children look it up, and the output links are set.
+ * This function is called after adding last pattern to trie.
  * 
- * @param node the node pointer
- * @param prefix The array that contain the prefix that leads the path from
- * root the the node.
+ * @param thiz pointer to the trie
  *****************************************************************************/
-static void ac_trie_set_failure
-    (ACT_NODE_t *node, AC_ALPHABET_t *prefix)
+static void ac_trie_set_failures (AC_TRIE_t *thiz)
 {
-    size_t i, j;
-    ACT_NODE_t *n;
-    ACT_NODE_t *root = node->trie->root;
+    size_t i, head = 0, tail = 0;
+    size_t capacity = 1024;
+    ACT_NODE_t **queue, *node, *next, *fail, *n;
+    AC_ALPHABET_t alpha;
     
-    if (node == root)
-        return; /* Failure transition is not defined for the root */
+    queue = (ACT_NODE_t **) malloc (capacity * sizeof(ACT_NODE_t *));
+    queue[tail++] = thiz->root;
     
-    for (i = 1; i < node->depth; i++)
+    /* Failure transition is not defined for the root */
+    thiz->root->failure_node = NULL;
+    
+    while (head < tail)
     {
-        n = root;
-        for (j = i; j < node->depth && n; j++)
-            n = node_find_next (n, prefix[j]);
-        if (n)
+        node = queue[head++];
+        node_sort_edges (node);
+        
+        if (tail + node->outgoing_size > capacity)
         {
-            node->failure_node = n;
-            break;
+            capacity = 2 * (tail + node->outgoing_size);
+            queue = (ACT_NODE_t **) realloc 
+                    (queue, capacity * sizeof(ACT_NODE_t *));
+        }
+        
+        for (i = 0; i < node->outgoing_size; i++)
+        {
+            alpha = node->outgoing[i].alpha;
+            next = node->outgoing[i].next;
+            
+            /* Follow the failure chain of the parent until a node that has
+             * a transition for the same alpha */
+            n = NULL;
+            for (fail = node->failure_node; fail; fail = fail->failure_node)
+                if ((n = node_find_next_bs (fail, alpha)))
+                    break;
+            
+            next->failure_node = n ? n : thiz->root;
+            node_link_outputs (next);
+            
+            queue[tail++] = next;
         }
     }
     
-    if (!node->failure_node)
-        node->failure_node = root;
+    free (queue);
 }
 
 /**
- * @brief Sets the failure transition node for all nodes
+ * @brief Tells if any pattern at or below the node has a replacement
  * 
- * Traverse all trie nodes using DFS (Depth First Search), meanwhile it set
- * the failure node for every node it passes through. this function is called 
- * after adding last pattern to trie.
- * 
- * @param node The pointer to the root node
- * @param prefix The array that contain the prefix that leads the path from
- * root the the node
+ * @param node
+ * @return
  *****************************************************************************/
-static void ac_trie_traverse_setfailure 
-    (ACT_NODE_t *node, AC_ALPHABET_t *prefix)
+static int ac_trie_has_replacement (ACT_NODE_t *node)
 {
+    ACT_NODE_WALK_t walk;
+    ACT_NODE_t *nod;
     size_t i;
+    int leaving, found = 0;
+    
+    node_walk_init (&walk, node);
+    
+    while (!found && (nod = node_walk_next (&walk, &leaving)))
+        for (i = 0; !leaving && i < nod->matched_size; i++)
+            if (nod->matched[i].rtext.astring)
+                found = 1;
+    
+    node_walk_release (&walk);
+    
+    return found;
+}
+
+/**
+ * @brief Cuts the trie below AC_TRUNCATE_DEPTH
+ * 
+ * Every node at that depth takes the patterns of the nodes below it as its
+ * tail patterns; see node_cut_tails(). If @p dawg is given, the nodes below
+ * are added to it before they are cut. It must be called before setting the
+ * failures. At top level it should be called by sending the root node.
+ * 
+ * @param node
+ * @param dawg the minimized graph of the tails, or NULL
+ *****************************************************************************/
+static void ac_trie_truncate (ACT_NODE_t *node, ACT_DAWG_t *dawg)
+{
+    ACT_NODE_WALK_t walk;
+    ACT_NODE_t *nod;
+    int leaving;
     
-    /* In each node, look for its failure node */
-    ac_trie_set_failure (node, prefix);
+    node_walk_init (&walk, node);
     
-    for (i = 0; i < node->outgoing_size; i++)
+    while ((nod = node_walk_next (&walk, &leaving)))
     {
-        prefix[node->depth] = node->outgoing[i].alpha; /* Make the prefix */
+        if (leaving || nod->depth != AC_TRUNCATE_DEPTH)
+            continue;
         
-        /* Recursively call itself to traverse all nodes */
-        ac_trie_traverse_setfailure (node->outgoing[i].next, prefix);
+        /* Cutting the node leaves no edge to walk below it */
+        if (dawg && nod->outgoing_size)
+            nod->tails_root = dawg_add (dawg, nod);
+        node_cut_tails (nod);
     }
+    
+    node_walk_release (&walk);
 }
 
 /**
@@ -528,15 +2393,15 @@ static void ac_trie_traverse_setfailure
 static void ac_trie_traverse_action 
     (ACT_NODE_t *node, void(*func)(ACT_NODE_t *), int top_down)
 {
-    size_t i;
+    ACT_NODE_WALK_t walk;
+    ACT_NODE_t *nod;
+    int leaving;
     
-    if (top_down)
-        func (node);
+    node_walk_init (&walk, node);
     
-    for (i = 0; i < node->outgoing_size; i++)
-        /* Recursively call itself to traverse all nodes */
-        ac_trie_traverse_action (node->outgoing[i].next, func, top_down);
+    while ((nod = node_walk_next (&walk, &leaving)))
+        if (leaving != top_down)
+            func (nod);
     
-    if (!top_down)
-        func (node);
+    node_walk_release (&walk);
 }
@@ -29,6 +29,15 @@ extern "C" {
 
 /* Forward declaration */
 struct act_node;
+struct act_arena;
+struct act_dfa;
+struct act_skip;
+struct act_tails;
+struct act_dawg;
+struct act_image;
+struct act_delta;
+struct act_delta_search;
+struct act_wide;
 struct mpool;
 
 /* 
@@ -36,15 +45,46 @@ struct mpool;
  */
 typedef struct ac_trie
 {
-    struct act_node *root;      /**< The root node of the trie */
+    struct act_node *root;      /**< The root node of the trie; the nodes 
+                                 * are released when the trie is finalized */
     
     size_t patterns_count;      /**< Total patterns in the trie */
     
+    unsigned char *map;     /**< The byte map that the patterns and the text
+                             * go through, or NULL; see 
+                             * ac_trie_create_mapped() */
+    
+    struct act_wide *wide;  /**< The symbol classes of a trie of wide 
+                             * symbols, or NULL; see ac_trie_create_wide() */
+    
     short trie_open; /**< This flag indicates that if trie is finalized 
-                          * or not. After finalizing the trie you can not 
-                          * add pattern to trie anymore. */
+                          * or not. The patterns that are added or removed
+                          * after finalizing go to the delta. */
+    
+    int options;    /**< The options that the trie is finalized with */
     
     struct mpool *mp;   /**< Memory pool */
+    struct mpool *nodes_mp; /**< Memory pool of the trie nodes */
+    
+    struct act_arena *arena;    /**< The flat search structure that replaces
+                                 * the nodes after finalizing */
+    
+    struct act_dfa *dfa;    /**< The DFA transition table; it is built by
+                             * ac_trie_finalize_opt() on demand */
+    
+    struct act_skip *skip;  /**< The root-state skip scanner, or NULL */
+    
+    struct act_image *image;    /**< The image that the trie is loaded from,
+                                 * or NULL; see ac_trie_load() */
+    
+    struct act_delta *delta;    /**< The patterns that are added or removed
+                                 * after finalizing, or NULL */
+    
+    unsigned long generation;   /**< Incremented whenever finalizing again
+                                 * changes the search structures */
+    
+    AC_STATISTICS_t stats;  /**< Statistics of the patterns; they are 
+                             * gathered by finalizing the trie */
     
     /* ******************* Thread specific part ******************** */
     
@@ -52,7 +92,7 @@ typedef struct ac_trie
      * connect these chunks and make a continuous view of the input, we need 
      * the following variables.
      */
-    struct act_node *last_node; /**< Last node we stopped at */
+    ACT_STATE_t last_state; /**< Last state we stopped at */
     size_t base_position; /**< Represents the position of the current chunk,
                            * related to whole input text */
     
@@ -60,6 +100,18 @@ typedef struct ac_trie
     size_t position;    /**< A helper variable to hold the relative current 
                          * position in the given text */
     
+    AC_PATTERN_t *matches;  /**< A helper buffer to assemble the patterns of
+                             * a match from the output chain */
+    
+    struct act_tails *tails;    /**< The tail patterns being verified, if 
+                                 * the trie is truncated */
+    
+    struct act_dawg *dawg;  /**< The minimized tail patterns, if the trie 
+                             * is minimized */
+    
+    struct act_delta_search *delta_search;  /**< The state of the search in
+                                             * the delta, if there is one */
+    
     MF_REPLACEMENT_DATA_t repdata;    /**< Replacement data structure */
     
     ACT_WORKING_MODE_t wm; /**< Working mode */
@@ -74,7 +126,7 @@ typedef struct ac_search
      * connect these chunks and make a continuous view of the input, we need
      * the following variables.
      */
-    struct act_node *last_node; /**< Last node we stopped at */
+    ACT_STATE_t last_state; /**< Last state we stopped at */
     size_t base_position; /**< Represents the position of the current chunk,
                            * related to whole input text */
 
@@ -82,6 +134,18 @@ typedef struct ac_search
     size_t position;    /**< A helper variable to hold the relative current
                          * position in the given text */
 
+    AC_PATTERN_t *matches;  /**< A helper buffer to assemble the patterns of
+                             * a match from the output chain */
+
+    struct act_tails *tails;    /**< The tail patterns being verified, if 
+                                 * the trie is truncated */
+
+    unsigned long generation;   /**< The generation of the trie that the 
+                                 * payload is made for */
+    
+    struct act_delta_search *delta_search;  /**< The state of the search in
+                                             * the delta, if there is one */
+
 } AC_SEARCH_PAYLOAD_t;
 
 /* 
@@ -89,19 +153,69 @@ typedef struct ac_search
  */
 
 AC_TRIE_t *ac_trie_create (void);
+AC_TRIE_t *ac_trie_create_mapped (const unsigned char map[AC_MAP_SIZE]);
+AC_TRIE_t *ac_trie_create_nocase (void);
+
+/* 
+ * A pattern that is added with copy = 0 is not copied: its strings must 
+ * stay valid as long as the trie lives. Finalizing reads them again, and 
+ * the matches point at them.
+ * 
+ * Patterns can be added to and removed from a finalized trie as well; 
+ * ac_trie_add() no longer returns ACERR_TRIE_CLOSED for it. The changes are
+ * searched once the trie is finalized again: until then, the searches find
+ * the patterns that the trie had when it was last finalized.
+ */
 AC_STATUS_t ac_trie_add (AC_TRIE_t *thiz, AC_PATTERN_t *patt, int copy);
+AC_STATUS_t ac_trie_remove (AC_TRIE_t *thiz, AC_PATTERN_t *patt);
 void ac_trie_finalize (AC_TRIE_t *thiz);
+void ac_trie_finalize_opt (AC_TRIE_t *thiz, int options);
+AC_TRIE_t *ac_trie_compact (const AC_TRIE_t *thiz);
 void ac_trie_release (AC_TRIE_t *thiz);
 void ac_trie_display (AC_TRIE_t *thiz);
+int  ac_trie_warmup (AC_TRIE_t *thiz, int lock);
+int  ac_trie_optimize (AC_TRIE_t *thiz, AC_TEXT_t *samples, size_t count);
+int  ac_trie_save (AC_TRIE_t *thiz, const char *path);
+AC_TRIE_t *ac_trie_load (const char *path, int verify);
+int  ac_trie_share (AC_TRIE_t *thiz, const char *name);
+AC_TRIE_t *ac_trie_attach (const char *name, int verify);
+int  ac_trie_unshare (const char *name);
+AC_ENGINE_t ac_trie_engine (AC_TRIE_t *thiz);
+AC_PREFILTER_t ac_trie_prefilter (AC_TRIE_t *thiz);
 AC_TRIE_t *ac_create_from_dict(char *dict_path);
 
+/* 
+ * A trie of wide symbols takes the patterns and the texts as arrays of 
+ * uint8_t, uint16_t or uint32_t, by the width it is created with; the 
+ * lengths and the positions are counted in symbols. Besides these, only 
+ * finalizing, releasing, ac_trie_warmup() and the queries of the engine 
+ * apply to it; the other functions refuse it.
+ */
+AC_TRIE_t *ac_trie_create_wide (size_t width);
+AC_STATUS_t ac_trie_add_wide (AC_TRIE_t *thiz, const void *symbols, 
+        size_t length, AC_PATTID_t id);
+AC_STATUS_t ac_trie_remove_wide (AC_TRIE_t *thiz, const void *symbols, 
+        size_t length);
+int  ac_trie_search_wide (AC_TRIE_t *thiz, const void *text, size_t length,
+        int keep, AC_MATCH_CALBACK_f callback, void *param);
+
+/* 
+ * A search payload owns its match buffer and the state of its tail and 
+ * delta searches, besides the text. Unlike in the previous versions, it 
+ * must be released by ac_search_payload_release(); freeing it, or dropping
+ * it, leaks them.
+ */
 AC_SEARCH_PAYLOAD_t *ac_search_payload_create(const AC_TRIE_t *trie, const AC_ALPHABET_t *alphabet);
+void ac_search_payload_release (AC_SEARCH_PAYLOAD_t *search_payload);
 int  ac_trie_search (AC_TRIE_t *thiz, AC_TEXT_t *text, int keep,
         AC_MATCH_CALBACK_f callback, void *param);
 
 int  ac_trie_search_thread_safe (AC_TRIE_t *thiz, AC_SEARCH_PAYLOAD_t *search_payload, int keep,
                                  AC_MATCH_CALBACK_f callback, void *param);
 
+int  ac_trie_search_batch (AC_TRIE_t *thiz, AC_TEXT_t *texts, size_t count,
+        AC_MATCH_CALBACK_f callback, void **params);
+
 void ac_trie_settext (AC_TRIE_t *thiz, AC_TEXT_t *text, int keep);
 AC_MATCH_t ac_trie_findnext (AC_TRIE_t *thiz);
 
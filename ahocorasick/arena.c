@@ -0,0 +1,1233 @@
+/*
+ * arena.c: Converts a finalized trie into the flat search structure
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "node.h"
+#include "arena.h"
+#include "pages.h"
+#include "ahocorasick.h"
+
+/* Privates */
+static ACT_NODE_t **arena_number_nodes (ACT_NODE_t *root, size_t *count);
+static size_t arena_split_chains (ACT_NODE_t **nodes, size_t count);
+static void arena_display_edge 
+    (ACT_ARENA_t *thiz, ACT_CLASS_t label, uint32_t target);
+static void arena_make_classes 
+    (ACT_ARENA_t *thiz, ACT_NODE_t **nodes, size_t count);
+static void arena_map_classes (ACT_ARENA_t *thiz, const unsigned char *map);
+static void arena_sort_edges (ACT_ARENA_t *thiz, struct act_state *state);
+static uint32_t arena_pattern_index 
+    (ACT_ARENA_t *thiz, ACT_NODE_t *node, AC_PATTERN_t *pattern);
+static void arena_alloc_block (ACT_ARENA_t *thiz, int huge);
+static unsigned int arena_choose_encoding 
+    (ACT_ARENA_t *thiz, size_t edges_count, int root);
+static void arena_encode_state (ACT_ARENA_t *thiz, struct act_state *state,
+        uint32_t *bitmap, uint32_t *dense);
+static size_t arena_align (size_t size);
+static int arena_tail_compare (const void *l, const void *r);
+static int arena_check_states (const ACT_ARENA_t *thiz);
+static int arena_check_depths (const ACT_ARENA_t *thiz, uint32_t *depths,
+        uint32_t *path);
+static int arena_check_outputs (const ACT_ARENA_t *thiz, 
+        const uint32_t *depths, uint32_t *path);
+static int arena_check_tails (const ACT_ARENA_t *thiz, 
+        const uint32_t *depths);
+
+
+/**
+ * @brief Creates the arena of the given trie
+ *
+ * The trie must have passed the failure, match collection and replacement
+ * booking stages of finalizing. The states are numbered in BFS order, so
+ * the failure state of every state has a smaller number, except the chain
+ * states that are numbered after the others. The trie nodes are not touched
+ * and can be released afterwards.
+ *
+ * @param trie
+ * @param options OR'ed values of ACT_FINALIZE_OPTION_t
+ * @return
+ *****************************************************************************/
+ACT_ARENA_t *arena_create (struct ac_trie *trie, int options)
+{
+    size_t i, j, count, base;
+    uint32_t edge = 0, matched = 0, bitmap = 0, dense = 0;
+    uint32_t *totals;
+    ACT_NODE_t **nodes, *node;
+    struct act_state *state;
+    struct act_state_info *info;
+    struct act_chain *chain;
+    ACT_ARENA_t *thiz;
+
+    nodes = arena_number_nodes (trie->root, &count);
+    base = arena_split_chains (nodes, count);
+
+    thiz = (ACT_ARENA_t *) malloc (sizeof(ACT_ARENA_t));
+    thiz->states_count = count;
+    thiz->chain_base = base;
+    thiz->edges_count = 0;
+    thiz->matched_count = 0;
+    thiz->bitmaps_count = 0;
+    thiz->dense_count = 0;
+    thiz->tails_count = 0;
+    thiz->removed = NULL;
+
+    arena_make_classes (thiz, nodes, count);
+
+    for (i = 0; i < base; i++)
+    {
+        thiz->edges_count += nodes[i]->outgoing_size;
+        thiz->matched_count += nodes[i]->matched_size + nodes[i]->tails_size;
+        if (nodes[i]->tails_size)
+            thiz->tails_count++;
+
+        switch (arena_choose_encoding (thiz, nodes[i]->outgoing_size, i == 0))
+        {
+        case ARENA_ENC_BITMAP:
+            thiz->bitmaps_count++;
+            break;
+        case ARENA_ENC_DENSE:
+            thiz->dense_count += thiz->classes_count;
+            break;
+        }
+    }
+
+    arena_alloc_block (thiz, options & AC_FINALIZE_HUGE_PAGES);
+
+    /* Number of all the patterns that each state matches */
+    totals = (uint32_t *) malloc (base * sizeof(uint32_t));
+    thiz->matches_max = 0;
+
+    for (i = 0; i < base; i++)
+    {
+        node = nodes[i];
+        state = &thiz->states[i];
+        info = &thiz->infos[i];
+
+        state->failure = node->failure_node ?
+                node->failure_node->state : ARENA_NONE;
+        state->edges = edge;
+        state->edges_count = node->outgoing_size;
+        state->flags = node->final ? ARENA_STATE_FINAL : 0;
+        if (node->tails_size)
+            state->flags |= ARENA_STATE_TAIL;
+
+        for (j = 0; j < node->outgoing_size; j++, edge++)
+        {
+            thiz->labels[edge] = ARENA_CLASS(thiz, node->outgoing[j].alpha);
+            thiz->targets[edge] = node->outgoing[j].next->state;
+        }
+        arena_sort_edges (thiz, state);
+        arena_encode_state (thiz, state, &bitmap, &dense);
+
+        info->depth = node->depth;
+        info->matched = matched;
+        info->matched_size = node->matched_size;
+        info->output = node->output_node ?
+                node->output_node->state : ARENA_NONE;
+
+        if (node->matched_size)
+            memcpy (&thiz->matched[matched], node->matched,
+                    node->matched_size * sizeof(AC_PATTERN_t));
+        matched += node->matched_size;
+
+        /* The output state comes before this state in BFS order */
+        info->to_be_replaced = node->to_be_replaced ? arena_pattern_index 
+                (thiz, node, node->to_be_replaced) : ARENA_NONE;
+
+        totals[i] = node->matched_size + 
+                (info->output != ARENA_NONE ? totals[info->output] : 0);
+        if (totals[i] > thiz->matches_max)
+            thiz->matches_max = totals[i];
+    }
+
+    /* The tail patterns come after the patterns of the states */
+    for (i = 0, j = 0; i < base; i++)
+    {
+        node = nodes[i];
+        if (!node->tails_size)
+            continue;
+
+        thiz->tails[j].state = i;
+        thiz->tails[j].patterns = matched;
+        thiz->tails[j].patterns_size = node->tails_size;
+        thiz->tails[j++].root = node->tails_root;
+
+        memcpy (&thiz->matched[matched], node->tails,
+                node->tails_size * sizeof(AC_PATTERN_t));
+        matched += node->tails_size;
+    }
+
+    for (i = base; i < count; i++)
+    {
+        node = nodes[i];
+        chain = &thiz->chains[i - base];
+
+        chain->next = node->outgoing[0].next->state;
+        chain->failure = node->failure_node->state;
+        thiz->chain_labels[i - base] = 
+                ARENA_CLASS(thiz, node->outgoing[0].alpha);
+    }
+
+    /* The edges are labeled by the mapped bytes; the text is classified 
+     * through the map from now on */
+    if (trie->map)
+        arena_map_classes (thiz, trie->map);
+
+    free (totals);
+    free (nodes);
+
+    return thiz;
+}
+
+/**
+ * @brief Releases the arena
+ *
+ * @param thiz
+ *****************************************************************************/
+void arena_release (ACT_ARENA_t *thiz)
+{
+    if (!thiz)
+        return;
+
+    /* The patterns of a loaded arena are not in its block */
+    if (thiz->block_mapped == PAGES_IMAGE)
+        free (thiz->matched);
+
+    pages_free (thiz->block, thiz->block_size, thiz->block_mapped);
+    free (thiz);
+}
+
+/**
+ * @brief Renumbers the states of the arena
+ *
+ * The states, their edges and their dense tables and bitmaps are laid out 
+ * again in the given order, so the states that come first are packed 
+ * together. The root must stay the first state. The failure states do not
+ * come before their states anymore, unless the order is a BFS order. The 
+ * chain states keep their numbers.
+ *
+ * @param thiz
+ * @param order the old number of every new state below chain_base
+ *****************************************************************************/
+void arena_reorder (ACT_ARENA_t *thiz, const uint32_t *order)
+{
+    size_t i, j;
+    uint32_t edge = 0, bitmap = 0, dense = 0;
+    uint32_t *numbers;
+    const struct act_state *old;
+    struct act_state *state;
+    struct act_state_info *info;
+    struct act_chain *chain;
+    ACT_ARENA_t fresh = *thiz;
+
+    /* The new number of every old state */
+    numbers = (uint32_t *) malloc (thiz->states_count * sizeof(uint32_t));
+    for (i = 0; i < thiz->chain_base; i++)
+        numbers[order[i]] = i;
+    for (i = thiz->chain_base; i < thiz->states_count; i++)
+        numbers[i] = i;
+
+    arena_alloc_block (&fresh, thiz->block_mapped == PAGES_MAPPED);
+
+    for (i = 0; i < thiz->chain_base; i++)
+    {
+        old = &thiz->states[order[i]];
+        state = &fresh.states[i];
+        info = &fresh.infos[i];
+
+        *state = *old;
+        state->failure = (old->failure != ARENA_NONE) ? 
+                numbers[old->failure] : ARENA_NONE;
+        state->edges = edge;
+
+        for (j = 0; j < old->edges_count; j++, edge++)
+        {
+            fresh.labels[edge] = thiz->labels[old->edges + j];
+            fresh.targets[edge] = numbers[thiz->targets[old->edges + j]];
+        }
+
+        switch (state->encoding)
+        {
+        case ARENA_ENC_BITMAP:
+            state->aux = bitmap++;
+            fresh.bitmaps[state->aux] = thiz->bitmaps[old->aux];
+            break;
+
+        case ARENA_ENC_DENSE:
+            state->aux = dense;
+            dense += thiz->classes_count;
+            for (j = 0; j < thiz->classes_count; j++)
+                fresh.dense[state->aux + j] = 
+                        (thiz->dense[old->aux + j] != ARENA_NONE) ? 
+                        numbers[thiz->dense[old->aux + j]] : ARENA_NONE;
+            break;
+        }
+
+        *info = thiz->infos[order[i]];
+        if (info->output != ARENA_NONE)
+            info->output = numbers[info->output];
+    }
+
+    for (i = 0; i < thiz->tails_count; i++)
+    {
+        fresh.tails[i] = thiz->tails[i];
+        fresh.tails[i].state = numbers[thiz->tails[i].state];
+    }
+    qsort (fresh.tails, fresh.tails_count, sizeof(struct act_tail), 
+            arena_tail_compare);
+
+    for (i = 0; i < thiz->states_count - thiz->chain_base; i++)
+    {
+        chain = &fresh.chains[i];
+        chain->next = numbers[thiz->chains[i].next];
+        chain->failure = numbers[thiz->chains[i].failure];
+        fresh.chain_labels[i] = thiz->chain_labels[i];
+    }
+
+    memcpy (fresh.matched, thiz->matched, 
+            thiz->matched_count * sizeof(AC_PATTERN_t));
+    if (thiz->block_mapped == PAGES_IMAGE)
+        free (thiz->matched);
+
+    pages_free (thiz->block, thiz->block_size, thiz->block_mapped);
+    *thiz = fresh;
+
+    free (numbers);
+}
+
+/**
+ * @brief Finds the depth of a state
+ *
+ * The chain states do not keep their depth; it is found from the end of 
+ * their chain.
+ *
+ * @param thiz
+ * @param state
+ * @return The depth of the state
+ *****************************************************************************/
+uint32_t arena_depth (const ACT_ARENA_t *thiz, uint32_t state)
+{
+    uint32_t steps = 0;
+
+    while (ARENA_IS_CHAIN(thiz, state))
+    {
+        state = thiz->chains[state - thiz->chain_base].next;
+        steps++;
+    }
+
+    return thiz->infos[state].depth - steps;
+}
+
+/**
+ * @brief Checks that an arena which is not built here, but loaded from an 
+ * image, can be searched
+ *
+ * Every index must be in the range of its array: the failure states, the 
+ * edge targets, the dense entries, the output states, the matched patterns
+ * of the states and the tails. The failure and output chains must lead to 
+ * shallower states, so that they end, and no output chain may collect more
+ * than matches_max patterns. It reads the whole arena once; the matched 
+ * patterns must be set.
+ *
+ * @param thiz
+ * @return 0 if the arena is sound, -1 otherwise
+ *****************************************************************************/
+int arena_check (const ACT_ARENA_t *thiz)
+{
+    uint32_t *depths, *path;
+    int result;
+
+    if (thiz->states_count == 0 || thiz->chain_base == 0 || 
+            thiz->chain_base > thiz->states_count ||
+            thiz->states_count >= ARENA_NONE ||
+            thiz->matches_max > thiz->matched_count ||
+            arena_check_states (thiz))
+        return -1;
+
+    depths = (uint32_t *) malloc (thiz->states_count * sizeof(uint32_t));
+    path = (uint32_t *) malloc ((AC_PATTRN_MAX_LENGTH + 2) * 
+            sizeof(uint32_t));
+
+    result = (arena_check_depths (thiz, depths, path) ||
+            arena_check_outputs (thiz, depths, path) ||
+            arena_check_tails (thiz, depths)) ? -1 : 0;
+
+    free (depths);
+    free (path);
+
+    return result;
+}
+
+/**
+ * @brief Finds the tail patterns of a state
+ *
+ * @param thiz
+ * @param state
+ * @return The tail patterns, or NULL if the state has none
+ *****************************************************************************/
+const struct act_tail *arena_find_tail 
+    (const ACT_ARENA_t *thiz, uint32_t state)
+{
+    struct act_tail key;
+
+    key.state = state;
+
+    return (const struct act_tail *) bsearch (&key, thiz->tails, 
+            thiz->tails_count, sizeof(struct act_tail), arena_tail_compare);
+}
+
+/**
+ * @brief Gathers the statistics of the patterns and the states
+ *
+ * @param thiz
+ * @param stats
+ *****************************************************************************/
+void arena_statistics (const ACT_ARENA_t *thiz, AC_STATISTICS_t *stats)
+{
+    size_t i, length, total_length = 0, inner_states = 0, chain_states;
+    unsigned char root_classes[ARENA_ALPHABET_SIZE] = {0};
+    const struct act_state *s;
+
+    stats->patterns_count = thiz->matched_count;
+    stats->min_length = thiz->matched_count ? SIZE_MAX : 0;
+    stats->max_length = 0;
+    stats->distinct_bytes = 0;
+    stats->start_bytes = 0;
+    stats->states_count = thiz->states_count;
+    stats->max_fanout = 0;
+
+    for (i = 0; i < thiz->matched_count; i++)
+    {
+        length = thiz->matched[i].ptext.length;
+        total_length += length;
+        if (length < stats->min_length)
+            stats->min_length = length;
+        if (length > stats->max_length)
+            stats->max_length = length;
+    }
+
+    s = &thiz->states[ARENA_ROOT];
+    for (i = 0; i < s->edges_count; i++)
+        root_classes[thiz->labels[s->edges + i]] = 1;
+
+    for (i = 0; i < ARENA_ALPHABET_SIZE; i++)
+    {
+        if (thiz->classes[i] != thiz->void_class)
+            stats->distinct_bytes++;
+        if (root_classes[thiz->classes[i]])
+            stats->start_bytes++;
+    }
+
+    for (i = 0; i < thiz->chain_base; i++)
+    {
+        s = &thiz->states[i];
+        if (s->edges_count)
+            inner_states++;
+        if (s->edges_count > stats->max_fanout)
+            stats->max_fanout = s->edges_count;
+    }
+
+    /* Every chain state has a single edge */
+    chain_states = thiz->states_count - thiz->chain_base;
+    if (chain_states && stats->max_fanout == 0)
+        stats->max_fanout = 1;
+
+    stats->mean_length = thiz->matched_count ? 
+            (double) total_length / thiz->matched_count : 0;
+    stats->mean_fanout = (inner_states + chain_states) ? 
+            (double) (thiz->edges_count + chain_states) / 
+            (inner_states + chain_states) : 0;
+}
+
+/**
+ * @brief Collects all the patterns that a state matches
+ *
+ * The own patterns of the state come first, then the patterns of the states
+ * on its output chain. The removed patterns are left out.
+ *
+ * @param thiz
+ * @param state
+ * @param buffer receives the patterns; it must have room for matches_max 
+ * patterns
+ * @return number of the collected patterns
+ *****************************************************************************/
+size_t arena_collect_matches 
+    (const ACT_ARENA_t *thiz, uint32_t state, AC_PATTERN_t *buffer)
+{
+    size_t size = 0;
+    const struct act_state_info *info;
+    uint32_t i;
+
+    while (state != ARENA_NONE)
+    {
+        info = &thiz->infos[state];
+        if (thiz->removed)
+        {
+            for (i = info->matched; i < info->matched + info->matched_size; 
+                    i++)
+                if (!thiz->removed[i])
+                    buffer[size++] = thiz->matched[i];
+        }
+        else
+        {
+            memcpy (&buffer[size], &thiz->matched[info->matched],
+                    info->matched_size * sizeof(AC_PATTERN_t));
+            size += info->matched_size;
+        }
+        state = info->output;
+    }
+
+    return size;
+}
+
+/**
+ * @brief Finds the index of a pattern in the matched array
+ *
+ * The pattern belongs to the node itself or to a node on its output chain.
+ * The states of those nodes must be filled already.
+ *
+ * @param thiz
+ * @param node
+ * @param pattern
+ * @return
+ *****************************************************************************/
+static uint32_t arena_pattern_index 
+    (ACT_ARENA_t *thiz, ACT_NODE_t *node, AC_PATTERN_t *pattern)
+{
+    for (; node; node = node->output_node)
+        if (pattern >= node->matched && 
+                pattern < node->matched + node->matched_size)
+            return thiz->infos[node->state].matched + 
+                    (pattern - node->matched);
+
+    return ARENA_NONE;
+}
+
+/**
+ * A node makes a chain state if it is not the root, is not final and has a
+ * single outgoing edge
+ */
+#define ARENA_NODE_IS_CHAIN(node) \
+    ((node)->depth > 0 && !(node)->final && (node)->outgoing_size == 1)
+
+/**
+ * @brief Renumbers the nodes so the chain states come last
+ *
+ * Both the chain nodes and the other nodes keep their BFS order, so the 
+ * shallow chain states, which the search visits the most, are packed 
+ * together.
+ *
+ * @param nodes the nodes in BFS order; they are reordered in place
+ * @param count number of the nodes
+ * @return Number of the nodes that are not chain nodes
+ *****************************************************************************/
+static size_t arena_split_chains (ACT_NODE_t **nodes, size_t count)
+{
+    size_t i, base = 0, last;
+    ACT_NODE_t **sorted;
+
+    sorted = (ACT_NODE_t **) malloc (count * sizeof(ACT_NODE_t *));
+
+    for (i = 0; i < count; i++)
+        if (!ARENA_NODE_IS_CHAIN(nodes[i]))
+            sorted[base++] = nodes[i];
+
+    last = base;
+    for (i = 0; i < count; i++)
+        if (ARENA_NODE_IS_CHAIN(nodes[i]))
+            sorted[last++] = nodes[i];
+
+    for (i = 0; i < count; i++)
+    {
+        nodes[i] = sorted[i];
+        nodes[i]->state = i;
+    }
+
+    free (sorted);
+
+    return base;
+}
+
+/**
+ * @brief Numbers the trie nodes in BFS order
+ *
+ * The returned array is used as the BFS queue itself; it maps the state
+ * numbers to the nodes. The caller must free it.
+ *
+ * @param root
+ * @param count receives the number of nodes
+ * @return
+ *****************************************************************************/
+static ACT_NODE_t **arena_number_nodes (ACT_NODE_t *root, size_t *count)
+{
+    size_t i, head = 0, tail = 0;
+    size_t capacity = 1024;
+    ACT_NODE_t **nodes, *node;
+
+    nodes = (ACT_NODE_t **) malloc (capacity * sizeof(ACT_NODE_t *));
+    nodes[tail++] = root;
+
+    while (head < tail)
+    {
+        node = nodes[head];
+        node->state = head++;
+
+        if (tail + node->outgoing_size > capacity)
+        {
+            capacity = 2 * (tail + node->outgoing_size);
+            nodes = (ACT_NODE_t **) realloc
+                    (nodes, capacity * sizeof(ACT_NODE_t *));
+        }
+
+        for (i = 0; i < node->outgoing_size; i++)
+            nodes[tail++] = node->outgoing[i].next;
+    }
+
+    *count = tail;
+
+    return nodes;
+}
+
+/**
+ * @brief Makes the byte equivalence classes
+ *
+ * Two bytes are equivalent if they lead to the same state from every state.
+ * In a trie two different edge labels of a node never lead to the same
+ * node, so every byte that labels an edge gets a class of its own. All the
+ * other bytes fall into the void class, which comes last.
+ *
+ * @param thiz
+ * @param nodes
+ * @param count
+ *****************************************************************************/
+static void arena_make_classes 
+    (ACT_ARENA_t *thiz, ACT_NODE_t **nodes, size_t count)
+{
+    size_t i, j;
+    unsigned int used[ARENA_ALPHABET_SIZE] = {0};
+    unsigned int classes_count = 0;
+
+    for (i = 0; i < count; i++)
+        for (j = 0; j < nodes[i]->outgoing_size; j++)
+            used[(unsigned char) nodes[i]->outgoing[j].alpha] = 1;
+
+    for (i = 0; i < ARENA_ALPHABET_SIZE; i++)
+        if (used[i])
+            thiz->classes[i] = classes_count++;
+
+    thiz->void_class = classes_count;
+
+    if (classes_count < ARENA_ALPHABET_SIZE)
+    {
+        for (i = 0; i < ARENA_ALPHABET_SIZE; i++)
+            if (!used[i])
+                thiz->classes[i] = thiz->void_class;
+        classes_count++;
+    }
+
+    thiz->classes_count = classes_count;
+}
+
+/**
+ * @brief Makes every byte take the class of the byte it is mapped to
+ *
+ * The patterns were mapped when they were added, so a text byte leads where
+ * its mapped byte does. Folding the map into the classes costs the search
+ * nothing.
+ *
+ * @param thiz
+ * @param map
+ *****************************************************************************/
+static void arena_map_classes (ACT_ARENA_t *thiz, const unsigned char *map)
+{
+    ACT_CLASS_t classes[ARENA_ALPHABET_SIZE];
+    size_t i;
+
+    memcpy (classes, thiz->classes, sizeof(classes));
+
+    for (i = 0; i < ARENA_ALPHABET_SIZE; i++)
+        thiz->classes[i] = classes[map[i]];
+}
+
+/**
+ * @brief Sorts the edges of a state by their labels
+ *
+ * The node edges are sorted by alphabet, which is not the order of the
+ * classes. The edges are few, so insertion sort does the job.
+ *
+ * @param thiz
+ * @param state
+ *****************************************************************************/
+static void arena_sort_edges (ACT_ARENA_t *thiz, struct act_state *state)
+{
+    size_t i, j;
+    ACT_CLASS_t label;
+    uint32_t target;
+    ACT_CLASS_t *labels = &thiz->labels[state->edges];
+    uint32_t *targets = &thiz->targets[state->edges];
+
+    for (i = 1; i < state->edges_count; i++)
+    {
+        label = labels[i];
+        target = targets[i];
+
+        for (j = i; j > 0 && labels[j - 1] > label; j--)
+        {
+            labels[j] = labels[j - 1];
+            targets[j] = targets[j - 1];
+        }
+        labels[j] = label;
+        targets[j] = target;
+    }
+}
+
+/**
+ * @brief Chooses the encoding of a state
+ *
+ * The root and the states with a high fan-out get a dense table; they are 
+ * few and the root is visited the most. Chain states, which are the most,
+ * keep their one or two labels inline.
+ *
+ * @param thiz
+ * @param edges_count number of the outgoing edges of the state
+ * @param root the state is the root
+ * @return
+ *****************************************************************************/
+static unsigned int arena_choose_encoding 
+    (ACT_ARENA_t *thiz, size_t edges_count, int root)
+{
+    if (root || edges_count * ARENA_DENSE_RATIO >= thiz->classes_count)
+        return ARENA_ENC_DENSE;
+    else if (edges_count <= ARENA_INLINE_MAX)
+        return ARENA_ENC_INLINE;
+    else if (edges_count <= ARENA_SORTED_MAX)
+        return ARENA_ENC_SORTED;
+    else
+        return ARENA_ENC_BITMAP;
+}
+
+/**
+ * @brief Builds the encoding of a state. The edges of the state must be 
+ * sorted already.
+ *
+ * @param thiz
+ * @param state
+ * @param bitmap index of the next free bitmap; it will be advanced
+ * @param dense index of the next free dense entry; it will be advanced
+ *****************************************************************************/
+static void arena_encode_state (ACT_ARENA_t *thiz, struct act_state *state,
+        uint32_t *bitmap, uint32_t *dense)
+{
+    size_t i, rank;
+    ACT_CLASS_t *labels = &thiz->labels[state->edges];
+    uint32_t *targets = &thiz->targets[state->edges];
+    struct act_bitmap *bm;
+
+    state->encoding = arena_choose_encoding 
+            (thiz, state->edges_count, state == thiz->states);
+    state->aux = 0;
+
+    switch (state->encoding)
+    {
+    case ARENA_ENC_INLINE:
+        for (i = 0; i < state->edges_count; i++)
+            state->aux |= (uint32_t)labels[i] << (16 * i);
+        break;
+
+    case ARENA_ENC_BITMAP:
+        state->aux = (*bitmap)++;
+        bm = &thiz->bitmaps[state->aux];
+        memset (bm, 0, sizeof(struct act_bitmap));
+
+        for (i = 0; i < state->edges_count; i++)
+            bm->bits[labels[i] >> 6] |= (uint64_t)1 << (labels[i] & 63);
+
+        for (i = 0, rank = 0; i < 4; i++)
+        {
+            bm->ranks[i] = rank;
+            rank += ARENA_POPCOUNT(bm->bits[i]);
+        }
+        break;
+
+    case ARENA_ENC_DENSE:
+        state->aux = *dense;
+        *dense += thiz->classes_count;
+
+        for (i = 0; i < thiz->classes_count; i++)
+            thiz->dense[state->aux + i] = ARENA_NONE;
+        for (i = 0; i < state->edges_count; i++)
+            thiz->dense[state->aux + labels[i]] = targets[i];
+        break;
+    }
+}
+
+/**
+ * @brief Rounds up the size to a multiple of 16
+ *
+ * @param size
+ * @return
+ *****************************************************************************/
+static size_t arena_align (size_t size)
+{
+    return (size + 15) & ~((size_t)0xF);
+}
+
+/**
+ * @brief Compares the states of two tails for sorting and searching them
+ *
+ * @param l
+ * @param r
+ * @return
+ *****************************************************************************/
+static int arena_tail_compare (const void *l, const void *r)
+{
+    const struct act_tail *lt = (const struct act_tail *) l;
+    const struct act_tail *rt = (const struct act_tail *) r;
+
+    return (lt->state > rt->state) - (lt->state < rt->state);
+}
+
+/**
+ * @brief Checks the class map, the edges and the encodings of the states
+ *
+ * @param thiz
+ * @return 0 if they are sound, -1 otherwise
+ *****************************************************************************/
+static int arena_check_states (const ACT_ARENA_t *thiz)
+{
+    const struct act_state *state;
+    const struct act_bitmap *bm;
+    const struct act_state_info *info;
+    size_t i, j, rank;
+
+    if (thiz->classes_count == 0 || 
+            thiz->classes_count > ARENA_ALPHABET_SIZE ||
+            (thiz->void_class >= thiz->classes_count &&
+             thiz->void_class != ARENA_ALPHABET_SIZE))
+        return -1;
+
+    for (i = 0; i < ARENA_ALPHABET_SIZE; i++)
+        if (thiz->classes[i] >= thiz->classes_count)
+            return -1;
+
+    for (i = 0; i < thiz->edges_count; i++)
+        if (thiz->targets[i] >= thiz->states_count)
+            return -1;
+
+    for (i = 0; i < thiz->dense_count; i++)
+        if (thiz->dense[i] >= thiz->states_count && 
+                thiz->dense[i] != ARENA_NONE)
+            return -1;
+
+    for (i = 0; i < thiz->chain_base; i++)
+    {
+        state = &thiz->states[i];
+        info = &thiz->infos[i];
+
+        if ((uint64_t) state->edges + state->edges_count > thiz->edges_count ||
+                (uint64_t) info->matched + info->matched_size > 
+                    thiz->matched_count ||
+                (info->to_be_replaced != ARENA_NONE && 
+                    info->to_be_replaced >= thiz->matched_count) ||
+                (info->output != ARENA_NONE && 
+                    info->output >= thiz->chain_base))
+            return -1;
+
+        switch (state->encoding)
+        {
+        case ARENA_ENC_INLINE:
+            if (state->edges_count > ARENA_INLINE_MAX)
+                return -1;
+            break;
+
+        case ARENA_ENC_SORTED:
+            break;
+
+        case ARENA_ENC_BITMAP:
+            if (state->aux >= thiz->bitmaps_count)
+                return -1;
+            bm = &thiz->bitmaps[state->aux];
+            for (j = 0, rank = 0; j < 4; j++)
+            {
+                if (bm->ranks[j] != rank)
+                    return -1;
+                rank += ARENA_POPCOUNT(bm->bits[j]);
+            }
+            if (rank != state->edges_count)
+                return -1;
+            break;
+
+        case ARENA_ENC_DENSE:
+            if ((uint64_t) state->aux + thiz->classes_count > 
+                    thiz->dense_count)
+                return -1;
+            break;
+
+        default:
+            return -1;
+        }
+    }
+
+    for (i = 0; i < thiz->states_count - thiz->chain_base; i++)
+        if (thiz->chains[i].next >= thiz->states_count ||
+                thiz->chains[i].failure >= thiz->states_count)
+            return -1;
+
+    return 0;
+}
+
+/**
+ * @brief Finds the depth of every state, and checks that the failure state
+ * of every state but the root is shallower
+ *
+ * The depths of the chain states are found from the ends of their chains, 
+ * as by arena_depth(); a chain that does not end within the longest 
+ * pattern fails.
+ *
+ * @param thiz
+ * @param depths receives the depths of the states
+ * @param path room for the longest chain
+ * @return 0 if the states are sound, -1 otherwise
+ *****************************************************************************/
+static int arena_check_depths (const ACT_ARENA_t *thiz, uint32_t *depths,
+        uint32_t *path)
+{
+    uint32_t i, state, steps;
+
+    for (i = 0; i < thiz->chain_base; i++)
+        if ((depths[i] = thiz->infos[i].depth) > AC_PATTRN_MAX_LENGTH ||
+                (i == ARENA_ROOT) != (depths[i] == 0))
+            return -1;
+
+    for (i = thiz->chain_base; i < thiz->states_count; i++)
+        depths[i] = 0;
+
+    for (i = thiz->chain_base; i < thiz->states_count; i++)
+    {
+        for (state = i, steps = 0; ARENA_IS_CHAIN(thiz, state) && 
+                depths[state] == 0; steps++)
+        {
+            if (steps > AC_PATTRN_MAX_LENGTH)
+                return -1;
+            path[steps] = state;
+            state = thiz->chains[state - thiz->chain_base].next;
+        }
+
+        if (depths[state] <= steps)
+            return -1;
+
+        while (steps--)
+        {
+            depths[path[steps]] = depths[state] - 1;
+            state = path[steps];
+        }
+    }
+
+    for (i = 0; i < thiz->states_count; i++)
+    {
+        if (i == ARENA_ROOT)
+            continue;
+        state = ARENA_FAILURE(thiz, i);
+        if (state >= thiz->states_count || depths[state] >= depths[i])
+            return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Checks that the output chains lead to shallower states and do not
+ * collect more than matches_max patterns
+ *
+ * @param thiz
+ * @param depths the depths of the states
+ * @param path room for the longest output chain
+ * @return 0 if the outputs are sound, -1 otherwise
+ *****************************************************************************/
+static int arena_check_outputs (const ACT_ARENA_t *thiz, 
+        const uint32_t *depths, uint32_t *path)
+{
+    uint32_t *totals;
+    uint32_t i, state, steps, output;
+    uint64_t total;
+    int result = 0;
+
+    totals = (uint32_t *) malloc (thiz->chain_base * sizeof(uint32_t));
+    for (i = 0; i < thiz->chain_base; i++)
+        totals[i] = ARENA_NONE;
+
+    for (i = 0; i < thiz->chain_base && !result; i++)
+    {
+        /* Walk down to a state whose total is known, then add up */
+        for (state = i, steps = 0; state != ARENA_NONE && 
+                totals[state] == ARENA_NONE; steps++)
+        {
+            output = thiz->infos[state].output;
+            if (output != ARENA_NONE && depths[output] >= depths[state])
+            {
+                result = -1;
+                break;
+            }
+            path[steps] = state;
+            state = output;
+        }
+
+        total = (state == ARENA_NONE || result) ? 0 : totals[state];
+
+        while (steps-- && !result)
+        {
+            total += thiz->infos[path[steps]].matched_size;
+            if (total > thiz->matches_max)
+                result = -1;
+            totals[path[steps]] = (uint32_t) total;
+        }
+    }
+
+    free (totals);
+
+    return result;
+}
+
+/**
+ * @brief Checks that the tails are sorted, belong to the states that are 
+ * flagged for them, and have patterns that are longer than their states
+ *
+ * @param thiz
+ * @param depths the depths of the states
+ * @return 0 if the tails are sound, -1 otherwise
+ *****************************************************************************/
+static int arena_check_tails (const ACT_ARENA_t *thiz, 
+        const uint32_t *depths)
+{
+    const struct act_tail *tail;
+    size_t i, j, flagged = 0;
+
+    for (i = 0; i < thiz->chain_base; i++)
+        if (thiz->states[i].flags & ARENA_STATE_TAIL)
+            flagged++;
+
+    if (flagged != thiz->tails_count)
+        return -1;
+
+    for (i = 0; i < thiz->tails_count; i++)
+    {
+        tail = &thiz->tails[i];
+
+        if (tail->state >= thiz->chain_base ||
+                !(thiz->states[tail->state].flags & ARENA_STATE_TAIL) ||
+                (i > 0 && tail->state <= thiz->tails[i - 1].state) ||
+                (uint64_t) tail->patterns + tail->patterns_size > 
+                    thiz->matched_count)
+            return -1;
+
+        for (j = 0; j < tail->patterns_size; j++)
+            if (thiz->matched[tail->patterns + j].ptext.length < 
+                    depths[tail->state])
+                return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Allocates the single memory block of the arena and lays out the
+ * arrays in it. The counters of the arena must be set before.
+ *
+ * @param thiz
+ * @param huge
+ *****************************************************************************/
+static void arena_alloc_block (ACT_ARENA_t *thiz, int huge)
+{
+    thiz->block_size = arena_block_size (thiz) + 
+            thiz->matched_count * sizeof(AC_PATTERN_t);
+    arena_attach (thiz, pages_alloc 
+            (thiz->block_size, huge, &thiz->block_mapped));
+
+    /* Clear the padding that the SIMD lookup reads */
+    memset (&thiz->labels[thiz->edges_count], 0, (unsigned char *) 
+            thiz->targets - &thiz->labels[thiz->edges_count]);
+}
+
+/**
+ * @brief Tells the size of the arrays of the arena, without the matched 
+ * patterns which come after them. The counters of the arena must be set.
+ *
+ * @param thiz
+ * @return
+ *****************************************************************************/
+size_t arena_block_size (const ACT_ARENA_t *thiz)
+{
+    size_t chains_count = thiz->states_count - thiz->chain_base;
+
+    return arena_align (thiz->chain_base * sizeof(struct act_state)) +
+            arena_align (thiz->chain_base * sizeof(struct act_state_info)) +
+            arena_align (thiz->edges_count * sizeof(ACT_CLASS_t) + 
+                    ARENA_LABELS_PADDING) +
+            arena_align (thiz->edges_count * sizeof(uint32_t)) +
+            arena_align (thiz->bitmaps_count * sizeof(struct act_bitmap)) +
+            arena_align (thiz->dense_count * sizeof(uint32_t)) +
+            arena_align (chains_count * sizeof(struct act_chain)) +
+            arena_align (chains_count * sizeof(ACT_CLASS_t)) +
+            arena_align (thiz->tails_count * sizeof(struct act_tail));
+}
+
+/**
+ * @brief Lays out the arrays of the arena in the given block
+ *
+ * The block is not touched, so it can be a read-only image of an arena; 
+ * see image_load(). The matched patterns are placed at arena_block_size().
+ *
+ * @param thiz
+ * @param block
+ *****************************************************************************/
+void arena_attach (ACT_ARENA_t *thiz, void *block)
+{
+    size_t chains_count = thiz->states_count - thiz->chain_base;
+    unsigned char *bp = (unsigned char *) block;
+
+    thiz->block = block;
+
+    /* The hot arrays go first */
+    thiz->states = (struct act_state *) bp;
+    bp += arena_align (thiz->chain_base * sizeof(struct act_state));
+    thiz->dense = (uint32_t *) bp;
+    bp += arena_align (thiz->dense_count * sizeof(uint32_t));
+    thiz->bitmaps = (struct act_bitmap *) bp;
+    bp += arena_align (thiz->bitmaps_count * sizeof(struct act_bitmap));
+    thiz->labels = (ACT_CLASS_t *) bp;
+    bp += arena_align (thiz->edges_count * sizeof(ACT_CLASS_t) + 
+            ARENA_LABELS_PADDING);
+    thiz->targets = (uint32_t *) bp;
+    bp += arena_align (thiz->edges_count * sizeof(uint32_t));
+    thiz->chains = (struct act_chain *) bp;
+    bp += arena_align (chains_count * sizeof(struct act_chain));
+    thiz->chain_labels = (ACT_CLASS_t *) bp;
+    bp += arena_align (chains_count * sizeof(ACT_CLASS_t));
+    thiz->infos = (struct act_state_info *) bp;
+    bp += arena_align (thiz->chain_base * sizeof(struct act_state_info));
+    thiz->tails = (struct act_tail *) bp;
+    bp += arena_align (thiz->tails_count * sizeof(struct act_tail));
+    thiz->matched = (AC_PATTERN_t *) bp;
+}
+
+/**
+ * @brief Prints the arena in human readable form
+ *
+ * @param thiz
+ *****************************************************************************/
+void arena_display (ACT_ARENA_t *thiz)
+{
+    uint32_t i, j;
+    struct act_state *s;
+    struct act_state_info *info;
+    const struct act_tail *tail;
+    AC_PATTERN_t *patt;
+
+    for (i = 0; i < thiz->chain_base; i++)
+    {
+        s = &thiz->states[i];
+        info = &thiz->infos[i];
+
+        printf("STATE(%3u)/....fail....> ", i);
+        if (s->failure != ARENA_NONE)
+            printf("STATE(%3u)\n", s->failure);
+        else
+            printf ("N.A.\n");
+
+        for (j = 0; j < s->edges_count; j++)
+            arena_display_edge (thiz, thiz->labels[s->edges + j], 
+                    thiz->targets[s->edges + j]);
+
+        if (info->matched_size)
+        {
+            printf("Accepts: {");
+            for (j = 0; j < info->matched_size; j++)
+            {
+                patt = &thiz->matched[info->matched + j];
+                if(j)
+                    printf(", ");
+                switch (patt->id.type)
+                {
+                case AC_PATTID_TYPE_DEFAULT:
+                case AC_PATTID_TYPE_NUMBER:
+                    printf("%ld", patt->id.u.number);
+                    break;
+                case AC_PATTID_TYPE_STRING:
+                    printf("%s", patt->id.u.stringy);
+                    break;
+                }
+                printf(": %.*s", (int)patt->ptext.length, patt->ptext.astring);
+            }
+            printf("}\n");
+        }
+        if (info->output != ARENA_NONE)
+            printf("Output: STATE(%3u)\n", info->output);
+        if ((tail = arena_find_tail (thiz, i)))
+        {
+            printf("Tails: {");
+            for (j = 0; j < tail->patterns_size; j++)
+            {
+                patt = &thiz->matched[tail->patterns + j];
+                printf("%s%.*s", j ? ", " : "", (int)patt->ptext.length, 
+                        patt->ptext.astring);
+            }
+            printf("}\n");
+        }
+        printf("\n");
+    }
+
+    for (i = thiz->chain_base; i < thiz->states_count; i++)
+    {
+        printf("STATE(%3u)/....fail....> STATE(%3u)\n", i, 
+                thiz->chains[i - thiz->chain_base].failure);
+        arena_display_edge (thiz, thiz->chain_labels[i - thiz->chain_base],
+                thiz->chains[i - thiz->chain_base].next);
+        printf("\n");
+    }
+}
+
+/**
+ * @brief Prints an edge of a state
+ *
+ * @param thiz
+ * @param label
+ * @param target
+ *****************************************************************************/
+static void arena_display_edge 
+    (ACT_ARENA_t *thiz, ACT_CLASS_t label, uint32_t target)
+{
+    unsigned int alpha;
+
+    /* Find the byte of the class */
+    for (alpha = 0; alpha < ARENA_ALPHABET_SIZE; alpha++)
+        if (thiz->classes[alpha] == label)
+            break;
+
+    printf("          |----(");
+    if(isgraph(alpha))
+        printf("%c)---", alpha);
+    else
+        printf("0x%x)", alpha);
+    printf("--> STATE(%3u)\n", target);
+}
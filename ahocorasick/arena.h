@@ -0,0 +1,418 @@
+/*
+ * arena.h: Defines the flat search structure of a finalized trie
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stdint.h>
+#include "actypes.h"
+
+#if defined(__GNUC__) && defined(__AVX2__)
+#include <immintrin.h>
+#define ARENA_SIMD_WIDTH 32
+#elif defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define ARENA_SIMD_WIDTH 16
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Forward Declaration */
+struct ac_trie;
+
+/**
+ * The root state is always the first state of the arena
+ */
+#define ARENA_ROOT 0
+
+/**
+ * Shows an undefined state or index
+ */
+#define ARENA_NONE 0xFFFFFFFFU
+
+/**
+ * Number of entries in the class map; one for every byte value
+ */
+#define ARENA_ALPHABET_SIZE 256
+
+/**
+ * Type of the byte equivalence class ids
+ */
+typedef uint8_t ACT_CLASS_t;
+
+/**
+ * Number of bytes after the last label that can be read by the SIMD lookup
+ */
+#define ARENA_LABELS_PADDING 32
+
+/**
+ * State flags
+ */
+#define ARENA_STATE_FINAL 0x01  /**< The state accepts at least one pattern */
+#define ARENA_STATE_TAIL  0x02  /**< The state has tail patterns */
+
+/**
+ * State encodings: how the outgoing edges of a state are looked up. The 
+ * edges of every state are kept in the labels/targets arrays anyway; the
+ * encodings other than sorted add a faster way to find them.
+ */
+#define ARENA_ENC_INLINE    0   /**< Up to two edges; labels in the state */
+#define ARENA_ENC_SORTED    1   /**< Sorted labels; searched by SIMD compare
+                                 * or linearly */
+#define ARENA_ENC_BITMAP    2   /**< Class presence bitmap and popcount rank */
+#define ARENA_ENC_DENSE     3   /**< Direct table indexed by class */
+
+/**
+ * Encoding thresholds
+ */
+#define ARENA_INLINE_MAX    2   /**< Max edges of an inline state */
+#define ARENA_SORTED_MAX    32  /**< Max edges of a sorted state */
+#define ARENA_DENSE_RATIO   4   /**< A state that has edges for at least 
+                                 * 1/ARENA_DENSE_RATIO of the classes gets 
+                                 * a dense table */
+
+/**
+ * The hot part of a state: everything the search loop touches per alphabet
+ */
+struct act_state
+{
+    uint32_t failure;       /**< The failure state */
+    uint32_t edges;         /**< Index of the first edge in labels/targets */
+    uint32_t aux;           /**< Encoding specific data: the two labels of 
+                             * an inline state, the bitmap index of a bitmap
+                             * state, or the table offset of a dense state */
+    uint16_t edges_count;   /**< Number of outgoing edges */
+    uint8_t encoding;       /**< State encoding */
+    uint8_t flags;          /**< State flags */
+};
+
+/**
+ * The class presence bitmap of a bitmap state. The rank of a class is the
+ * number of the set bits before it, which is the index of its edge.
+ */
+struct act_bitmap
+{
+    uint64_t bits[4];       /**< One bit per class */
+    uint16_t ranks[4];      /**< Number of set bits in the previous words */
+};
+
+/**
+ * The cold part of a state: it is only touched on matches or by replace
+ */
+struct act_state_info
+{
+    uint32_t depth;         /**< Distance between this state and the root */
+    uint32_t matched;       /**< Index of the first own matched pattern */
+    uint32_t matched_size;  /**< Number of own matched patterns */
+    uint32_t output;        /**< The nearest final state on the failure chain
+                             * that has own patterns, or ARENA_NONE */
+    uint32_t to_be_replaced;    /**< Index of the pattern that must be
+                                 * replaced, or ARENA_NONE */
+};
+
+/**
+ * A chain state: a state that is not final and has a single outgoing edge.
+ * Its label is kept in the chain labels array. 
+ */
+struct act_chain
+{
+    uint32_t next;          /**< Target of the single edge */
+    uint32_t failure;       /**< The failure state */
+};
+
+/**
+ * The tail patterns of a state of a truncated trie. They are the patterns 
+ * that start with the string of the state, and are kept in the matched 
+ * array in the pre-order of the cut trie.
+ */
+struct act_tail
+{
+    uint32_t state;         /**< The state */
+    uint32_t patterns;      /**< Index of the first tail pattern */
+    uint32_t patterns_size; /**< Number of the tail patterns */
+    uint32_t root;          /**< The state of the tails in the minimized 
+                             * graph, if there is one */
+};
+
+/**
+ * The flat search structure of a finalized trie
+ *
+ * All the states are kept in a single contiguous block of memory and refer
+ * to each other by 32-bit indices. The hot and cold parts of the states are
+ * kept in separate arrays, and the edges of every state are kept sorted in
+ * two parallel arrays of labels and targets.
+ *
+ * The edges are not labeled by the input bytes but by their equivalence
+ * classes. Every byte that appears in the patterns has a class of its own,
+ * and all the other bytes share the void class, which has no edge in any
+ * state. The input must be mapped through the class map before walking.
+ *
+ * Every state keeps only its own patterns. The patterns of its suffixes are
+ * found by following the output links, so a match may need to be assembled
+ * from several states; see arena_collect_matches().
+ *
+ * The long patterns make long unary chains of states below the branching 
+ * top of the trie. These chain states are compressed: they are numbered 
+ * in BFS order after all the other states, from chain_base on, and keep 
+ * only their single edge and their failure state. A chain state costs 9 
+ * bytes instead of a state and an info. Since every chain state keeps its
+ * own failure state, a mismatch in the middle of a chain fails as it would
+ * without compression.
+ *
+ * The chains are not the string edges of a compressed trie: a chain still 
+ * takes one state per byte, and arena_find_next() checks for a chain state 
+ * before the others. String edges, compared by memcmp(), would take one 
+ * step per edge; but a mismatch in the middle of an edge must fail to the 
+ * failure state of that very position, so the edge would keep a failure 
+ * state per byte anyway, and the search would have to go back into it byte
+ * by byte. The chains keep that per byte failure and only drop the rest of
+ * the state. On the patterns of tstHugeData (100000 patterns of 30 to 80 
+ * random letters: 5.2 million states, 5.1 million of them in chains), 
+ * searching 64 MB of text with the default options:
+ *
+ *                      arena     random text   prefixes of    whole
+ *                                              the patterns   patterns
+ *      without chains  219 MB    31 MB/s       4 MB/s         4 MB/s
+ *      with chains      56 MB    33 MB/s       10 MB/s        7 MB/s
+ *
+ * The extra branch does not show on the random text, which hardly leaves
+ * the branching top of the trie; the text that walks deep into the chains 
+ * gains from the smaller states.
+ *
+ * A truncated trie has no state deeper than AC_TRUNCATE_DEPTH. The longer
+ * patterns are kept as the tail patterns of the state that spells their 
+ * beginning; the search compares the rest of them on the text, or walks
+ * them on the minimized graph of the tails; see ACT_DAWG_t.
+ */
+typedef struct act_arena
+{
+    ACT_CLASS_t classes[ARENA_ALPHABET_SIZE];   /**< The class map */
+    uint16_t classes_count; /**< Number of classes */
+    uint16_t void_class;    /**< The class of bytes that are not used in any
+                             * pattern, or ARENA_ALPHABET_SIZE if all the
+                             * bytes are used */
+
+    struct act_state *states;       /**< Hot part of the states */
+    struct act_state_info *infos;   /**< Cold part of the states */
+
+    ACT_CLASS_t *labels;    /**< Edge labels (class ids) */
+    uint32_t *targets;      /**< Edge targets */
+
+    struct act_bitmap *bitmaps; /**< Bitmaps of the bitmap states */
+    uint32_t *dense;        /**< Tables of the dense states */
+
+    AC_PATTERN_t *matched;  /**< Matched patterns of all states */
+    const uint8_t *removed; /**< Flags of the matched patterns that are 
+                             * removed since the arena is built, or NULL; 
+                             * they are not reported. See ACT_DELTA_t */
+
+    struct act_chain *chains;   /**< The chain states */
+    ACT_CLASS_t *chain_labels;  /**< Labels of the chain states */
+
+    struct act_tail *tails;     /**< The states that have tail patterns, 
+                                 * sorted by state */
+
+    uint32_t states_count;  /**< Number of states, including chain states */
+    uint32_t chain_base;    /**< Number of the first chain state, which is
+                             * the number of the other states */
+    uint32_t edges_count;   /**< Number of edges */
+    uint32_t matched_count; /**< Number of items in the matched array */
+    uint32_t matches_max;   /**< Max number of patterns in a single match */
+    uint32_t bitmaps_count; /**< Number of bitmaps */
+    uint32_t dense_count;   /**< Number of entries in the dense array */
+    uint32_t tails_count;   /**< Number of the states that have tails */
+
+    void *block;        /**< The memory block that holds all the arrays */
+    size_t block_size;  /**< Size of the memory block */
+    int block_mapped;   /**< How the block is allocated; see pages_alloc() 
+                         * and PAGES_IMAGE */
+
+} ACT_ARENA_t;
+
+/*
+ * Arena interface functions
+ */
+
+ACT_ARENA_t *arena_create (struct ac_trie *trie, int options);
+void arena_release (ACT_ARENA_t *thiz);
+void arena_display (ACT_ARENA_t *thiz);
+void arena_statistics (const ACT_ARENA_t *thiz, AC_STATISTICS_t *stats);
+void arena_reorder (ACT_ARENA_t *thiz, const uint32_t *order);
+size_t arena_block_size (const ACT_ARENA_t *thiz);
+void arena_attach (ACT_ARENA_t *thiz, void *block);
+uint32_t arena_depth (const ACT_ARENA_t *thiz, uint32_t state);
+int arena_check (const ACT_ARENA_t *thiz);
+const struct act_tail *arena_find_tail 
+    (const ACT_ARENA_t *thiz, uint32_t state);
+size_t arena_collect_matches 
+    (const ACT_ARENA_t *thiz, uint32_t state, AC_PATTERN_t *buffer);
+
+/**
+ * Maps an input alphabet to its class
+ */
+#define ARENA_CLASS(arena, alpha) ((arena)->classes[(unsigned char)(alpha)])
+
+/**
+ * Tells if the state is a compressed chain state
+ */
+#define ARENA_IS_CHAIN(arena, s) ((s) >= (arena)->chain_base)
+
+/**
+ * Tells if the state accepts any pattern; chain states never do
+ */
+#define ARENA_IS_FINAL(arena, s) (!ARENA_IS_CHAIN(arena, s) && \
+        ((arena)->states[s].flags & ARENA_STATE_FINAL))
+
+/**
+ * Tells if the state accepts any pattern or has tail patterns
+ */
+#define ARENA_IS_MARKED(arena, s) (!ARENA_IS_CHAIN(arena, s) && \
+        (arena)->states[s].flags)
+
+/**
+ * Returns the failure state of the given state
+ */
+#define ARENA_FAILURE(arena, s) (ARENA_IS_CHAIN(arena, s) ? \
+        (arena)->chains[(s) - (arena)->chain_base].failure : \
+        (arena)->states[s].failure)
+
+#if defined(__GNUC__)
+#define ARENA_POPCOUNT(x) __builtin_popcountll(x)
+#define ARENA_CTZ(x) __builtin_ctz(x)
+#define ARENA_PREFETCH(p) __builtin_prefetch(p)
+#else
+static inline unsigned int arena_popcount (uint64_t x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (unsigned int)((x * 0x0101010101010101ULL) >> 56);
+}
+#define ARENA_POPCOUNT(x) arena_popcount(x)
+#define ARENA_PREFETCH(p) ((void)(p))
+#endif
+
+/**
+ * @brief Finds the index of a label in the sorted labels of a state
+ *
+ * With SSE2 or AVX2 (selected at build time) the class is compared against
+ * 16 or 32 labels by a single instruction; the labels array is padded, so 
+ * reading past the last label is safe.
+ *
+ * @param labels
+ * @param count number of the labels
+ * @param cls
+ * @return The index of the label, or -1 if it is not found
+ *****************************************************************************/
+static inline int arena_find_label 
+    (const ACT_CLASS_t *labels, unsigned int count, ACT_CLASS_t cls)
+{
+    unsigned int i;
+#if defined(ARENA_SIMD_WIDTH)
+    uint32_t mask;
+#if ARENA_SIMD_WIDTH == 32
+    const __m256i key = _mm256_set1_epi8 ((char)cls);
+#else
+    const __m128i key = _mm_set1_epi8 ((char)cls);
+#endif
+
+    for (i = 0; i < count; i += ARENA_SIMD_WIDTH)
+    {
+#if ARENA_SIMD_WIDTH == 32
+        mask = (uint32_t) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (key, 
+                _mm256_loadu_si256 ((const __m256i *)&labels[i])));
+#else
+        mask = (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (key, 
+                _mm_loadu_si128 ((const __m128i *)&labels[i])));
+#endif
+        if (count - i < ARENA_SIMD_WIDTH)
+            mask &= (1U << (count - i)) - 1;
+        if (mask)
+            return i + ARENA_CTZ(mask);
+    }
+#else
+    for (i = 0; i < count && labels[i] <= cls; i++)
+        if (labels[i] == cls)
+            return i;
+#endif
+    return -1;
+}
+
+/**
+ * @brief Finds out the next state for a given class
+ *
+ * The encodings are checked in the order of their frequency: the deep
+ * states of a trie are mostly inline.
+ *
+ * @param thiz
+ * @param state
+ * @param cls
+ * @return The next state, or ARENA_NONE if there is no such edge
+ *****************************************************************************/
+static inline uint32_t arena_find_next
+    (const ACT_ARENA_t *thiz, uint32_t state, ACT_CLASS_t cls)
+{
+    const struct act_state *s;
+    const struct act_bitmap *bm;
+    uint64_t word, bit;
+    int i;
+
+    if (ARENA_IS_CHAIN(thiz, state))
+        return (cls == thiz->chain_labels[state - thiz->chain_base]) ? 
+                thiz->chains[state - thiz->chain_base].next : ARENA_NONE;
+
+    s = &thiz->states[state];
+
+    if (s->encoding == ARENA_ENC_INLINE)
+    {
+        if (s->edges_count > 0 && cls == (s->aux & 0xFFFF))
+            return thiz->targets[s->edges];
+        if (s->edges_count > 1 && cls == (s->aux >> 16))
+            return thiz->targets[s->edges + 1];
+        return ARENA_NONE;
+    }
+
+    switch (s->encoding)
+    {
+    case ARENA_ENC_DENSE:
+        return thiz->dense[s->aux + cls];
+
+    case ARENA_ENC_BITMAP:
+        bm = &thiz->bitmaps[s->aux];
+        word = bm->bits[cls >> 6];
+        bit = (uint64_t)1 << (cls & 63);
+        if (!(word & bit))
+            return ARENA_NONE;
+        return thiz->targets[s->edges + bm->ranks[cls >> 6] + 
+                ARENA_POPCOUNT(word & (bit - 1))];
+
+    default: /* ARENA_ENC_SORTED */
+        i = arena_find_label (&thiz->labels[s->edges], s->edges_count, cls);
+        return (i < 0) ? ARENA_NONE : thiz->targets[s->edges + i];
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,458 @@
+/*
+ * dawg.c: Implements the minimized graph of the tail patterns of a
+ * truncated trie
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "node.h"
+#include "dawg.h"
+#include "pages.h"
+
+/* Privates */
+static void dawg_push_pending (ACT_DAWG_t *thiz, AC_ALPHABET_t alpha, 
+        uint32_t target);
+static uint32_t dawg_register (ACT_DAWG_t *thiz, int final, size_t start);
+static int dawg_equals (const ACT_DAWG_t *thiz, uint32_t state, int final,
+        const struct act_dawg_pending *pending, size_t count);
+static size_t dawg_hash_pending (int final,
+        const struct act_dawg_pending *pending, size_t count);
+static size_t dawg_hash_state (const ACT_DAWG_t *thiz, uint32_t state);
+static void dawg_grow_table (ACT_DAWG_t *thiz);
+static size_t dawg_align (size_t size);
+
+/**
+ * Mixes a value into an FNV-1a hash
+ */
+#define DAWG_MIX(hash, value) (((hash) ^ (value)) * 1099511628211ULL)
+
+
+/**
+ * @brief Creates an empty graph to add the tails to
+ *
+ * @return
+ *****************************************************************************/
+ACT_DAWG_t *dawg_create (void)
+{
+    ACT_DAWG_t *thiz = (ACT_DAWG_t *) malloc (sizeof(ACT_DAWG_t));
+
+    thiz->states_count = 0;
+    thiz->edges_count = 0;
+    thiz->block = NULL;
+    thiz->block_size = 0;
+    thiz->block_mapped = 0;
+
+    thiz->states_capacity = 64;
+    thiz->edges_capacity = 64;
+    thiz->states = (struct act_dawg_state *) malloc
+            (thiz->states_capacity * sizeof(struct act_dawg_state));
+    thiz->counts = (uint32_t *) malloc
+            (thiz->states_capacity * sizeof(uint32_t));
+    thiz->edges = (struct act_dawg_edge *) malloc
+            (thiz->edges_capacity * sizeof(struct act_dawg_edge));
+    thiz->labels = (AC_ALPHABET_t *) malloc
+            (thiz->edges_capacity * sizeof(AC_ALPHABET_t));
+
+    thiz->table_size = 128;
+    thiz->table = (uint32_t *) malloc (thiz->table_size * sizeof(uint32_t));
+    memset (thiz->table, 0xFF, thiz->table_size * sizeof(uint32_t));
+
+    thiz->pending_capacity = 64;
+    thiz->pending_size = 0;
+    thiz->pending = (struct act_dawg_pending *) malloc
+            (thiz->pending_capacity * sizeof(struct act_dawg_pending));
+
+    return thiz;
+}
+
+/**
+ * @brief Adds the nodes below the given node to the graph
+ *
+ * The subtree is merged into the states that are already in the graph. The
+ * edges of the nodes are sorted, so the tails can be collected in the order
+ * of the graph afterwards; see node_cut_tails(). The given node itself is
+ * not final in the graph, as its own patterns are not tails.
+ *
+ * @param thiz
+ * @param node
+ * @return the state that spells the tails of the node
+ *****************************************************************************/
+uint32_t dawg_add (ACT_DAWG_t *thiz, ACT_NODE_t *node)
+{
+    ACT_NODE_WALK_t walk;
+    struct act_node_step *parent;
+    ACT_NODE_t *nod;
+    uint32_t target = 0;
+    int leaving;
+    
+    /* The children are added first: a node is registered on leaving it, 
+     * with the pending edges that its children have left from its mark on */
+    
+    node_walk_init (&walk, node);
+    
+    while ((nod = node_walk_next (&walk, &leaving)))
+    {
+        if (!leaving)
+        {
+            node_sort_edges (nod);
+            walk.stack[walk.size - 1].mark = thiz->pending_size;
+            continue;
+        }
+        
+        if (!walk.size)
+        {
+            target = dawg_register (thiz, 0, walk.stack[0].mark);
+            break;
+        }
+        
+        target = dawg_register (thiz, nod->final, walk.stack[walk.size].mark);
+        
+        parent = &walk.stack[walk.size - 1];
+        dawg_push_pending (thiz, 
+                parent->node->outgoing[parent->edge - 1].alpha, target);
+    }
+    
+    node_walk_release (&walk);
+    
+    return target;
+}
+
+/**
+ * @brief Moves the graph into a single memory block and releases what was
+ * used for building it. No tail can be added afterwards.
+ *
+ * @param thiz
+ * @param huge map the block on huge pages
+ *****************************************************************************/
+void dawg_close (ACT_DAWG_t *thiz, int huge)
+{
+    struct act_dawg_state *states = thiz->states;
+    struct act_dawg_edge *edges = thiz->edges;
+    AC_ALPHABET_t *labels = thiz->labels;
+
+    thiz->block_size = 
+            dawg_align (thiz->states_count * sizeof(struct act_dawg_state)) +
+            dawg_align (thiz->edges_count * sizeof(struct act_dawg_edge)) +
+            dawg_align (thiz->edges_count * sizeof(AC_ALPHABET_t));
+    dawg_attach (thiz, pages_alloc 
+            (thiz->block_size, huge, &thiz->block_mapped));
+
+    memcpy (thiz->states, states, 
+            thiz->states_count * sizeof(struct act_dawg_state));
+    memcpy (thiz->edges, edges, 
+            thiz->edges_count * sizeof(struct act_dawg_edge));
+    memcpy (thiz->labels, labels, thiz->edges_count * sizeof(AC_ALPHABET_t));
+    free (states);
+    free (edges);
+    free (labels);
+
+    free (thiz->counts);
+    free (thiz->table);
+    free (thiz->pending);
+    thiz->counts = NULL;
+    thiz->table = NULL;
+    thiz->pending = NULL;
+}
+
+/**
+ * @brief Lays out the arrays of the graph in the given block
+ *
+ * The block is not touched, so it can be a read-only image of a graph; see
+ * image_load(). The counters of the graph must be set before.
+ *
+ * @param thiz
+ * @param block
+ *****************************************************************************/
+void dawg_attach (ACT_DAWG_t *thiz, void *block)
+{
+    unsigned char *bp = (unsigned char *) block;
+
+    thiz->block = block;
+    thiz->states = (struct act_dawg_state *) bp;
+    bp += dawg_align (thiz->states_count * sizeof(struct act_dawg_state));
+    thiz->edges = (struct act_dawg_edge *) bp;
+    bp += dawg_align (thiz->edges_count * sizeof(struct act_dawg_edge));
+    thiz->labels = (AC_ALPHABET_t *) bp;
+}
+
+/**
+ * @brief Checks that a graph which is loaded from an image can be walked
+ *
+ * Every edge must lead to a state that is registered before its source, 
+ * as dawg_add() registers them, and its rank must be the number of the 
+ * tails before it. Then a walk ends, and the sum of the ranks along it is 
+ * less than the number of the tails below its start.
+ *
+ * @param thiz
+ * @param counts receives the number of the tails below every state
+ * @return 0 if the graph is sound, -1 otherwise
+ *****************************************************************************/
+int dawg_check (const ACT_DAWG_t *thiz, uint32_t *counts)
+{
+    const struct act_dawg_state *state;
+    const struct act_dawg_edge *edge;
+    uint32_t i, j;
+    uint64_t total;
+
+    for (i = 0; i < thiz->states_count; i++)
+    {
+        state = &thiz->states[i];
+
+        if ((uint64_t) state->edges + state->edges_count > thiz->edges_count)
+            return -1;
+
+        total = state->final ? 1 : 0;
+
+        for (j = 0; j < state->edges_count; j++)
+        {
+            edge = &thiz->edges[state->edges + j];
+            if (edge->target >= i || edge->rank != total)
+                return -1;
+            total += counts[edge->target];
+        }
+
+        if (total > DAWG_NONE)
+            return -1;
+        counts[i] = (uint32_t) total;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Releases the graph
+ *
+ * @param thiz
+ *****************************************************************************/
+void dawg_release (ACT_DAWG_t *thiz)
+{
+    if (!thiz)
+        return;
+
+    if (thiz->block)
+    {
+        pages_free (thiz->block, thiz->block_size, thiz->block_mapped);
+    }
+    else
+    {
+        free (thiz->states);
+        free (thiz->edges);
+        free (thiz->labels);
+    }
+
+    free (thiz->counts);
+    free (thiz->table);
+    free (thiz->pending);
+    free (thiz);
+}
+
+/**
+ * @brief Adds an edge to the pending edges of the node being added
+ *
+ * @param thiz
+ * @param alpha
+ * @param target
+ *****************************************************************************/
+static void dawg_push_pending (ACT_DAWG_t *thiz, AC_ALPHABET_t alpha, 
+        uint32_t target)
+{
+    if (thiz->pending_size == thiz->pending_capacity)
+    {
+        thiz->pending_capacity *= 2;
+        thiz->pending = (struct act_dawg_pending *) realloc
+                (thiz->pending, thiz->pending_capacity *
+                 sizeof(struct act_dawg_pending));
+    }
+    thiz->pending[thiz->pending_size].alpha = alpha;
+    thiz->pending[thiz->pending_size++].target = target;
+}
+
+/**
+ * @brief Finds or makes the state that has the pending edges from @p start
+ * on, and drops those edges
+ *
+ * @param thiz
+ * @param final
+ * @param start
+ * @return the state
+ *****************************************************************************/
+static uint32_t dawg_register (ACT_DAWG_t *thiz, int final, size_t start)
+{
+    const struct act_dawg_pending *pending = &thiz->pending[start];
+    size_t i, count = thiz->pending_size - start;
+    size_t mask = thiz->table_size - 1;
+    size_t slot = dawg_hash_pending (final, pending, count) & mask;
+    struct act_dawg_state *state;
+    uint32_t id, total = final;
+
+    thiz->pending_size = start;
+
+    for (; thiz->table[slot] != DAWG_NONE; slot = (slot + 1) & mask)
+        if (dawg_equals (thiz, thiz->table[slot], final, pending, count))
+            return thiz->table[slot];
+
+    /* A new state */
+    if (thiz->states_count == thiz->states_capacity)
+    {
+        thiz->states_capacity *= 2;
+        thiz->states = (struct act_dawg_state *) realloc (thiz->states,
+                thiz->states_capacity * sizeof(struct act_dawg_state));
+        thiz->counts = (uint32_t *) realloc (thiz->counts,
+                thiz->states_capacity * sizeof(uint32_t));
+    }
+    while (thiz->edges_count + count > thiz->edges_capacity)
+    {
+        thiz->edges_capacity *= 2;
+        thiz->edges = (struct act_dawg_edge *) realloc (thiz->edges,
+                thiz->edges_capacity * sizeof(struct act_dawg_edge));
+        thiz->labels = (AC_ALPHABET_t *) realloc (thiz->labels,
+                thiz->edges_capacity * sizeof(AC_ALPHABET_t));
+    }
+
+    id = thiz->states_count++;
+    state = &thiz->states[id];
+    state->edges = thiz->edges_count;
+    state->edges_count = count;
+    state->final = final;
+
+    for (i = 0; i < count; i++)
+    {
+        thiz->labels[state->edges + i] = pending[i].alpha;
+        thiz->edges[state->edges + i].target = pending[i].target;
+        thiz->edges[state->edges + i].rank = total;
+        total += thiz->counts[pending[i].target];
+    }
+    thiz->edges_count += count;
+    thiz->counts[id] = total;
+
+    thiz->table[slot] = id;
+    if (2 * thiz->states_count > thiz->table_size)
+        dawg_grow_table (thiz);
+
+    return id;
+}
+
+/**
+ * @brief Tells if the state has the given finality and edges
+ *
+ * @param thiz
+ * @param state
+ * @param final
+ * @param pending
+ * @param count
+ * @return
+ *****************************************************************************/
+static int dawg_equals (const ACT_DAWG_t *thiz, uint32_t state, int final,
+        const struct act_dawg_pending *pending, size_t count)
+{
+    const struct act_dawg_state *s = &thiz->states[state];
+    size_t i;
+
+    if (s->final != final || s->edges_count != count)
+        return 0;
+
+    for (i = 0; i < count; i++)
+        if (thiz->labels[s->edges + i] != pending[i].alpha ||
+                thiz->edges[s->edges + i].target != pending[i].target)
+            return 0;
+
+    return 1;
+}
+
+/**
+ * @brief Hashes a state that is not made yet
+ *
+ * @param final
+ * @param pending
+ * @param count
+ * @return
+ *****************************************************************************/
+static size_t dawg_hash_pending (int final,
+        const struct act_dawg_pending *pending, size_t count)
+{
+    uint64_t hash = DAWG_MIX(14695981039346656037ULL, (uint64_t)final);
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        hash = DAWG_MIX(hash, (unsigned char)pending[i].alpha);
+        hash = DAWG_MIX(hash, pending[i].target);
+    }
+
+    return (size_t)(hash ^ (hash >> 29));
+}
+
+/**
+ * @brief Hashes a state of the graph, the same way as dawg_hash_pending()
+ *
+ * @param thiz
+ * @param state
+ * @return
+ *****************************************************************************/
+static size_t dawg_hash_state (const ACT_DAWG_t *thiz, uint32_t state)
+{
+    const struct act_dawg_state *s = &thiz->states[state];
+    uint64_t hash = DAWG_MIX(14695981039346656037ULL, (uint64_t)s->final);
+    size_t i;
+
+    for (i = s->edges; i < s->edges + s->edges_count; i++)
+    {
+        hash = DAWG_MIX(hash, (unsigned char)thiz->labels[i]);
+        hash = DAWG_MIX(hash, thiz->edges[i].target);
+    }
+
+    return (size_t)(hash ^ (hash >> 29));
+}
+
+/**
+ * @brief Doubles the hash table and puts the states in it again
+ *
+ * @param thiz
+ *****************************************************************************/
+static void dawg_grow_table (ACT_DAWG_t *thiz)
+{
+    size_t mask, slot;
+    uint32_t i;
+
+    thiz->table_size *= 2;
+    mask = thiz->table_size - 1;
+    thiz->table = (uint32_t *) realloc (thiz->table,
+            thiz->table_size * sizeof(uint32_t));
+    memset (thiz->table, 0xFF, thiz->table_size * sizeof(uint32_t));
+
+    for (i = 0; i < thiz->states_count; i++)
+    {
+        slot = dawg_hash_state (thiz, i) & mask;
+        while (thiz->table[slot] != DAWG_NONE)
+            slot = (slot + 1) & mask;
+        thiz->table[slot] = i;
+    }
+}
+
+/**
+ * @brief Rounds up the size to a multiple of 16
+ *
+ * @param size
+ * @return
+ *****************************************************************************/
+static size_t dawg_align (size_t size)
+{
+    return (size + 15) & ~((size_t)0xF);
+}
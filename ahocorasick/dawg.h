@@ -0,0 +1,158 @@
+/*
+ * dawg.h: Defines the minimized graph of the tail patterns of a truncated
+ * trie
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _DAWG_H_
+#define _DAWG_H_
+
+#include <stdint.h>
+#include "actypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Forward Declaration */
+struct act_node;
+
+/**
+ * Marks a missing edge
+ */
+#define DAWG_NONE 0xFFFFFFFFu
+
+/**
+ * A state of the graph
+ */
+struct act_dawg_state
+{
+    uint32_t edges;         /**< Index of the first edge */
+    uint16_t edges_count;   /**< Number of the edges */
+    uint16_t final;         /**< A tail ends in this state */
+};
+
+/**
+ * An edge of the graph
+ */
+struct act_dawg_edge
+{
+    uint32_t target;    /**< The next state */
+    uint32_t rank;      /**< Number of the tails that come before the ones
+                         * that take this edge; see ACT_DAWG_t */
+};
+
+/**
+ * An edge of a state that is being built
+ */
+struct act_dawg_pending
+{
+    AC_ALPHABET_t alpha;    /**< The label */
+    uint32_t target;        /**< The next state */
+};
+
+/**
+ * The minimized graph of the tail patterns
+ *
+ * The tails of a truncated trie, i.e. the parts of the long patterns below
+ * the truncation depth, are merged into a directed acyclic word graph: the
+ * subtrees of the trie that spell the same set of tails are kept once, no
+ * matter which state they hang from. The dictionaries that share long
+ * suffixes, like domain names and file paths, shrink the most.
+ *
+ * A merged state does not know the pattern that led to it, so the edges
+ * carry ranks. The tails of a state are kept in the matched array sorted
+ * the way the graph is walked, the shorter prefix first, and the sum of the
+ * ranks along a walk is the index of the tail that ends in the reached
+ * state. The patterns are reported as they were added, with their own ids.
+ *
+ * The edges of every state are sorted by label. The graph is only walked
+ * forward from the root of the tails of a state, so it needs no failure
+ * links; the trie above the truncation depth keeps them.
+ */
+typedef struct act_dawg
+{
+    struct act_dawg_state *states;  /**< The states */
+    struct act_dawg_edge *edges;    /**< The edges */
+    AC_ALPHABET_t *labels;          /**< Labels of the edges */
+
+    uint32_t states_count;  /**< Number of the states */
+    uint32_t edges_count;   /**< Number of the edges */
+
+    void *block;        /**< The memory block that holds all the arrays */
+    size_t block_size;  /**< Size of the memory block */
+    int block_mapped;   /**< How the block is allocated; see pages_alloc()
+                         * and PAGES_IMAGE */
+
+    /* The rest is used only while building the graph */
+    uint32_t *counts;       /**< Number of the tails below every state */
+    uint32_t *table;        /**< Hash table of the states */
+    size_t table_size;      /**< Size of the hash table, a power of two */
+    size_t states_capacity; /**< Max capacity of the states */
+    size_t edges_capacity;  /**< Max capacity of the edges */
+    struct act_dawg_pending *pending;   /**< Edges of the states being
+                                         * built */
+    size_t pending_size;        /**< Number of the pending edges */
+    size_t pending_capacity;    /**< Max capacity of the pending edges */
+
+} ACT_DAWG_t;
+
+/*
+ * DAWG interface functions
+ */
+
+ACT_DAWG_t *dawg_create (void);
+uint32_t dawg_add (ACT_DAWG_t *thiz, struct act_node *node);
+void dawg_close (ACT_DAWG_t *thiz, int huge);
+void dawg_attach (ACT_DAWG_t *thiz, void *block);
+int dawg_check (const ACT_DAWG_t *thiz, uint32_t *counts);
+void dawg_release (ACT_DAWG_t *thiz);
+
+/**
+ * @brief Finds the edge of the state that is labeled by the alphabet
+ *
+ * @param thiz
+ * @param state
+ * @param alpha
+ * @return the edge index, or DAWG_NONE if there is no such edge
+ *****************************************************************************/
+static inline uint32_t dawg_find_edge
+    (const ACT_DAWG_t *thiz, uint32_t state, AC_ALPHABET_t alpha)
+{
+    const struct act_dawg_state *s = &thiz->states[state];
+    const AC_ALPHABET_t *labels = &thiz->labels[s->edges];
+    size_t low = 0, high = s->edges_count, mid;
+
+    while (low < high)
+    {
+        mid = (low + high) / 2;
+        if (labels[mid] < alpha)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return (low < s->edges_count && labels[low] == alpha) ?
+            s->edges + low : DAWG_NONE;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,665 @@
+/*
+ * delta.c: Implements the patterns that are added to a finalized trie
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ahocorasick.h"
+#include "arena.h"
+#include "mpool.h"
+#include "delta.h"
+
+/* Privates */
+static AC_TRIE_t *delta_create_trie (const AC_TRIE_t *like);
+static int delta_same_text (const unsigned char *map, 
+        const AC_PATTERN_t *a, const AC_PATTERN_t *b);
+static int delta_search_pop (ACT_DELTA_SEARCH_t *thiz, 
+        AC_MATCH_CALBACK_f callback, void *user);
+static int delta_search_merge (ACT_DELTA_SEARCH_t *thiz, 
+        AC_MATCH_t *match, AC_MATCH_CALBACK_f callback, void *user);
+static void delta_search_hold (ACT_DELTA_SEARCH_t *thiz, 
+        const AC_MATCH_t *match);
+
+
+/**
+ * @brief Creates an empty delta of the given finalized trie
+ *
+ * @param trie
+ * @return
+ *****************************************************************************/
+ACT_DELTA_t *delta_create (const AC_TRIE_t *trie)
+{
+    ACT_DELTA_t *thiz = (ACT_DELTA_t *) malloc (sizeof(ACT_DELTA_t));
+
+    thiz->open = delta_create_trie (trie);
+    thiz->trie = NULL;
+    thiz->stale = 0;
+    thiz->rebuild = 0;
+    thiz->generation = 0;
+
+    thiz->patterns = NULL;
+    thiz->count = 0;
+    thiz->capacity = 0;
+    thiz->length = 0;
+    thiz->replacements = 0;
+
+    thiz->removing = NULL;
+    thiz->removed = NULL;
+    thiz->pending = NULL;
+    thiz->pending_count = 0;
+    thiz->pending_capacity = 0;
+    thiz->removed_count = 0;
+    thiz->matched_count = 0;
+
+    thiz->built = 0;
+    atomic_init (&thiz->scanned, 0);
+
+    thiz->mp = mpool_create (0);
+
+    return thiz;
+}
+
+/**
+ * @brief Releases the delta
+ *
+ * @param thiz
+ *****************************************************************************/
+void delta_release (ACT_DELTA_t *thiz)
+{
+    if (!thiz)
+        return;
+
+    ac_trie_release (thiz->open);
+    if (thiz->trie)
+        ac_trie_release (thiz->trie);
+    free (thiz->patterns);
+    free (thiz->removing);
+    free (thiz->removed);
+    free (thiz->pending);
+    mpool_free (thiz->mp);
+    free (thiz);
+}
+
+/**
+ * @brief Adds a copy of the pattern to the delta
+ *
+ * The pattern is searched after the delta is refreshed.
+ *
+ * @param thiz
+ * @param patt
+ * @return The status of ac_trie_add()
+ *****************************************************************************/
+AC_STATUS_t delta_add (ACT_DELTA_t *thiz, const AC_PATTERN_t *patt)
+{
+    AC_PATTERN_t copy;
+    AC_STATUS_t status;
+
+    copy.ptext.astring = (AC_ALPHABET_t *) mpool_strndup (thiz->mp,
+            (const char *) patt->ptext.astring, patt->ptext.length);
+    copy.ptext.length = patt->ptext.length;
+    copy.rtext.astring = (AC_ALPHABET_t *) mpool_strndup (thiz->mp,
+            (const char *) patt->rtext.astring, patt->rtext.length);
+    copy.rtext.length = patt->rtext.length;
+    copy.id = patt->id;
+    if (patt->id.type == AC_PATTID_TYPE_STRING)
+        copy.id.u.stringy = (const char *) mpool_strdup (thiz->mp,
+                patt->id.u.stringy);
+
+    if ((status = ac_trie_add (thiz->open, &copy, 0)) != ACERR_SUCCESS)
+        return status;
+
+    if (thiz->count == thiz->capacity)
+    {
+        thiz->capacity = thiz->capacity ? 2 * thiz->capacity : 16;
+        thiz->patterns = (AC_PATTERN_t *) realloc (thiz->patterns,
+                thiz->capacity * sizeof(AC_PATTERN_t));
+    }
+    thiz->patterns[thiz->count++] = copy;
+    thiz->length += copy.ptext.length;
+
+    if (copy.rtext.astring)
+        thiz->replacements++;
+
+    thiz->stale = 1;
+    thiz->rebuild = 1;
+
+    return ACERR_SUCCESS;
+}
+
+/**
+ * @brief Removes an added pattern from the delta
+ *
+ * @param thiz
+ * @param patt
+ * @return ACERR_SUCCESS, or ACERR_PATTERN_NOT_FOUND if it was not added
+ *****************************************************************************/
+AC_STATUS_t delta_remove (ACT_DELTA_t *thiz, AC_PATTERN_t *patt)
+{
+    size_t i;
+
+    if (ac_trie_remove (thiz->open, patt) != ACERR_SUCCESS)
+        return ACERR_PATTERN_NOT_FOUND;
+
+    /* The open trie has it, so the array has it too */
+    for (i = 0; !delta_same_text (thiz->open->map, &thiz->patterns[i], patt);
+            i++)
+        ;
+
+    if (thiz->patterns[i].rtext.astring)
+        thiz->replacements--;
+
+    thiz->length -= thiz->patterns[i].ptext.length;
+    thiz->patterns[i] = thiz->patterns[--thiz->count];
+    thiz->stale = 1;
+    thiz->rebuild = 1;
+
+    return ACERR_SUCCESS;
+}
+
+/**
+ * @brief Flags a pattern of the trie as removed
+ *
+ * The search skips it after the delta is refreshed.
+ *
+ * @param thiz
+ * @param arena the arena of the trie
+ * @param index index of the pattern in the matched array of the arena
+ *****************************************************************************/
+void delta_remove_matched (ACT_DELTA_t *thiz, const ACT_ARENA_t *arena,
+        uint32_t index)
+{
+    if (!thiz->removing)
+    {
+        thiz->matched_count = arena->matched_count;
+        thiz->removing = (uint8_t *) calloc (thiz->matched_count, 1);
+        thiz->removed = (uint8_t *) calloc (thiz->matched_count, 1);
+    }
+
+    if (thiz->pending_count == thiz->pending_capacity)
+    {
+        thiz->pending_capacity = thiz->pending_capacity ? 
+                2 * thiz->pending_capacity : 16;
+        thiz->pending = (uint32_t *) realloc (thiz->pending,
+                thiz->pending_capacity * sizeof(uint32_t));
+    }
+
+    thiz->removing[index] = 1;
+    thiz->pending[thiz->pending_count++] = index;
+    thiz->removed_count++;
+
+    if (arena->matched[index].rtext.astring)
+        thiz->replacements++;
+
+    thiz->stale = 1;
+}
+
+/**
+ * @brief Builds in the changes since the last refresh
+ *
+ * The delta trie is built again only if the added patterns are changed;
+ * of the removed patterns, only the ones removed since are flagged. The 
+ * work is charged to the delta.
+ *
+ * @param thiz
+ *****************************************************************************/
+void delta_refresh (ACT_DELTA_t *thiz)
+{
+    size_t i;
+
+    if (thiz->rebuild)
+    {
+        if (thiz->trie)
+            ac_trie_release (thiz->trie);
+        thiz->trie = NULL;
+
+        if (thiz->count)
+        {
+            thiz->trie = delta_create_trie (thiz->open);
+            for (i = 0; i < thiz->count; i++)
+                ac_trie_add (thiz->trie, &thiz->patterns[i], 0);
+            ac_trie_finalize (thiz->trie);
+        }
+
+        thiz->built += thiz->length;
+        thiz->generation++;
+        thiz->rebuild = 0;
+    }
+
+    for (i = 0; i < thiz->pending_count; i++)
+        thiz->removed[thiz->pending[i]] = 1;
+
+    thiz->built += thiz->pending_count;
+    thiz->pending_count = 0;
+    thiz->stale = 0;
+}
+
+/**
+ * @brief Tells if the delta must be merged into its trie
+ *
+ * It must, when the refreshes and the searches have cost as much as 
+ * rebuilding the trie, counting the refresh that is due; or when the trie
+ * has more removed patterns than live ones. The changes of the patterns 
+ * that have a replacement are merged at once, since multifast_replace() 
+ * works on the main trie only.
+ *
+ * @param thiz
+ * @param arena the arena of the trie
+ * @param patterns_count number of the patterns of the trie
+ * @return
+ *****************************************************************************/
+int delta_must_merge (const ACT_DELTA_t *thiz, const ACT_ARENA_t *arena,
+        size_t patterns_count)
+{
+    size_t spent;
+
+    if (thiz->replacements)
+        return 1;
+
+    if (!thiz->count && !thiz->removed_count)
+        return 0;
+
+    spent = thiz->built + atomic_load_explicit (&thiz->scanned,
+            memory_order_relaxed) / DELTA_SCAN_COST;
+    if (thiz->rebuild)
+        spent += thiz->length;
+    spent += thiz->pending_count;
+
+    return spent > arena->states_count + thiz->length || 
+            thiz->removed_count > patterns_count;
+}
+
+/**
+ * @brief Makes the search state ready for the current delta trie
+ *
+ * A new search state starts from the root of the trie. The state made for
+ * a former trie is left in the root; the caller finds its state from the 
+ * kept bytes.
+ *
+ * @param thiz the search state, or NULL to make one
+ * @param delta
+ * @return The search state
+ *****************************************************************************/
+ACT_DELTA_SEARCH_t *delta_search_sync (ACT_DELTA_SEARCH_t *thiz,
+        const ACT_DELTA_t *delta)
+{
+    size_t size;
+
+    if (!thiz)
+    {
+        thiz = (ACT_DELTA_SEARCH_t *) calloc (1, sizeof(ACT_DELTA_SEARCH_t));
+        thiz->generation = delta->generation - 1;
+        thiz->history = (AC_ALPHABET_t *) malloc (DELTA_HISTORY_SIZE);
+        delta_search_reset (thiz);
+    }
+
+    if (thiz->generation != delta->generation)
+    {
+        size = delta->trie->arena->matches_max;
+        thiz->patterns = (AC_PATTERN_t *) realloc (thiz->patterns,
+                (size ? size : 1) * sizeof(AC_PATTERN_t));
+        thiz->state = ARENA_ROOT;
+        thiz->generation = delta->generation;
+    }
+
+    return thiz;
+}
+
+/**
+ * @brief Starts the search over, for a new text
+ *
+ * @param thiz
+ *****************************************************************************/
+void delta_search_reset (ACT_DELTA_SEARCH_t *thiz)
+{
+    thiz->state = ARENA_ROOT;
+    thiz->scanned = 0;
+    thiz->queue_head = 0;
+    thiz->queue_size = 0;
+    thiz->pool_size = 0;
+    thiz->holding = 0;
+    thiz->history_size = 0;
+    thiz->history_next = 0;
+}
+
+/**
+ * @brief Releases the search state
+ *
+ * @param thiz
+ *****************************************************************************/
+void delta_search_release (ACT_DELTA_SEARCH_t *thiz)
+{
+    if (!thiz)
+        return;
+
+    free (thiz->patterns);
+    free (thiz->merged);
+    free (thiz->queue);
+    free (thiz->pool);
+    free (thiz->held.patterns);
+    free (thiz->history);
+    free (thiz);
+}
+
+/**
+ * @brief Keeps the last bytes of the text that the delta is scanned over
+ *
+ * @param thiz
+ * @param astring the scanned bytes
+ * @param length number of the scanned bytes
+ *****************************************************************************/
+void delta_search_keep (ACT_DELTA_SEARCH_t *thiz, 
+        const AC_ALPHABET_t *astring, size_t length)
+{
+    size_t size;
+
+    if (length > DELTA_HISTORY_SIZE)
+    {
+        astring += length - DELTA_HISTORY_SIZE;
+        length = DELTA_HISTORY_SIZE;
+    }
+
+    while (length)
+    {
+        size = DELTA_HISTORY_SIZE - thiz->history_next;
+        if (size > length)
+            size = length;
+
+        memcpy (&thiz->history[thiz->history_next], astring, size);
+        thiz->history_next = (thiz->history_next + size) % 
+                DELTA_HISTORY_SIZE;
+        astring += size;
+        length -= size;
+
+        thiz->history_size += size;
+        if (thiz->history_size > DELTA_HISTORY_SIZE)
+            thiz->history_size = DELTA_HISTORY_SIZE;
+    }
+}
+
+/**
+ * @brief Queues a match of the delta; it is the call-back function of the
+ * delta scan
+ *
+ * @param match
+ * @param param the search state
+ * @return 0; the scan goes on
+ *****************************************************************************/
+int delta_search_queue (AC_MATCH_t *match, void *param)
+{
+    ACT_DELTA_SEARCH_t *thiz = (ACT_DELTA_SEARCH_t *) param;
+    struct act_delta_match *item;
+
+    if (thiz->queue_size == thiz->queue_capacity)
+    {
+        thiz->queue_capacity = thiz->queue_capacity ? 
+                2 * thiz->queue_capacity : 16;
+        thiz->queue = (struct act_delta_match *) realloc (thiz->queue,
+                thiz->queue_capacity * sizeof(struct act_delta_match));
+    }
+
+    if (thiz->pool_size + match->size > thiz->pool_capacity)
+    {
+        thiz->pool_capacity = 2 * (thiz->pool_size + match->size);
+        thiz->pool = (AC_PATTERN_t *) realloc (thiz->pool,
+                thiz->pool_capacity * sizeof(AC_PATTERN_t));
+    }
+
+    item = &thiz->queue[thiz->queue_size++];
+    item->position = match->position;
+    item->first = thiz->pool_size;
+    item->size = match->size;
+
+    memcpy (&thiz->pool[thiz->pool_size], match->patterns, 
+            match->size * sizeof(AC_PATTERN_t));
+    thiz->pool_size += match->size;
+
+    return 0;
+}
+
+/**
+ * @brief Reports a match of the main trie, after the queued matches before
+ * it and along with the queued match at the same position
+ *
+ * If the call-back function stops on a match before it, the match is held
+ * for delta_search_resume().
+ *
+ * @param thiz
+ * @param match the match of the main trie
+ * @param callback the match call-back function
+ * @param user this parameter will be send to the call-back function
+ * @return the return value of the call-back function that was called last
+ *****************************************************************************/
+int delta_search_report (ACT_DELTA_SEARCH_t *thiz, AC_MATCH_t *match,
+        AC_MATCH_CALBACK_f callback, void *user)
+{
+    while (thiz->queue_head < thiz->queue_size && 
+            thiz->queue[thiz->queue_head].position < match->position)
+    {
+        if (delta_search_pop (thiz, callback, user))
+        {
+            delta_search_hold (thiz, match);
+            return 1;
+        }
+    }
+
+    return delta_search_merge (thiz, match, callback, user);
+}
+
+/**
+ * @brief Reports the held match, after the queued matches before it
+ *
+ * @param thiz
+ * @param callback the match call-back function
+ * @param user this parameter will be send to the call-back function
+ * @return 1 if the call-back function stopped the search, 0 otherwise
+ *****************************************************************************/
+int delta_search_resume (ACT_DELTA_SEARCH_t *thiz, 
+        AC_MATCH_CALBACK_f callback, void *user)
+{
+    if (!thiz->holding)
+        return 0;
+
+    thiz->holding = 0;
+
+    while (thiz->queue_head < thiz->queue_size && 
+            thiz->queue[thiz->queue_head].position < thiz->held.position)
+    {
+        if (delta_search_pop (thiz, callback, user))
+        {
+            thiz->holding = 1;
+            return 1;
+        }
+    }
+
+    return delta_search_merge (thiz, &thiz->held, callback, user) ? 1 : 0;
+}
+
+/**
+ * @brief Reports all the queued matches
+ *
+ * @param thiz
+ * @param callback the match call-back function
+ * @param user this parameter will be send to the call-back function
+ * @return 1 if the call-back function stopped the search, 0 otherwise
+ *****************************************************************************/
+int delta_search_flush (ACT_DELTA_SEARCH_t *thiz, 
+        AC_MATCH_CALBACK_f callback, void *user)
+{
+    while (thiz->queue_head < thiz->queue_size)
+        if (delta_search_pop (thiz, callback, user))
+            return 1;
+
+    return 0;
+}
+
+/**
+ * @brief Reports the first queued match
+ *
+ * The queue starts over when it is empty; the patterns of the reported 
+ * match stay in place until the next match is queued.
+ *
+ * @param thiz
+ * @param callback the match call-back function
+ * @param user this parameter will be send to the call-back function
+ * @return the return value of the call-back function
+ *****************************************************************************/
+static int delta_search_pop (ACT_DELTA_SEARCH_t *thiz, 
+        AC_MATCH_CALBACK_f callback, void *user)
+{
+    const struct act_delta_match *item = &thiz->queue[thiz->queue_head++];
+    AC_MATCH_t match;
+
+    match.position = item->position;
+    match.patterns = &thiz->pool[item->first];
+    match.size = item->size;
+
+    if (thiz->queue_head == thiz->queue_size)
+    {
+        thiz->queue_head = 0;
+        thiz->queue_size = 0;
+        thiz->pool_size = 0;
+    }
+
+    return callback (&match, user);
+}
+
+/**
+ * @brief Reports a match of the main trie, merged with the first queued 
+ * match if it ends at the same position
+ *
+ * Both lists come the longest first, and so does the merged one; it is
+ * what a single trie of all the patterns would report.
+ *
+ * @param thiz
+ * @param match the match of the main trie
+ * @param callback the match call-back function
+ * @param user this parameter will be send to the call-back function
+ * @return the return value of the call-back function
+ *****************************************************************************/
+static int delta_search_merge (ACT_DELTA_SEARCH_t *thiz, 
+        AC_MATCH_t *match, AC_MATCH_CALBACK_f callback, void *user)
+{
+    const struct act_delta_match *item = &thiz->queue[thiz->queue_head];
+    const AC_PATTERN_t *main = match->patterns, *delta;
+    AC_MATCH_t merged;
+    size_t i = 0, j = 0, k = 0;
+
+    if (thiz->queue_head == thiz->queue_size || 
+            item->position != match->position)
+        return callback (match, user);
+
+    delta = &thiz->pool[item->first];
+
+    if (match->size + item->size > thiz->merged_capacity)
+    {
+        thiz->merged_capacity = 2 * (match->size + item->size);
+        thiz->merged = (AC_PATTERN_t *) realloc (thiz->merged,
+                thiz->merged_capacity * sizeof(AC_PATTERN_t));
+    }
+
+    while (i < match->size && j < item->size)
+    {
+        if (main[i].ptext.length >= delta[j].ptext.length)
+            thiz->merged[k++] = main[i++];
+        else
+            thiz->merged[k++] = delta[j++];
+    }
+
+    while (i < match->size)
+        thiz->merged[k++] = main[i++];
+    while (j < item->size)
+        thiz->merged[k++] = delta[j++];
+
+    merged.position = match->position;
+    merged.patterns = thiz->merged;
+    merged.size = k;
+
+    if (++thiz->queue_head == thiz->queue_size)
+    {
+        thiz->queue_head = 0;
+        thiz->queue_size = 0;
+        thiz->pool_size = 0;
+    }
+
+    return callback (&merged, user);
+}
+
+/**
+ * @brief Holds a copy of the match of the main trie
+ *
+ * @param thiz
+ * @param match
+ *****************************************************************************/
+static void delta_search_hold (ACT_DELTA_SEARCH_t *thiz, 
+        const AC_MATCH_t *match)
+{
+    if (match->size > thiz->held_capacity)
+    {
+        thiz->held_capacity = 2 * match->size;
+        thiz->held.patterns = (AC_PATTERN_t *) realloc (thiz->held.patterns,
+                thiz->held_capacity * sizeof(AC_PATTERN_t));
+    }
+
+    memcpy (thiz->held.patterns, match->patterns, 
+            match->size * sizeof(AC_PATTERN_t));
+    thiz->held.position = match->position;
+    thiz->held.size = match->size;
+    thiz->holding = 1;
+}
+
+/**
+ * @brief Creates an open trie of the same kind as the given one: with the 
+ * same byte map
+ *
+ * @param like
+ * @return
+ *****************************************************************************/
+static AC_TRIE_t *delta_create_trie (const AC_TRIE_t *like)
+{
+    AC_TRIE_t *trie = like->map ? ac_trie_create_mapped (like->map) :
+            ac_trie_create ();
+
+    return trie;
+}
+
+/**
+ * @brief Tells if the patterns have the same text, through the byte map
+ *
+ * @param map the byte map, or NULL
+ * @param a
+ * @param b
+ * @return
+ *****************************************************************************/
+static int delta_same_text (const unsigned char *map, 
+        const AC_PATTERN_t *a, const AC_PATTERN_t *b)
+{
+    size_t i;
+
+    if (a->ptext.length != b->ptext.length)
+        return 0;
+
+    for (i = 0; i < a->ptext.length; i++)
+        if (map ? map[(unsigned char) a->ptext.astring[i]] != 
+                map[(unsigned char) b->ptext.astring[i]] :
+                a->ptext.astring[i] != b->ptext.astring[i])
+            return 0;
+
+    return 1;
+}
@@ -0,0 +1,192 @@
+/*
+ * delta.h: Defines the patterns that are added to a finalized trie
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _DELTA_H_
+#define _DELTA_H_
+
+#include <stdatomic.h>
+#include "actypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Forward Declaration */
+struct ac_trie;
+struct act_arena;
+struct mpool;
+
+/**
+ * Scanning this many bytes of text with the delta costs about as much as
+ * building a state of the trie; it weighs the searches against a merge.
+ */
+#define DELTA_SCAN_COST 256
+
+/**
+ * The patterns that are added to or removed from a finalized trie
+ *
+ * The arena of a finalized trie is packed: its states, edges and byte
+ * classes, and the DFA and the prefilter built on them, can not take a new
+ * pattern in place. So the added patterns make a small trie of their own,
+ * the delta. The search runs the main trie on its own loop, and scans the 
+ * text for the delta in a separate pass; the matches of both are reported
+ * in the order that a single trie would report them.
+ *
+ * Refreshing the delta builds only what has changed: the delta trie, when
+ * the added patterns change, and the flags of the patterns removed since.
+ * Every refresh and every byte that the searches scan for the delta is 
+ * charged to the delta. When the charges grow to the cost of rebuilding
+ * the whole trie, the next finalize merges both into a single trie; so a 
+ * delta never costs more than a merge would. 
+ *
+ * A pattern of the main trie is removed by a flag; the arena does not 
+ * report the flagged patterns. Their states stay in the trie until it is
+ * rebuilt, by a merge or by ac_trie_compact().
+ */
+typedef struct act_delta
+{
+    struct ac_trie *open;   /**< The added patterns in a trie that is never
+                             * finalized; it finds the duplicates */
+    struct ac_trie *trie;   /**< The finalized trie of the added patterns */
+    int stale;              /**< Patterns are added or removed since the 
+                             * last refresh */
+    int rebuild;            /**< The added patterns are changed since the 
+                             * trie is built */
+    unsigned long generation;   /**< Number of the times the trie is built */
+
+    AC_PATTERN_t *patterns; /**< The added patterns */
+    size_t count;           /**< Number of the added patterns */
+    size_t capacity;        /**< Max capacity of the patterns array */
+    size_t length;          /**< Total length of the added patterns */
+    size_t replacements;    /**< Number of the added or removed patterns 
+                             * that have a replacement */
+    
+    uint8_t *removing;      /**< Flags of the removed patterns of the trie,
+                             * by their index in its matched array, or NULL */
+    uint8_t *removed;       /**< The flags as of the last refresh; these 
+                             * patterns are not reported */
+    uint32_t *pending;      /**< Indices of the flags that are set since 
+                             * the last refresh */
+    size_t pending_count;   /**< Number of the pending flags */
+    size_t pending_capacity;    /**< Max capacity of the pending array */
+    size_t removed_count;   /**< Number of the removed patterns of the trie */
+    size_t matched_count;   /**< Number of the flags */
+
+    size_t built;           /**< Cost of the refreshes, in states */
+    atomic_size_t scanned;  /**< Bytes of text scanned for the delta */
+
+    struct mpool *mp;       /**< Memory pool of the pattern strings */
+
+} ACT_DELTA_t;
+
+/**
+ * A match of the delta that waits for the matches of the main trie before
+ * it
+ */
+struct act_delta_match
+{
+    size_t position;    /**< The end position of the match */
+    size_t first;       /**< Index of its first pattern in the pool */
+    size_t size;        /**< Number of its patterns */
+};
+
+/**
+ * The state of a search in the delta
+ *
+ * Every search context (a trie, a search payload) keeps its own. The delta
+ * is scanned ahead over every chunk of text, and its matches are queued 
+ * until the main trie reaches their positions. When the main trie has a 
+ * match while the caller stops on a queued one, the match is held and 
+ * reported first by the next call.
+ *
+ * The last bytes scanned are kept; when the delta trie is built again, 
+ * they are scanned once more to find the state of the new trie, so a 
+ * search that goes on over chunks does not miss the patterns that span the
+ * refresh.
+ */
+typedef struct act_delta_search
+{
+    unsigned long generation;   /**< The generation of the delta trie that 
+                                 * it is made for */
+    ACT_STATE_t state;          /**< The current state in the delta trie */
+    size_t scanned;             /**< The position that the delta is scanned
+                                 * to, related to the whole input */
+
+    AC_PATTERN_t *patterns;     /**< The patterns of the delta state */
+    AC_PATTERN_t *merged;       /**< A match of both tries */
+    size_t merged_capacity;     /**< Max capacity of the merged array */
+
+    struct act_delta_match *queue;  /**< The matches waiting in the queue */
+    size_t queue_head;          /**< Index of the first waiting match */
+    size_t queue_size;          /**< Number of the items in the queue */
+    size_t queue_capacity;      /**< Max capacity of the queue */
+    AC_PATTERN_t *pool;         /**< The patterns of the queued matches */
+    size_t pool_size;           /**< Number of the patterns in the pool */
+    size_t pool_capacity;       /**< Max capacity of the pool */
+
+    AC_MATCH_t held;            /**< The held match of the main trie */
+    int holding;                /**< There is a held match */
+    size_t held_capacity;       /**< Max capacity of the held patterns */
+
+    AC_ALPHABET_t *history;     /**< The last bytes scanned, a ring */
+    size_t history_size;        /**< Number of the kept bytes */
+    size_t history_next;        /**< Index of the next byte in the ring */
+
+} ACT_DELTA_SEARCH_t;
+
+/**
+ * The bytes kept for finding the state of a new delta trie; a pattern that
+ * spans the refresh has at most this many bytes before it
+ */
+#define DELTA_HISTORY_SIZE (AC_PATTRN_MAX_LENGTH - 1)
+
+/*
+ * Delta interface functions
+ */
+
+ACT_DELTA_t *delta_create (const struct ac_trie *trie);
+void delta_release (ACT_DELTA_t *thiz);
+AC_STATUS_t delta_add (ACT_DELTA_t *thiz, const AC_PATTERN_t *patt);
+AC_STATUS_t delta_remove (ACT_DELTA_t *thiz, AC_PATTERN_t *patt);
+void delta_remove_matched (ACT_DELTA_t *thiz, const struct act_arena *arena,
+        uint32_t index);
+void delta_refresh (ACT_DELTA_t *thiz);
+int  delta_must_merge (const ACT_DELTA_t *thiz, 
+        const struct act_arena *arena, size_t patterns_count);
+
+ACT_DELTA_SEARCH_t *delta_search_sync (ACT_DELTA_SEARCH_t *thiz,
+        const ACT_DELTA_t *delta);
+void delta_search_reset (ACT_DELTA_SEARCH_t *thiz);
+void delta_search_release (ACT_DELTA_SEARCH_t *thiz);
+void delta_search_keep (ACT_DELTA_SEARCH_t *thiz, 
+        const AC_ALPHABET_t *astring, size_t length);
+int  delta_search_queue (AC_MATCH_t *match, void *param);
+int  delta_search_report (ACT_DELTA_SEARCH_t *thiz, AC_MATCH_t *match,
+        AC_MATCH_CALBACK_f callback, void *user);
+int  delta_search_resume (ACT_DELTA_SEARCH_t *thiz, 
+        AC_MATCH_CALBACK_f callback, void *user);
+int  delta_search_flush (ACT_DELTA_SEARCH_t *thiz, 
+        AC_MATCH_CALBACK_f callback, void *user);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,162 @@
+/*
+ * dfa.c: Compiles a finalized trie into a DFA transition table
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dfa.h"
+#include "pages.h"
+
+/* Privates */
+static void dfa_fill_row 
+    (ACT_DFA_t *thiz, const ACT_ARENA_t *arena, uint32_t state);
+static uint32_t *dfa_order_states (const ACT_ARENA_t *arena);
+
+
+/**
+ * @brief Creates the DFA of the given arena
+ *
+ * @param arena
+ * @param options OR'ed values of ACT_FINALIZE_OPTION_t
+ * @return
+ *****************************************************************************/
+ACT_DFA_t *dfa_create (const ACT_ARENA_t *arena, int options)
+{
+    uint32_t i, *order;
+    ACT_DFA_t *thiz;
+
+    thiz = (ACT_DFA_t *) malloc (sizeof(ACT_DFA_t));
+    thiz->states_count = arena->states_count;
+    thiz->stride = arena->classes_count;
+
+    thiz->delta = (uint32_t *) pages_alloc 
+            (thiz->states_count * thiz->stride * sizeof(uint32_t), 
+             options & AC_FINALIZE_HUGE_PAGES, &thiz->delta_mapped);
+
+    /* The failure state of every state is less deep, so its row is already
+     * filled if the rows are filled in the order of depth */
+    order = dfa_order_states (arena);
+    for (i = 0; i < thiz->states_count; i++)
+        dfa_fill_row (thiz, arena, order[i]);
+    free (order);
+
+    return thiz;
+}
+
+/**
+ * @brief Releases the DFA
+ *
+ * @param thiz
+ *****************************************************************************/
+void dfa_release (ACT_DFA_t *thiz)
+{
+    if (!thiz)
+        return;
+
+    pages_free (thiz->delta, 
+            thiz->states_count * thiz->stride * sizeof(uint32_t), 
+            thiz->delta_mapped);
+    free (thiz);
+}
+
+/**
+ * @brief Sorts the states of the arena by their depth
+ *
+ * The arena states are numbered in BFS order unless they are reordered by
+ * a profile, so a counting sort by depth is needed in general. A chain 
+ * state is one level above its next state, which has a greater number if 
+ * it is a chain state too.
+ *
+ * @param arena
+ * @return The state numbers in the order of depth; the caller frees it
+ *****************************************************************************/
+static uint32_t *dfa_order_states (const ACT_ARENA_t *arena)
+{
+    size_t i, depth, max_depth = 0;
+    uint32_t *order, *starts, *depths;
+
+    depths = (uint32_t *) malloc (arena->states_count * sizeof(uint32_t));
+
+    for (i = 0; i < arena->chain_base; i++)
+        depths[i] = arena->infos[i].depth;
+    for (i = arena->states_count; i-- > arena->chain_base; )
+        depths[i] = depths[arena->chains[i - arena->chain_base].next] - 1;
+
+    for (i = 0; i < arena->states_count; i++)
+        if (depths[i] > max_depth)
+            max_depth = depths[i];
+
+    starts = (uint32_t *) calloc (max_depth + 2, sizeof(uint32_t));
+    order = (uint32_t *) malloc (arena->states_count * sizeof(uint32_t));
+
+    for (i = 0; i < arena->states_count; i++)
+        starts[depths[i] + 1]++;
+    for (depth = 1; depth <= max_depth + 1; depth++)
+        starts[depth] += starts[depth - 1];
+    for (i = 0; i < arena->states_count; i++)
+        order[starts[depths[i]]++] = i;
+
+    free (starts);
+    free (depths);
+
+    return order;
+}
+
+/**
+ * @brief Fills the transition table row of the given state
+ *
+ * A transition is the goto transition if the state has one for the alphabet,
+ * otherwise it is the same transition of the failure state.
+ *
+ * @param thiz
+ * @param arena
+ * @param state
+ *****************************************************************************/
+static void dfa_fill_row 
+    (ACT_DFA_t *thiz, const ACT_ARENA_t *arena, uint32_t state)
+{
+    uint32_t i, next, failure = ARENA_FAILURE(arena, state);
+    const struct act_state *s;
+    uint32_t *row = &thiz->delta[DFA_INDEX(thiz, state, 0)];
+
+    if (failure != ARENA_NONE)
+        memcpy (row, &thiz->delta[DFA_INDEX(thiz, failure, 0)],
+                thiz->stride * sizeof(uint32_t));
+    else
+        /* The root: every missing transition loops back to the root */
+        memset (row, 0, thiz->stride * sizeof(uint32_t));
+
+    if (ARENA_IS_CHAIN(arena, state))
+    {
+        next = arena->chains[state - arena->chain_base].next;
+        row[arena->chain_labels[state - arena->chain_base]] = next | 
+            (ARENA_IS_MARKED(arena, next) ? DFA_MATCH_FLAG : 0);
+        return;
+    }
+
+    s = &arena->states[state];
+
+    for (i = s->edges; i < s->edges + s->edges_count; i++)
+    {
+        next = arena->targets[i];
+        row[arena->labels[i]] = next | 
+            (ARENA_IS_MARKED(arena, next) ? DFA_MATCH_FLAG : 0);
+    }
+}
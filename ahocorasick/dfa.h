@@ -0,0 +1,82 @@
+/*
+ * dfa.h: Defines the DFA transition table of a finalized trie
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _DFA_H_
+#define _DFA_H_
+
+#include "arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The transition table entries hold the target state number. The most
+ * significant bit is set if the target state accepts any pattern or has 
+ * tail patterns, so the search loop does not need to look at the node to 
+ * know if it must report.
+ */
+#define DFA_MATCH_FLAG 0x80000000U
+#define DFA_STATE_MASK 0x7FFFFFFFU
+
+/**
+ * The DFA compiled from a finalized trie
+ *
+ * The goto and failure functions of the trie are merged into a single dense
+ * transition function. Each state has one row with an entry for every
+ * byte equivalence class of the arena, so consuming one input alphabet costs
+ * a class map lookup and a table lookup. The states are the same as the 
+ * states of the arena.
+ */
+typedef struct act_dfa
+{
+    uint32_t *delta;        /**< The transition table */
+    size_t states_count;    /**< Number of states (rows) */
+    size_t stride;          /**< Number of columns (classes) in every row */
+    int delta_mapped;       /**< How the table is allocated; see 
+                             * pages_alloc() and PAGES_IMAGE */
+
+} ACT_DFA_t;
+
+/**
+ * ac_trie_finalize() builds the DFA only if its transition table is not
+ * bigger than this size; bigger tables miss the cache too often to be
+ * faster than walking the trie.
+ */
+#define DFA_AUTO_MAX_SIZE (16 * 1024 * 1024)
+
+/**
+ * Makes the table index of the given state and class
+ */
+#define DFA_INDEX(dfa, s, c) \
+    ((size_t)((s) & DFA_STATE_MASK) * (dfa)->stride + (c))
+
+/*
+ * DFA interface functions
+ */
+
+ACT_DFA_t *dfa_create (const ACT_ARENA_t *arena, int options);
+void dfa_release (ACT_DFA_t *thiz);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
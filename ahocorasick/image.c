@@ -0,0 +1,892 @@
+/*
+ * image.c: Implements the binary image of a finalized trie
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ahocorasick.h"
+#include "arena.h"
+#include "dfa.h"
+#include "dawg.h"
+#include "skip.h"
+#include "pages.h"
+#include "image.h"
+
+/**
+ * An image being written: its header, its trie section, and where every
+ * section comes from
+ */
+struct act_image_build
+{
+    struct act_image_header header;
+    struct act_image_trie info;
+    const void *data[IMAGE_SECTIONS_COUNT]; /**< The sections */
+    void *patterns;     /**< The patterns section */
+    char *strings;      /**< The strings section */
+    void *skip;         /**< The skip section, or NULL */
+};
+
+/* Privates */
+static void image_build (const AC_TRIE_t *trie,
+        struct act_image_build *build);
+static void image_build_release (struct act_image_build *build);
+static void image_set_section (struct act_image_header *header,
+        ACT_IMAGE_SECTION_ID_t id, const void *data, size_t size,
+        uint64_t *offset);
+static int  image_write_section (FILE *file, const void *data, size_t size,
+        uint64_t offset, uint64_t *written);
+static void *image_save_patterns (const ACT_ARENA_t *arena,
+        size_t *patterns_size, char **strings, size_t *strings_size);
+static void *image_save_skip (const ACT_SKIP_t *skip, size_t *size);
+static const void *image_section (const ACT_IMAGE_t *thiz,
+        ACT_IMAGE_SECTION_ID_t id, size_t *size);
+static int  image_check (const ACT_IMAGE_t *thiz, int verify);
+static int  image_load_arena (AC_TRIE_t *trie, const ACT_IMAGE_t *image,
+        const struct act_image_trie *info);
+static int  image_load_patterns (ACT_ARENA_t *arena,
+        const ACT_IMAGE_t *image);
+static int  image_load_dfa (AC_TRIE_t *trie, const ACT_IMAGE_t *image,
+        const struct act_image_trie *info);
+static int  image_load_dawg (AC_TRIE_t *trie, const ACT_IMAGE_t *image,
+        const struct act_image_trie *info);
+static int  image_load_skip (AC_TRIE_t *trie, const ACT_IMAGE_t *image);
+static uint64_t image_checksum (const void *data, size_t size);
+static uint64_t image_align (uint64_t size);
+
+/**
+ * Mixes a word into the checksum
+ */
+#define IMAGE_MIX(hash, word) \
+    (((hash) ^ (word)) * 0x9E3779B97F4A7C15ULL ^ ((hash) >> 29))
+
+/**
+ * Size of the saved skip scanner, before its shift tables
+ */
+#define IMAGE_SKIP_SIZE ((sizeof(ACT_SKIP_t) + 15) & ~(size_t)15)
+
+
+/**
+ * @brief Reads the image in the given file
+ *
+ * The file is mapped if possible, so the image is not read at once; see
+ * pages_map_file().
+ *
+ * @param path
+ * @return The image, or NULL if the file can not be read
+ *****************************************************************************/
+ACT_IMAGE_t *image_open (const char *path)
+{
+    ACT_IMAGE_t *thiz = (ACT_IMAGE_t *) malloc (sizeof(ACT_IMAGE_t));
+
+    if (!(thiz->base = pages_map_file (path, &thiz->size, &thiz->mapped)))
+    {
+        free (thiz);
+        return NULL;
+    }
+
+    return thiz;
+}
+
+/**
+ * @brief Releases the image. The trie that is loaded from it must be
+ * released before.
+ *
+ * @param thiz
+ *****************************************************************************/
+void image_close (ACT_IMAGE_t *thiz)
+{
+    if (!thiz)
+        return;
+
+    pages_unmap_file (thiz->base, thiz->size, thiz->mapped);
+    free (thiz);
+}
+
+/**
+ * @brief Reads the image in the named shared memory object
+ *
+ * @param name
+ * @return The image, or NULL if the object can not be mapped
+ *****************************************************************************/
+ACT_IMAGE_t *image_open_shared (const char *name)
+{
+    ACT_IMAGE_t *thiz = (ACT_IMAGE_t *) malloc (sizeof(ACT_IMAGE_t));
+
+    if (!(thiz->base = pages_map_shared (name, &thiz->size, &thiz->mapped)))
+    {
+        free (thiz);
+        return NULL;
+    }
+
+    return thiz;
+}
+
+/**
+ * @brief Writes the image of the finalized trie to the file
+ *
+ * @param trie
+ * @param file
+ * @return 0 on success, -1 if writing fails
+ *****************************************************************************/
+int image_save (const AC_TRIE_t *trie, FILE *file)
+{
+    struct act_image_build build;
+    uint64_t written = 0;
+    int i, failed = 0;
+
+    image_build (trie, &build);
+
+    failed |= image_write_section (file, &build.header, sizeof(build.header),
+            0, &written);
+    for (i = 0; i < IMAGE_SECTIONS_COUNT && !failed; i++)
+        failed |= image_write_section (file, build.data[i],
+                build.header.sections[i].size,
+                build.header.sections[i].offset, &written);
+
+    image_build_release (&build);
+
+    return failed ? -1 : 0;
+}
+
+/**
+ * @brief Writes the image of the finalized trie into a new named shared
+ * memory object
+ *
+ * The header is written last, so a process that maps the object before it
+ * is complete finds no valid image.
+ *
+ * @param trie
+ * @param name
+ * @return 0 on success, -1 if the object can not be created
+ *****************************************************************************/
+int image_share (const AC_TRIE_t *trie, const char *name)
+{
+    struct act_image_build build;
+    unsigned char *block;
+    size_t size;
+    int i;
+
+    image_build (trie, &build);
+    size = (size_t) build.header.image_size;
+
+    if (!(block = (unsigned char *) pages_create_shared (name, size)))
+    {
+        image_build_release (&build);
+        return -1;
+    }
+
+    for (i = 0; i < IMAGE_SECTIONS_COUNT; i++)
+        if (build.header.sections[i].size)
+            memcpy (block + build.header.sections[i].offset, build.data[i],
+                    (size_t) build.header.sections[i].size);
+    memcpy (block, &build.header, sizeof(build.header));
+
+    pages_unmap_file (block, size, PAGES_MAPPED);
+    image_build_release (&build);
+
+    return 0;
+}
+
+/**
+ * @brief Loads the image into the given trie
+ *
+ * The trie must be empty: it must have neither nodes nor search structures.
+ * The arena, the DFA table and the minimized tails are used in place, so
+ * the image must outlive the trie. On failure, what is loaded is left in
+ * the trie to be released with it.
+ *
+ * @param trie
+ * @param image
+ * @param verify compare the checksums of all the sections; it reads the
+ * whole image. The indices of the search structures are range checked 
+ * anyway; see arena_check().
+ * @return 0 on success, -1 if the image is not valid
+ *****************************************************************************/
+int image_load (AC_TRIE_t *trie, const ACT_IMAGE_t *image, int verify)
+{
+    const struct act_image_trie *info;
+    const unsigned char *map;
+    size_t size;
+
+    if (image_check (image, verify))
+        return -1;
+
+    info = (const struct act_image_trie *) image_section
+            (image, IMAGE_SECTION_TRIE, &size);
+    if (size != sizeof(struct act_image_trie))
+        return -1;
+
+    trie->patterns_count = info->patterns_count;
+    trie->repdata.has_replacement = info->has_replacement;
+    trie->options = info->options;
+    trie->stats = info->stats;
+
+    if ((map = (const unsigned char *) image_section
+            (image, IMAGE_SECTION_MAP, &size)))
+    {
+        if (size != AC_MAP_SIZE)
+            return -1;
+        trie->map = (unsigned char *) malloc (AC_MAP_SIZE);
+        memcpy (trie->map, map, AC_MAP_SIZE);
+    }
+
+    if (image_load_arena (trie, image, info) ||
+            image_load_dfa (trie, image, info) ||
+            image_load_dawg (trie, image, info) ||
+            image_load_skip (trie, image))
+        return -1;
+
+    return 0;
+}
+
+/**
+ * @brief Lays out the image of the finalized trie
+ *
+ * The sections that the trie has as they are refer to it; the others are
+ * made and owned by the build.
+ *
+ * @param trie
+ * @param build
+ *****************************************************************************/
+static void image_build (const AC_TRIE_t *trie, struct act_image_build *build)
+{
+    const ACT_ARENA_t *arena = trie->arena;
+    struct act_image_header *header = &build->header;
+    struct act_image_trie *info = &build->info;
+    const void **data = build->data;
+    size_t patterns_size, strings_size, skip_size = 0;
+    uint64_t offset;
+
+    memset (info, 0, sizeof(*info));
+    info->patterns_count = trie->patterns_count;
+    info->has_replacement = trie->repdata.has_replacement;
+    info->states_count = arena->states_count;
+    info->chain_base = arena->chain_base;
+    info->edges_count = arena->edges_count;
+    info->matched_count = arena->matched_count;
+    info->matches_max = arena->matches_max;
+    info->bitmaps_count = arena->bitmaps_count;
+    info->dense_count = arena->dense_count;
+    info->tails_count = arena->tails_count;
+    info->classes_count = arena->classes_count;
+    info->void_class = arena->void_class;
+    memcpy (info->classes, arena->classes, sizeof(info->classes));
+    if (trie->dfa)
+        info->dfa_stride = trie->dfa->stride;
+    if (trie->dawg)
+    {
+        info->dawg_states_count = trie->dawg->states_count;
+        info->dawg_edges_count = trie->dawg->edges_count;
+    }
+    info->options = trie->options;
+    info->stats = trie->stats;
+
+    build->patterns = image_save_patterns (arena, &patterns_size,
+            &build->strings, &strings_size);
+    build->skip = NULL;
+    if (trie->skip)
+        build->skip = image_save_skip (trie->skip, &skip_size);
+
+    memset (header, 0, sizeof(*header));
+    memcpy (header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header->version = IMAGE_VERSION;
+    header->byte_order = IMAGE_BYTE_ORDER;
+    header->word_size = sizeof(size_t);
+    header->header_size = sizeof(*header);
+
+    offset = image_align (sizeof(*header));
+    image_set_section (header, IMAGE_SECTION_TRIE,
+            data[IMAGE_SECTION_TRIE] = info, sizeof(*info), &offset);
+    image_set_section (header, IMAGE_SECTION_MAP,
+            data[IMAGE_SECTION_MAP] = trie->map,
+            trie->map ? AC_MAP_SIZE : 0, &offset);
+    image_set_section (header, IMAGE_SECTION_ARENA,
+            data[IMAGE_SECTION_ARENA] = arena->block,
+            arena_block_size (arena), &offset);
+    image_set_section (header, IMAGE_SECTION_PATTERNS,
+            data[IMAGE_SECTION_PATTERNS] = build->patterns, patterns_size,
+            &offset);
+    image_set_section (header, IMAGE_SECTION_STRINGS,
+            data[IMAGE_SECTION_STRINGS] = build->strings, strings_size,
+            &offset);
+    image_set_section (header, IMAGE_SECTION_DFA,
+            data[IMAGE_SECTION_DFA] = trie->dfa ? trie->dfa->delta : NULL,
+            trie->dfa ? trie->dfa->states_count * trie->dfa->stride *
+                sizeof(uint32_t) : 0, &offset);
+    image_set_section (header, IMAGE_SECTION_DAWG,
+            data[IMAGE_SECTION_DAWG] = trie->dawg ? trie->dawg->block : NULL,
+            trie->dawg ? trie->dawg->block_size : 0, &offset);
+    image_set_section (header, IMAGE_SECTION_SKIP,
+            data[IMAGE_SECTION_SKIP] = build->skip, skip_size, &offset);
+
+    header->image_size = offset;
+    header->checksum = image_checksum
+            (header, offsetof(struct act_image_header, checksum));
+}
+
+/**
+ * @brief Releases the sections that the build has made
+ *
+ * @param build
+ *****************************************************************************/
+static void image_build_release (struct act_image_build *build)
+{
+    free (build->patterns);
+    free (build->strings);
+    free (build->skip);
+}
+
+/**
+ * @brief Places a section after the previous ones
+ *
+ * @param header
+ * @param id
+ * @param data
+ * @param size
+ * @param offset the end of the previous sections; it is moved to the end of
+ * this one
+ *****************************************************************************/
+static void image_set_section (struct act_image_header *header,
+        ACT_IMAGE_SECTION_ID_t id, const void *data, size_t size,
+        uint64_t *offset)
+{
+    struct act_image_section *section = &header->sections[id];
+
+    section->offset = size ? *offset : 0;
+    section->size = size;
+    section->checksum = size ? image_checksum (data, size) : 0;
+
+    *offset = image_align (*offset + size);
+}
+
+/**
+ * @brief Writes a section at its offset, padding the file with zeros
+ *
+ * @param file
+ * @param data
+ * @param size
+ * @param offset
+ * @param written number of the bytes written so far; it is updated
+ * @return 0 on success, -1 if writing fails
+ *****************************************************************************/
+static int image_write_section (FILE *file, const void *data, size_t size,
+        uint64_t offset, uint64_t *written)
+{
+    static const char zeros[IMAGE_ALIGN];
+    size_t gap;
+
+    if (!size)
+        return 0;
+
+    while (*written < offset)
+    {
+        gap = offset - *written < IMAGE_ALIGN ?
+                (size_t) (offset - *written) : IMAGE_ALIGN;
+        if (fwrite (zeros, 1, gap, file) != gap)
+            return -1;
+        *written += gap;
+    }
+
+    if (fwrite (data, 1, size, file) != size)
+        return -1;
+    *written += size;
+
+    /* The image ends at the end of an aligned section */
+    gap = (size_t) (image_align (*written) - *written);
+    if (gap && fwrite (zeros, 1, gap, file) != gap)
+        return -1;
+    *written += gap;
+
+    return 0;
+}
+
+/**
+ * @brief Makes the patterns and the strings sections
+ *
+ * @param arena
+ * @param patterns_size is set to the size of the patterns section
+ * @param strings is set to the strings section
+ * @param strings_size is set to the size of the strings section
+ * @return The patterns section
+ *****************************************************************************/
+static void *image_save_patterns (const ACT_ARENA_t *arena,
+        size_t *patterns_size, char **strings, size_t *strings_size)
+{
+    struct act_image_pattern *patterns, *record;
+    const AC_PATTERN_t *pattern;
+    size_t i, length, size = 0;
+    char *sp;
+
+    for (i = 0; i < arena->matched_count; i++)
+    {
+        pattern = &arena->matched[i];
+        size += pattern->ptext.length;
+        if (pattern->rtext.astring)
+            size += pattern->rtext.length;
+        if (pattern->id.type == AC_PATTID_TYPE_STRING &&
+                pattern->id.u.stringy)
+            size += strlen (pattern->id.u.stringy) + 1;
+    }
+
+    *patterns_size = arena->matched_count * sizeof(struct act_image_pattern);
+    patterns = (struct act_image_pattern *) calloc (1, *patterns_size + 1);
+    *strings_size = size;
+    *strings = sp = (char *) malloc (size + 1);
+
+    for (i = 0; i < arena->matched_count; i++)
+    {
+        pattern = &arena->matched[i];
+        record = &patterns[i];
+
+        record->ptext = sp - *strings;
+        record->ptext_length = pattern->ptext.length;
+        memcpy (sp, pattern->ptext.astring, pattern->ptext.length);
+        sp += pattern->ptext.length;
+
+        record->rtext = IMAGE_NONE;
+        if (pattern->rtext.astring)
+        {
+            record->rtext = sp - *strings;
+            record->rtext_length = pattern->rtext.length;
+            memcpy (sp, pattern->rtext.astring, pattern->rtext.length);
+            sp += pattern->rtext.length;
+        }
+
+        record->id_type = pattern->id.type;
+        if (pattern->id.type != AC_PATTID_TYPE_STRING)
+        {
+            record->id = (uint64_t) pattern->id.u.number;
+        }
+        else if (pattern->id.u.stringy)
+        {
+            record->id = sp - *strings;
+            length = strlen (pattern->id.u.stringy) + 1;
+            memcpy (sp, pattern->id.u.stringy, length);
+            sp += length;
+        }
+        else
+        {
+            record->id = IMAGE_NONE;
+        }
+    }
+
+    return patterns;
+}
+
+/**
+ * @brief Makes the skip section: the scanner without its pointers, then
+ * its shift tables if it has them
+ *
+ * @param skip
+ * @param size is set to the size of the section
+ * @return The section
+ *****************************************************************************/
+static void *image_save_skip (const ACT_SKIP_t *skip, size_t *size)
+{
+    unsigned char *section;
+    ACT_SKIP_t *saved;
+
+    *size = IMAGE_SKIP_SIZE;
+    if (skip->kind == SKIP_KIND_SHIFT)
+        *size += SKIP_SHIFT_TABLE_SIZE + SKIP_SHIFT_TABLE_SIZE / 8;
+
+    section = (unsigned char *) calloc (1, *size);
+    saved = (ACT_SKIP_t *) section;
+    *saved = *skip;
+    saved->shifts = NULL;
+    saved->prefixes = NULL;
+    saved->scan = NULL;
+
+    if (skip->kind == SKIP_KIND_SHIFT)
+    {
+        memcpy (section + IMAGE_SKIP_SIZE, skip->shifts,
+                SKIP_SHIFT_TABLE_SIZE);
+        memcpy (section + IMAGE_SKIP_SIZE + SKIP_SHIFT_TABLE_SIZE,
+                skip->prefixes, SKIP_SHIFT_TABLE_SIZE / 8);
+    }
+
+    return section;
+}
+
+/**
+ * @brief Finds a section of the image
+ *
+ * @param thiz
+ * @param id
+ * @param size is set to the size of the section
+ * @return The section, or NULL if it is missing
+ *****************************************************************************/
+static const void *image_section (const ACT_IMAGE_t *thiz,
+        ACT_IMAGE_SECTION_ID_t id, size_t *size)
+{
+    const struct act_image_header *header =
+            (const struct act_image_header *) thiz->base;
+
+    *size = (size_t) header->sections[id].size;
+
+    return *size ?
+            (const unsigned char *) thiz->base + header->sections[id].offset :
+            NULL;
+}
+
+/**
+ * @brief Checks the header of the image, and the checksums of the sections
+ * if asked to
+ *
+ * @param thiz
+ * @param verify
+ * @return 0 if the image can be loaded, -1 otherwise
+ *****************************************************************************/
+static int image_check (const ACT_IMAGE_t *thiz, int verify)
+{
+    const struct act_image_header *header =
+            (const struct act_image_header *) thiz->base;
+    const struct act_image_section *section;
+    int i;
+
+    if (thiz->size < sizeof(struct act_image_header) ||
+            memcmp (header->magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) ||
+            header->version != IMAGE_VERSION ||
+            header->byte_order != IMAGE_BYTE_ORDER ||
+            header->word_size != sizeof(size_t) ||
+            header->header_size != sizeof(struct act_image_header) ||
+            header->image_size != thiz->size ||
+            header->checksum != image_checksum
+                (header, offsetof(struct act_image_header, checksum)))
+        return -1;
+
+    for (i = 0; i < IMAGE_SECTIONS_COUNT; i++)
+    {
+        section = &header->sections[i];
+
+        if (section->offset % IMAGE_ALIGN || section->offset > thiz->size ||
+                section->size > thiz->size - section->offset)
+            return -1;
+
+        if (verify && section->size && section->checksum != image_checksum
+                ((const unsigned char *) thiz->base + section->offset,
+                 section->size))
+            return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Loads the arena and its patterns
+ *
+ * @param trie
+ * @param image
+ * @param info
+ * @return 0 on success, -1 if the image is not valid
+ *****************************************************************************/
+static int image_load_arena (AC_TRIE_t *trie, const ACT_IMAGE_t *image,
+        const struct act_image_trie *info)
+{
+    ACT_ARENA_t *arena;
+    const void *block;
+    size_t size;
+
+    if (!(block = image_section (image, IMAGE_SECTION_ARENA, &size)))
+        return -1;
+
+    arena = trie->arena = (ACT_ARENA_t *) malloc (sizeof(ACT_ARENA_t));
+    memcpy (arena->classes, info->classes, sizeof(arena->classes));
+    arena->classes_count = info->classes_count;
+    arena->void_class = info->void_class;
+    arena->states_count = info->states_count;
+    arena->chain_base = info->chain_base;
+    arena->edges_count = info->edges_count;
+    arena->matched_count = info->matched_count;
+    arena->matches_max = info->matches_max;
+    arena->bitmaps_count = info->bitmaps_count;
+    arena->dense_count = info->dense_count;
+    arena->tails_count = info->tails_count;
+
+    arena_attach (arena, (void *) block);
+    arena->block_size = size;
+    arena->block_mapped = PAGES_IMAGE;
+    arena->matched = NULL;
+    arena->removed = NULL;
+
+    if (arena->chain_base == 0 || arena->chain_base > arena->states_count ||
+            arena_block_size (arena) != size)
+        return -1;
+
+    if (image_load_patterns (arena, image))
+        return -1;
+
+    return arena_check (arena);
+}
+
+/**
+ * @brief Makes the matched array of the arena from the patterns section
+ *
+ * @param arena
+ * @param image
+ * @return 0 on success, -1 if the image is not valid
+ *****************************************************************************/
+static int image_load_patterns (ACT_ARENA_t *arena, const ACT_IMAGE_t *image)
+{
+    const struct act_image_pattern *patterns, *record;
+    const char *strings;
+    AC_PATTERN_t *pattern;
+    size_t i, size, strings_size;
+
+    patterns = (const struct act_image_pattern *) image_section
+            (image, IMAGE_SECTION_PATTERNS, &size);
+    strings = (const char *) image_section
+            (image, IMAGE_SECTION_STRINGS, &strings_size);
+
+    if (size != arena->matched_count * sizeof(struct act_image_pattern))
+        return -1;
+
+    arena->matched = (AC_PATTERN_t *) malloc
+            ((arena->matched_count ? arena->matched_count : 1) *
+             sizeof(AC_PATTERN_t));
+
+    for (i = 0; i < arena->matched_count; i++)
+    {
+        record = &patterns[i];
+        pattern = &arena->matched[i];
+
+        if (record->ptext > strings_size ||
+                record->ptext_length > strings_size - record->ptext)
+            return -1;
+        pattern->ptext.astring = &strings[record->ptext];
+        pattern->ptext.length = record->ptext_length;
+
+        pattern->rtext.astring = NULL;
+        pattern->rtext.length = 0;
+        if (record->rtext != IMAGE_NONE)
+        {
+            if (record->rtext > strings_size ||
+                    record->rtext_length > strings_size - record->rtext)
+                return -1;
+            pattern->rtext.astring = &strings[record->rtext];
+            pattern->rtext.length = record->rtext_length;
+        }
+
+        pattern->id.type = (enum ac_pattid_type) record->id_type;
+        if (record->id_type != AC_PATTID_TYPE_STRING)
+        {
+            pattern->id.u.number = (long) record->id;
+        }
+        else if (record->id == IMAGE_NONE)
+        {
+            pattern->id.u.stringy = NULL;
+        }
+        else
+        {
+            if (record->id >= strings_size || memchr (&strings[record->id],
+                    0, strings_size - record->id) == NULL)
+                return -1;
+            pattern->id.u.stringy = &strings[record->id];
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Loads the DFA, if the image has one
+ *
+ * @param trie
+ * @param image
+ * @param info
+ * @return 0 on success, -1 if the image is not valid
+ *****************************************************************************/
+static int image_load_dfa (AC_TRIE_t *trie, const ACT_IMAGE_t *image,
+        const struct act_image_trie *info)
+{
+    const ACT_ARENA_t *arena = trie->arena;
+    const uint32_t *delta;
+    size_t i, size;
+
+    if (!(delta = (const uint32_t *) image_section 
+            (image, IMAGE_SECTION_DFA, &size)))
+        return 0;
+
+    if (size != (size_t) info->states_count * info->dfa_stride *
+            sizeof(uint32_t) || info->dfa_stride != info->classes_count)
+        return -1;
+
+    /* The match flag makes the search collect the patterns of the state 
+     * without looking at it */
+    for (i = 0; i < size / sizeof(uint32_t); i++)
+        if ((delta[i] & DFA_STATE_MASK) >= info->states_count ||
+                !(delta[i] & DFA_MATCH_FLAG) != !ARENA_IS_MARKED(arena, 
+                    delta[i] & DFA_STATE_MASK))
+            return -1;
+
+    trie->dfa = (ACT_DFA_t *) malloc (sizeof(ACT_DFA_t));
+    trie->dfa->delta = (uint32_t *) delta;
+    trie->dfa->states_count = info->states_count;
+    trie->dfa->stride = info->dfa_stride;
+    trie->dfa->delta_mapped = PAGES_IMAGE;
+
+    return 0;
+}
+
+/**
+ * @brief Loads the minimized tails, if the image has them
+ *
+ * @param trie
+ * @param image
+ * @param info
+ * @return 0 on success, -1 if the image is not valid
+ *****************************************************************************/
+static int image_load_dawg (AC_TRIE_t *trie, const ACT_IMAGE_t *image,
+        const struct act_image_trie *info)
+{
+    const ACT_ARENA_t *arena = trie->arena;
+    ACT_DAWG_t *dawg;
+    const void *block;
+    uint32_t *counts;
+    size_t i, size;
+    int result;
+
+    if (!(block = image_section (image, IMAGE_SECTION_DAWG, &size)))
+        return 0;
+
+    dawg = trie->dawg = (ACT_DAWG_t *) calloc (1, sizeof(ACT_DAWG_t));
+    dawg->states_count = info->dawg_states_count;
+    dawg->edges_count = info->dawg_edges_count;
+    dawg_attach (dawg, (void *) block);
+    dawg->block_size = size;
+    dawg->block_mapped = PAGES_IMAGE;
+
+    if ((size_t) ((const unsigned char *) dawg->labels -
+            (const unsigned char *) block) + dawg->edges_count > size)
+        return -1;
+
+    /* The walk from the root of every tail must stay within its patterns */
+    counts = (uint32_t *) malloc 
+            ((dawg->states_count ? dawg->states_count : 1) * sizeof(uint32_t));
+    result = dawg_check (dawg, counts);
+
+    for (i = 0; i < arena->tails_count && !result; i++)
+        if (arena->tails[i].root >= dawg->states_count ||
+                counts[arena->tails[i].root] > arena->tails[i].patterns_size)
+            result = -1;
+
+    free (counts);
+
+    return result;
+}
+
+/**
+ * @brief Loads the skip scanner, if the image has one
+ *
+ * @param trie
+ * @param image
+ * @return 0 on success, -1 if the image is not valid
+ *****************************************************************************/
+static int image_load_skip (AC_TRIE_t *trie, const ACT_IMAGE_t *image)
+{
+    const unsigned char *section;
+    const ACT_SKIP_t *saved;
+    size_t i, size;
+
+    if (!(section = (const unsigned char *) image_section
+            (image, IMAGE_SECTION_SKIP, &size)))
+        return 0;
+
+    saved = (const ACT_SKIP_t *) section;
+    if (size < IMAGE_SKIP_SIZE || (saved->kind == SKIP_KIND_SHIFT &&
+            size < IMAGE_SKIP_SIZE + SKIP_SHIFT_TABLE_SIZE +
+                SKIP_SHIFT_TABLE_SIZE / 8))
+        return -1;
+
+    /* The counts and the offsets that the scanners index by */
+    switch (saved->kind)
+    {
+    case SKIP_KIND_BYTES:
+        if (saved->bytes_count > SKIP_MAX_BYTES)
+            return -1;
+        break;
+
+    case SKIP_KIND_TEDDY:
+        if (saved->teddy_width == 0 || 
+                saved->teddy_width > SKIP_TEDDY_MAX_WIDTH)
+            return -1;
+        break;
+
+    case SKIP_KIND_SHIFT:
+        if (saved->shift_window < SKIP_SHIFT_BLOCK || 
+                saved->shift_window > SKIP_SHIFT_MAX_WINDOW)
+            return -1;
+        break;
+
+    case SKIP_KIND_MEMMEM:
+        if (saved->memmem_count == 0 || 
+                saved->memmem_count > SKIP_MEMMEM_MAX_PATTERNS)
+            return -1;
+        for (i = 0; i < saved->memmem_count; i++)
+            if (saved->memmem_offsets[i] > saved->memmem_reach)
+                return -1;
+        break;
+
+    default:
+        return -1;
+    }
+
+    trie->skip = skip_restore (saved, section + IMAGE_SKIP_SIZE,
+            section + IMAGE_SKIP_SIZE + SKIP_SHIFT_TABLE_SIZE);
+
+    return 0;
+}
+
+/**
+ * @brief Computes the checksum of the bytes, a word at a time
+ *
+ * @param data
+ * @param size
+ * @return
+ *****************************************************************************/
+static uint64_t image_checksum (const void *data, size_t size)
+{
+    const unsigned char *bp = (const unsigned char *) data;
+    uint64_t hash = size, word;
+    size_t i;
+
+    for (i = 0; i + sizeof(word) <= size; i += sizeof(word))
+    {
+        memcpy (&word, &bp[i], sizeof(word));
+        hash = IMAGE_MIX(hash, word);
+    }
+
+    for (; i < size; i++)
+        hash = IMAGE_MIX(hash, bp[i]);
+
+    return hash;
+}
+
+/**
+ * @brief Rounds up the size to a multiple of IMAGE_ALIGN
+ *
+ * @param size
+ * @return
+ *****************************************************************************/
+static uint64_t image_align (uint64_t size)
+{
+    return (size + IMAGE_ALIGN - 1) & ~(uint64_t)(IMAGE_ALIGN - 1);
+}
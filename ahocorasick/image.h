@@ -0,0 +1,192 @@
+/*
+ * image.h: Defines the binary image of a finalized trie
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _IMAGE_H_
+#define _IMAGE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "actypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Forward Declaration */
+struct ac_trie;
+
+/**
+ * The first bytes of every image
+ */
+#define IMAGE_MAGIC "MFASTAC"
+
+/**
+ * Version of the image format; an image of another version is not loaded
+ */
+#define IMAGE_VERSION 1
+
+/**
+ * Written as it is, to tell the byte order of the image
+ */
+#define IMAGE_BYTE_ORDER 0x01020304U
+
+/**
+ * Alignment of the sections; a page, so every section can be used in place
+ */
+#define IMAGE_ALIGN 4096
+
+/**
+ * Marks a missing string
+ */
+#define IMAGE_NONE UINT64_MAX
+
+/**
+ * The sections of an image
+ */
+typedef enum act_image_section_id
+{
+    IMAGE_SECTION_TRIE = 0, /**< struct act_image_trie */
+    IMAGE_SECTION_MAP,      /**< The byte map, if the trie has one */
+    IMAGE_SECTION_ARENA,    /**< The block of the arena, without the 
+                             * matched patterns */
+    IMAGE_SECTION_PATTERNS, /**< struct act_image_pattern of every matched
+                             * pattern of the arena */
+    IMAGE_SECTION_STRINGS,  /**< The texts and the string ids of the 
+                             * patterns */
+    IMAGE_SECTION_DFA,      /**< The DFA transition table, if there is one */
+    IMAGE_SECTION_DAWG,     /**< The block of the minimized tails, if there
+                             * are */
+    IMAGE_SECTION_SKIP,     /**< The skip scanner and its shift tables, if
+                             * there is one */
+    IMAGE_SECTIONS_COUNT
+
+} ACT_IMAGE_SECTION_ID_t;
+
+/**
+ * Place of a section in the image; an empty section is missing
+ */
+struct act_image_section
+{
+    uint64_t offset;    /**< Offset from the beginning of the image */
+    uint64_t size;      /**< Size in bytes */
+    uint64_t checksum;  /**< Checksum of the bytes */
+};
+
+/**
+ * The header at the beginning of an image
+ */
+struct act_image_header
+{
+    char magic[8];          /**< IMAGE_MAGIC */
+    uint32_t version;       /**< IMAGE_VERSION */
+    uint32_t byte_order;    /**< IMAGE_BYTE_ORDER */
+    uint32_t word_size;     /**< sizeof(size_t) */
+    uint32_t header_size;   /**< sizeof(struct act_image_header) */
+    uint64_t image_size;    /**< Size of the whole image */
+    struct act_image_section sections[IMAGE_SECTIONS_COUNT];
+    uint64_t checksum;      /**< Checksum of the header before it */
+};
+
+/**
+ * The trie section: the counters of the structures in the other sections
+ */
+struct act_image_trie
+{
+    uint64_t patterns_count;    /**< Patterns of the trie */
+    uint32_t has_replacement;   /**< Number of the to-be-replaced patterns */
+
+    uint32_t states_count;      /**< The counters of the arena */
+    uint32_t chain_base;
+    uint32_t edges_count;
+    uint32_t matched_count;
+    uint32_t matches_max;
+    uint32_t bitmaps_count;
+    uint32_t dense_count;
+    uint32_t tails_count;
+    uint16_t classes_count;
+    uint16_t void_class;
+    uint8_t classes[256];       /**< The class map of the arena */
+
+    uint32_t dfa_stride;        /**< Columns of the DFA table */
+    uint32_t dawg_states_count; /**< States of the minimized tails */
+    uint32_t dawg_edges_count;  /**< Edges of the minimized tails */
+    uint32_t options;           /**< The options that the trie is finalized
+                                 * with */
+
+    AC_STATISTICS_t stats;      /**< Statistics of the patterns */
+};
+
+/**
+ * A pattern; its strings are offsets in the strings section
+ */
+struct act_image_pattern
+{
+    uint64_t ptext;         /**< Offset of the search string */
+    uint64_t rtext;         /**< Offset of the replace string, or 
+                             * IMAGE_NONE */
+    uint64_t id;            /**< The number id, or the offset of the string 
+                             * id, or IMAGE_NONE */
+    uint32_t ptext_length;  /**< Length of the search string */
+    uint32_t rtext_length;  /**< Length of the replace string */
+    uint32_t id_type;       /**< Type of the id */
+    uint32_t reserved;
+};
+
+/**
+ * The image of a finalized trie
+ *
+ * All the arrays of a finalized trie refer to each other by indices, so 
+ * its arena, DFA table and minimized tails are written as they are, each 
+ * into a section of its own, and are used in place when the image is 
+ * loaded; loading a trie does not visit its states. Only the patterns have
+ * pointers: they are written as offsets in the strings section, and turned
+ * into a matched array of their own by the loader.
+ *
+ * The image is mapped read-only, so the processes that load the same file 
+ * share its pages through the page cache; it can also be kept in a named
+ * shared memory object, which the processes attach to. Every section is aligned to a 
+ * page and has a checksum; the header has its own. The image is portable 
+ * between the builds of the same version of the library on machines of the
+ * same byte order and word size.
+ */
+typedef struct act_image
+{
+    void *base;     /**< The image */
+    size_t size;    /**< Size of the image */
+    int mapped;     /**< How the image is read; see pages_map_file() */
+
+} ACT_IMAGE_t;
+
+/*
+ * Image interface functions
+ */
+
+ACT_IMAGE_t *image_open (const char *path);
+ACT_IMAGE_t *image_open_shared (const char *name);
+void image_close (ACT_IMAGE_t *thiz);
+int  image_save (const struct ac_trie *trie, FILE *file);
+int  image_share (const struct ac_trie *trie, const char *name);
+int  image_load (struct ac_trie *trie, const ACT_IMAGE_t *image, int verify);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
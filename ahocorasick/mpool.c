@@ -157,6 +157,8 @@ void *mpool_malloc (struct mpool *pool, size_t size)
 /**
  * @brief Makes a copy of a string with known size
  * 
+ * The string may contain zero bytes; all the @p n bytes are copied.
+ * 
  * @param pool
  * @param str
  * @param n
@@ -171,7 +173,7 @@ void *mpool_strndup (struct mpool *pool, const char *str, size_t n)
     
     if ((ret = mpool_malloc(pool, n+1)))
     {
-        strncpy((char *)ret, str, n);
+        memcpy(ret, str, n);
         ((char *)ret)[n] = '\0';
     }
     
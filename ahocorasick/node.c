@@ -32,8 +32,13 @@ static int  node_edge_compare (const void *l, const void *r);
 static int  node_has_pattern (ACT_NODE_t *thiz, AC_PATTERN_t *patt);
 static void node_grow_outgoing_vector (ACT_NODE_t *thiz);
 static void node_grow_matched_vector (ACT_NODE_t *thiz);
+static size_t node_count_patterns (ACT_NODE_t *thiz);
+static void node_collect_tails (ACT_NODE_t *thiz, AC_PATTERN_t *tails, 
+        size_t *size);
+static void node_walk_push (ACT_NODE_WALK_t *thiz, ACT_NODE_t *nod);
 static void node_copy_pattern (ACT_NODE_t *thiz, 
         AC_PATTERN_t *to, AC_PATTERN_t *from);
+static void node_release_branch (ACT_NODE_t *thiz);
 
 /**
  * @brief Creates the node
@@ -44,7 +49,7 @@ struct act_node * node_create (struct ac_trie *trie)
 {
     ACT_NODE_t *node;
     
-    node = (ACT_NODE_t *) mpool_malloc (trie->mp, sizeof(ACT_NODE_t));
+    node = (ACT_NODE_t *) mpool_malloc (trie->nodes_mp, sizeof(ACT_NODE_t));
     node_init (node);
     node->trie = trie;
     
@@ -62,7 +67,9 @@ static void node_init (ACT_NODE_t *thiz)
     
     thiz->final = 0;
     thiz->failure_node = NULL;
+    thiz->output_node = NULL;
     thiz->depth = 0;
+    thiz->state = 0;
     
     thiz->matched = NULL;
     thiz->matched_capacity = 0;
@@ -73,6 +80,10 @@ static void node_init (ACT_NODE_t *thiz)
     thiz->outgoing_size = 0;
     
     thiz->to_be_replaced = NULL;
+    
+    thiz->tails = NULL;
+    thiz->tails_size = 0;
+    thiz->tails_root = 0;
 }
 
 /**
@@ -84,6 +95,7 @@ void node_release_vectors(ACT_NODE_t *nod)
 {
     free(nod->matched);
     free(nod->outgoing);
+    free(nod->tails);
 }
 
 /**
@@ -336,22 +348,26 @@ void node_sort_edges (ACT_NODE_t *nod)
 int node_book_replacement (ACT_NODE_t *nod)
 {
     size_t j;
+    ACT_NODE_t *n;
     AC_PATTERN_t *pattern;
     AC_PATTERN_t *longest = NULL;
     
     if(!nod->final)
         return 0;
 
-    for (j=0; j < nod->matched_size; j++)
+    for (n = nod; n; n = n->output_node)
     {
-        pattern = &nod->matched[j];
-        
-        if (pattern->rtext.astring != NULL)
+        for (j=0; j < n->matched_size; j++)
         {
-            if (!longest)
-                longest = pattern;
-            else if (pattern->ptext.length > longest->ptext.length)
-                longest = pattern;
+            pattern = &n->matched[j];
+            
+            if (pattern->rtext.astring != NULL)
+            {
+                if (!longest)
+                    longest = pattern;
+                else if (pattern->ptext.length > longest->ptext.length)
+                    longest = pattern;
+            }
         }
     }
     
@@ -360,6 +376,138 @@ int node_book_replacement (ACT_NODE_t *nod)
     return longest ? 1 : 0;
 }
 
+/**
+ * @brief Cuts off the edge of the alpha and the branch below it
+ * 
+ * The nodes of the branch must not have any pattern; their vectors are
+ * released, and their memories go with the node pool of the trie. The 
+ * other edges keep their order.
+ * 
+ * @param nod
+ * @param alpha
+ *****************************************************************************/
+void node_cut_edge (ACT_NODE_t *nod, AC_ALPHABET_t alpha)
+{
+    size_t i;
+    
+    for (i = 0; i < nod->outgoing_size; i++)
+    {
+        if (nod->outgoing[i].alpha == alpha)
+        {
+            node_release_branch (nod->outgoing[i].next);
+            memmove (&nod->outgoing[i], &nod->outgoing[i + 1], 
+                    (--nod->outgoing_size - i) * sizeof(struct act_edge));
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Releases the vectors of the node and the nodes below it
+ * 
+ * @param thiz
+ *****************************************************************************/
+static void node_release_branch (ACT_NODE_t *thiz)
+{
+    ACT_NODE_WALK_t walk;
+    ACT_NODE_t *nod;
+    int leaving;
+    
+    node_walk_init (&walk, thiz);
+    
+    while ((nod = node_walk_next (&walk, &leaving)))
+        if (leaving)
+            node_release_vectors (nod);
+    
+    node_walk_release (&walk);
+}
+
+/**
+ * @brief Cuts off the sub-trie of the node
+ * 
+ * The patterns of the nodes below are moved to the tails of the node, in
+ * the pre-order of the edges, and the nodes below are released. The node 
+ * keeps its own patterns.
+ * 
+ * @param nod
+ *****************************************************************************/
+void node_cut_tails (ACT_NODE_t *nod)
+{
+    size_t i, count = node_count_patterns (nod) - nod->matched_size;
+    
+    if (!count)
+        return;
+    
+    nod->tails = (AC_PATTERN_t *) malloc (count * sizeof(AC_PATTERN_t));
+    
+    for (i = 0; i < nod->outgoing_size; i++)
+        node_collect_tails (nod->outgoing[i].next, nod->tails, 
+                &nod->tails_size);
+    
+    free (nod->outgoing);
+    nod->outgoing = NULL;
+    nod->outgoing_capacity = 0;
+    nod->outgoing_size = 0;
+}
+
+/**
+ * @brief Counts the patterns of the node and the nodes below it
+ * 
+ * @param thiz
+ * @return
+ *****************************************************************************/
+static size_t node_count_patterns (ACT_NODE_t *thiz)
+{
+    ACT_NODE_WALK_t walk;
+    ACT_NODE_t *nod;
+    size_t count = 0;
+    int leaving;
+    
+    node_walk_init (&walk, thiz);
+    
+    while ((nod = node_walk_next (&walk, &leaving)))
+        if (!leaving)
+            count += nod->matched_size;
+    
+    node_walk_release (&walk);
+    
+    return count;
+}
+
+/**
+ * @brief Moves the patterns of the node and the nodes below it to the tails 
+ * array, and releases the vectors of those nodes
+ * 
+ * @param thiz
+ * @param tails
+ * @param size
+ *****************************************************************************/
+static void node_collect_tails (ACT_NODE_t *thiz, AC_PATTERN_t *tails, 
+        size_t *size)
+{
+    ACT_NODE_WALK_t walk;
+    ACT_NODE_t *nod;
+    int leaving;
+    
+    node_walk_init (&walk, thiz);
+    
+    while ((nod = node_walk_next (&walk, &leaving)))
+    {
+        if (leaving)
+        {
+            node_release_vectors (nod);
+            continue;
+        }
+        
+        if (nod->matched_size)
+            memcpy (&tails[*size], nod->matched, 
+                    nod->matched_size * sizeof(AC_PATTERN_t));
+        *size += nod->matched_size;
+    }
+    
+    node_walk_release (&walk);
+}
+
 /**
  * @brief Grows the size of outgoing edges vector
  * 
@@ -413,30 +561,24 @@ static void node_grow_matched_vector (ACT_NODE_t *thiz)
 }
 
 /**
- * @brief Collect accepted patterns of the node.
+ * @brief Links the node to the nearest node on its failure chain that 
+ * accepts a pattern.
  * 
- * The accepted patterns consist of the node's own accepted pattern plus 
- * accepted patterns of its failure node.
+ * The accepted patterns of a node consist of the node's own accepted 
+ * patterns plus the accepted patterns of the nodes on its output chain. They
+ * are not copied into the node; the chain is walked when reporting. The 
+ * failure node must be linked already.
  * 
  * @param node
  *****************************************************************************/
-void node_collect_matches (ACT_NODE_t *nod)
+void node_link_outputs (ACT_NODE_t *nod)
 {
-    size_t i;
-    ACT_NODE_t *n = nod;
+    ACT_NODE_t *fail = nod->failure_node;
     
-    while ((n = n->failure_node))
-    {
-        for (i = 0; i < n->matched_size; i++)
-            /* Always call with copy parameter 0 */
-            node_accept_pattern (nod, &(n->matched[i]), 0);
-        
-        if (n->final)
-            nod->final = 1;
-    }
+    nod->output_node = fail->matched_size ? fail : fail->output_node;
     
-    node_sort_edges (nod);
-    /* Sort matched patterns? Is that necessary? I don't think so. */
+    if (nod->output_node)
+        nod->final = 1;
 }
 
 /**
@@ -492,3 +634,96 @@ void node_display (ACT_NODE_t *nod)
     }
     printf("\n");
 }
+
+/**
+ * @brief Starts a depth-first walk of the node and the nodes below it
+ * 
+ * The walk keeps the path from the top node in a stack of its own, so the 
+ * depth of the trie is not bounded by the call stack. 
+ * 
+ * @param thiz
+ * @param top
+ *****************************************************************************/
+void node_walk_init (ACT_NODE_WALK_t *thiz, ACT_NODE_t *top)
+{
+    thiz->stack = NULL;
+    thiz->size = 0;
+    thiz->capacity = 0;
+    
+    node_walk_push (thiz, top);
+    thiz->stack[0].edge = (size_t)-1;
+}
+
+/**
+ * @brief Gives the next node of the walk
+ * 
+ * Every node is given twice: once on entering it, before the nodes below it,
+ * and once on leaving it, after them. The edges are taken in their order. 
+ * On entering, the node may still change its edges, e.g. sort or cut them. 
+ * On leaving, the node is already off the path, and its step is kept in 
+ * thiz->stack[thiz->size]; the step of its parent, if any, is on the top.
+ * 
+ * @param thiz
+ * @param leaving Set to 1 if the node is being left, 0 otherwise
+ * @return The node, or NULL when the walk is over
+ *****************************************************************************/
+ACT_NODE_t *node_walk_next (ACT_NODE_WALK_t *thiz, int *leaving)
+{
+    struct act_node_step *top;
+    
+    if (!thiz->size)
+        return NULL;
+    
+    top = &thiz->stack[thiz->size - 1];
+    
+    if (top->edge == (size_t)-1)
+    {
+        /* The top node itself has not been given yet */
+        top->edge = 0;
+        *leaving = 0;
+        return top->node;
+    }
+    
+    if (top->edge < top->node->outgoing_size)
+    {
+        node_walk_push (thiz, top->node->outgoing[top->edge++].next);
+        *leaving = 0;
+        return thiz->stack[thiz->size - 1].node;
+    }
+    
+    thiz->size--;
+    *leaving = 1;
+    return top->node;
+}
+
+/**
+ * @brief Releases the stack of the walk
+ * 
+ * @param thiz
+ *****************************************************************************/
+void node_walk_release (ACT_NODE_WALK_t *thiz)
+{
+    free (thiz->stack);
+    thiz->stack = NULL;
+    thiz->size = thiz->capacity = 0;
+}
+
+/**
+ * @brief Pushes the node on the path of the walk
+ * 
+ * @param thiz
+ * @param nod
+ *****************************************************************************/
+static void node_walk_push (ACT_NODE_WALK_t *thiz, ACT_NODE_t *nod)
+{
+    if (thiz->size == thiz->capacity)
+    {
+        thiz->capacity = thiz->capacity ? 2 * thiz->capacity : 16;
+        thiz->stack = (struct act_node_step *) realloc (thiz->stack, 
+                thiz->capacity * sizeof(struct act_node_step));
+    }
+    
+    thiz->stack[thiz->size].node = nod;
+    thiz->stack[thiz->size].edge = 0;
+    thiz->stack[thiz->size++].mark = 0;
+}
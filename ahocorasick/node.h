@@ -40,7 +40,10 @@ typedef struct act_node
     
     int final;      /**< A final node accepts pattern; 0: not, 1: is final */
     size_t depth;   /**< Distance between this node and the root */
+    ACT_STATE_t state;  /**< State number in the finalized trie */
     struct act_node *failure_node;  /**< The failure transition node */
+    struct act_node *output_node;   /**< The nearest node on the failure 
+                                     * chain that accepts a pattern */
     
     struct act_edge *outgoing;  /**< Outgoing edges array */
     size_t outgoing_capacity;   /**< Max capacity of outgoing edges */
@@ -53,6 +56,12 @@ typedef struct act_node
     AC_PATTERN_t *to_be_replaced;   /**< Pointer to the pattern that must be 
                                      * replaced */
     
+    AC_PATTERN_t *tails;    /**< The patterns that were cut off below this 
+                             * node by truncating the trie */
+    size_t tails_size;      /**< Number of the tail patterns */
+    uint32_t tails_root;    /**< The state of the tails in the minimized 
+                             * graph; see dawg_add() */
+    
     struct ac_trie *trie;    /**< The trie that this node belongs to */
     
 } ACT_NODE_t;
@@ -66,6 +75,23 @@ struct act_edge
     ACT_NODE_t *next;       /**< Target of the edge */
 };
 
+/**
+ * Depth-first walk of a node and the nodes below it, without recursion; 
+ * see node_walk_next()
+ */
+typedef struct act_node_walk
+{
+    struct act_node_step
+    {
+        ACT_NODE_t *node;   /**< A node on the path */
+        size_t edge;        /**< The next edge of the node to take */
+        size_t mark;        /**< Free for the user of the walk */
+    } *stack;               /**< The path from the top node */
+    size_t size;            /**< Number of the nodes on the path */
+    size_t capacity;        /**< Max capacity of the stack */
+    
+} ACT_NODE_WALK_t;
+
 /*
  * Node interface functions
  */
@@ -79,11 +105,17 @@ void node_assign_id (ACT_NODE_t *nod);
 void node_add_edge (ACT_NODE_t *nod, ACT_NODE_t *next, AC_ALPHABET_t alpha);
 void node_sort_edges (ACT_NODE_t *nod);
 void node_accept_pattern (ACT_NODE_t *nod, AC_PATTERN_t *new_patt, int copy);
-void node_collect_matches (ACT_NODE_t *nod);
+void node_link_outputs (ACT_NODE_t *nod);
 void node_release_vectors (ACT_NODE_t *nod);
 int  node_book_replacement (ACT_NODE_t *nod);
+void node_cut_tails (ACT_NODE_t *nod);
+void node_cut_edge (ACT_NODE_t *nod, AC_ALPHABET_t alpha);
 void node_display (ACT_NODE_t *nod);
 
+void node_walk_init (ACT_NODE_WALK_t *thiz, ACT_NODE_t *top);
+ACT_NODE_t *node_walk_next (ACT_NODE_WALK_t *thiz, int *leaving);
+void node_walk_release (ACT_NODE_WALK_t *thiz);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,381 @@
+/*
+ * pages.c: Allocates the memory blocks of the search structures
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE /* MAP_ANONYMOUS and madvise() */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pages.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PAGES_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Rounds the size up to a multiple of the huge page size
+ */
+#define PAGES_ROUND(size) \
+    (((size) + PAGES_HUGE_SIZE - 1) & ~(size_t)(PAGES_HUGE_SIZE - 1))
+
+/* Privates */
+#ifdef PAGES_MMAP
+static void *pages_map_aligned (size_t size);
+static void *pages_map_fd (int fd, size_t *size);
+#endif
+
+
+/**
+ * @brief Allocates a memory block
+ *
+ * If @p huge is set, the block is mapped on explicit huge pages if the 
+ * system has reserved some, otherwise on a 2MB aligned region that is 
+ * advised to be backed by transparent huge pages. If mapping is not 
+ * possible, the block is allocated by malloc.
+ *
+ * @param size
+ * @param huge
+ * @param mapped is set to PAGES_MAPPED if the block is mapped, 
+ * PAGES_MALLOC if it is malloc'ed
+ * @return The block, or NULL if there is no memory
+ *****************************************************************************/
+void *pages_alloc (size_t size, int huge, int *mapped)
+{
+#ifdef PAGES_MMAP
+    void *block;
+    size_t rounded = PAGES_ROUND(size);
+
+    if (huge && size)
+    {
+#ifdef MAP_HUGETLB
+        block = mmap (NULL, rounded, PROT_READ | PROT_WRITE, 
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (block != MAP_FAILED)
+        {
+            *mapped = PAGES_MAPPED;
+            return block;
+        }
+#endif
+        block = pages_map_aligned (rounded);
+        if (block)
+        {
+#ifdef MADV_HUGEPAGE
+            madvise (block, rounded, MADV_HUGEPAGE);
+#endif
+            *mapped = PAGES_MAPPED;
+            return block;
+        }
+    }
+#else
+    (void) huge;
+#endif
+
+    *mapped = PAGES_MALLOC;
+    return malloc (size);
+}
+
+/**
+ * @brief Releases a block that is allocated by pages_alloc()
+ *
+ * @param block
+ * @param size the size that was passed to pages_alloc()
+ * @param mapped
+ *****************************************************************************/
+void pages_free (void *block, size_t size, int mapped)
+{
+    if (mapped == PAGES_IMAGE)
+        return;
+
+#ifdef PAGES_MMAP
+    if (mapped == PAGES_MAPPED)
+    {
+        munmap (block, PAGES_ROUND(size));
+        return;
+    }
+#else
+    (void) size;
+    (void) mapped;
+#endif
+
+    free (block);
+}
+
+/**
+ * @brief Brings all the pages of a block into the memory
+ *
+ * Reads a byte of every page, so the page faults are taken now rather than
+ * during the search, and optionally locks the pages in the memory.
+ *
+ * @param block
+ * @param size
+ * @param lock
+ * @return 0 on success, -1 if the pages could not be locked
+ *****************************************************************************/
+int pages_warm (const void *block, size_t size, int lock)
+{
+    const volatile unsigned char *bp = (const volatile unsigned char *) block;
+    size_t i, page_size = 4096;
+
+    if (!block || !size)
+        return 0;
+
+#ifdef PAGES_MMAP
+    page_size = (size_t) sysconf (_SC_PAGESIZE);
+#endif
+
+    for (i = 0; i < size; i += page_size)
+        (void) bp[i];
+    (void) bp[size - 1];
+
+#ifdef PAGES_MMAP
+    if (lock && mlock (block, size))
+        return -1;
+#else
+    if (lock)
+        return -1;
+#endif
+
+    return 0;
+}
+
+/**
+ * @brief Maps a whole file read-only
+ *
+ * The pages are shared with the page cache, so the processes that map the 
+ * same file share its memory, and only the touched pages are read. If 
+ * mapping is not possible, the file is read into a malloc'ed block.
+ *
+ * @param path
+ * @param size is set to the size of the file
+ * @param mapped is set to PAGES_MAPPED or PAGES_MALLOC
+ * @return The block, or NULL if the file can not be read or is empty
+ *****************************************************************************/
+void *pages_map_file (const char *path, size_t *size, int *mapped)
+{
+    void *block;
+    FILE *file;
+    long length;
+
+#ifdef PAGES_MMAP
+    int fd = open (path, O_RDONLY);
+
+    if (fd < 0)
+        return NULL;
+
+    block = pages_map_fd (fd, size);
+    close (fd);
+
+    if (block)
+    {
+        *mapped = PAGES_MAPPED;
+        return block;
+    }
+#endif
+
+    if (!(file = fopen (path, "rb")))
+        return NULL;
+
+    block = NULL;
+    if (fseek (file, 0, SEEK_END) == 0 && (length = ftell (file)) > 0 &&
+            fseek (file, 0, SEEK_SET) == 0 && 
+            (block = malloc ((size_t) length)) && 
+            fread (block, 1, (size_t) length, file) != (size_t) length)
+    {
+        free (block);
+        block = NULL;
+    }
+    fclose (file);
+
+    *size = block ? (size_t) length : 0;
+    *mapped = PAGES_MALLOC;
+    return block;
+}
+
+/**
+ * @brief Releases a block of pages_map_file()
+ *
+ * @param block
+ * @param size
+ * @param mapped
+ *****************************************************************************/
+void pages_unmap_file (void *block, size_t size, int mapped)
+{
+#ifdef PAGES_MMAP
+    if (mapped == PAGES_MAPPED)
+    {
+        munmap (block, size);
+        return;
+    }
+#else
+    (void) size;
+    (void) mapped;
+#endif
+
+    free (block);
+}
+
+/**
+ * @brief Creates a named shared memory object and maps it for writing
+ *
+ * An object of the same name is replaced; the processes that have mapped
+ * it keep their pages.
+ *
+ * @param name the name of the object, as shm_open() takes it: "/name"
+ * @param size size of the object
+ * @return The mapped object, or NULL if it can not be created or the
+ * system has no shared memory. It must be unmapped by pages_unmap_file()
+ * with PAGES_MAPPED.
+ *****************************************************************************/
+void *pages_create_shared (const char *name, size_t size)
+{
+#ifdef PAGES_MMAP
+    void *block = MAP_FAILED;
+    int fd;
+
+    /* A new object, so the old one is not changed under its readers */
+    shm_unlink (name);
+    if ((fd = shm_open (name, O_RDWR | O_CREAT | O_EXCL, 0644)) < 0)
+        return NULL;
+
+    if (ftruncate (fd, (off_t) size) == 0)
+        block = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+
+    if (block == MAP_FAILED)
+    {
+        shm_unlink (name);
+        return NULL;
+    }
+
+    return block;
+#else
+    (void) name;
+    (void) size;
+    return NULL;
+#endif
+}
+
+/**
+ * @brief Maps a whole named shared memory object read-only
+ *
+ * @param name
+ * @param size is set to the size of the object
+ * @param mapped is set to PAGES_MAPPED
+ * @return The mapped object, or NULL if it can not be mapped. It must be 
+ * unmapped by pages_unmap_file().
+ *****************************************************************************/
+void *pages_map_shared (const char *name, size_t *size, int *mapped)
+{
+#ifdef PAGES_MMAP
+    void *block;
+    int fd;
+
+    if ((fd = shm_open (name, O_RDONLY, 0)) < 0)
+        return NULL;
+
+    block = pages_map_fd (fd, size);
+    close (fd);
+
+    *mapped = PAGES_MAPPED;
+    return block;
+#else
+    (void) name;
+    (void) size;
+    (void) mapped;
+    return NULL;
+#endif
+}
+
+/**
+ * @brief Removes the name of a shared memory object; the object is freed
+ * when the last process unmaps it
+ *
+ * @param name
+ * @return 0 on success, -1 otherwise
+ *****************************************************************************/
+int pages_unlink_shared (const char *name)
+{
+#ifdef PAGES_MMAP
+    return shm_unlink (name) ? -1 : 0;
+#else
+    (void) name;
+    return -1;
+#endif
+}
+
+#ifdef PAGES_MMAP
+/**
+ * @brief Maps a whole file read-only
+ *
+ * @param fd the open file
+ * @param size is set to the size of the file
+ * @return The mapped file, or NULL if it can not be mapped or is empty
+ *****************************************************************************/
+static void *pages_map_fd (int fd, size_t *size)
+{
+    struct stat st;
+    void *block;
+
+    if (fstat (fd, &st) || st.st_size <= 0)
+        return NULL;
+
+    block = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (block == MAP_FAILED)
+        return NULL;
+
+    *size = (size_t) st.st_size;
+    return block;
+}
+
+/**
+ * @brief Maps a region that is aligned to the huge page size
+ *
+ * @param size a multiple of PAGES_HUGE_SIZE
+ * @return The region, or NULL
+ *****************************************************************************/
+static void *pages_map_aligned (size_t size)
+{
+    unsigned char *region, *aligned;
+    size_t head, tail;
+
+    /* Map a bigger region and trim it to the alignment */
+    region = (unsigned char *) mmap (NULL, size + PAGES_HUGE_SIZE, 
+            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (region == (unsigned char *) MAP_FAILED)
+        return NULL;
+
+    aligned = (unsigned char *) PAGES_ROUND((size_t) region);
+    head = aligned - region;
+    tail = PAGES_HUGE_SIZE - head;
+
+    if (head)
+        munmap (region, head);
+    if (tail)
+        munmap (aligned + size, tail);
+
+    return aligned;
+}
+#endif
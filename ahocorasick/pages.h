@@ -0,0 +1,64 @@
+/*
+ * pages.h: Allocates the memory blocks of the search structures
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _PAGES_H_
+#define _PAGES_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Size of a huge page; the mapped blocks are rounded up to this size and
+ * aligned to it, so the kernel can back them by transparent huge pages.
+ */
+#define PAGES_HUGE_SIZE (2 * 1024 * 1024)
+
+/**
+ * How a block is allocated
+ */
+#define PAGES_MALLOC 0  /**< By malloc */
+#define PAGES_MAPPED 1  /**< Mapped, on huge pages if possible */
+#define PAGES_IMAGE  2  /**< A part of a loaded image; it is released with
+                         * the image, and pages_free() leaves it alone */
+
+/*
+ * The search structures of a finalized trie (the arena and the DFA) keep 
+ * all their arrays in a single memory block. By default the block comes 
+ * from malloc. On request, it is mapped on huge pages instead: a large 
+ * automaton then needs a few TLB entries rather than thousands. 
+ */
+
+void *pages_alloc (size_t size, int huge, int *mapped);
+void pages_free (void *block, size_t size, int mapped);
+int  pages_warm (const void *block, size_t size, int lock);
+void *pages_map_file (const char *path, size_t *size, int *mapped);
+void pages_unmap_file (void *block, size_t size, int mapped);
+void *pages_create_shared (const char *name, size_t size);
+void *pages_map_shared (const char *name, size_t *size, int *mapped);
+int  pages_unlink_shared (const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
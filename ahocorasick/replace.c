@@ -22,6 +22,9 @@
 #include <string.h>
 
 #include "node.h"
+#include "arena.h"
+#include "dfa.h"
+#include "skip.h"
 #include "ahocorasick.h"
 
 
@@ -54,6 +57,9 @@ static void mf_repdata_flush
 static unsigned int mf_repdata_bookreplacements 
     (ACT_NODE_t *node);
 
+static AC_PATTERN_t *mf_repdata_nominee_pattern 
+    (const ACT_ARENA_t *arena, ACT_STATE_t state);
+
 /* Publics */
 
 void mf_repdata_init (AC_TRIE_t *trie);
@@ -83,6 +89,8 @@ void mf_repdata_init (AC_TRIE_t *trie)
     rd->noms_size = 0;
     
     rd->replace_mode = MF_REPLACE_MODE_DEFAULT;
+    rd->cbf = NULL;
+    rd->user = NULL;
     rd->trie = trie;
 }
 
@@ -94,8 +102,10 @@ void mf_repdata_init (AC_TRIE_t *trie)
  *****************************************************************************/
 void mf_repdata_allocbuf (MF_REPLACEMENT_DATA_t *rd)
 {    
-    /* Bookmark replacement pattern for faster retrieval */
-    rd->has_replacement = mf_repdata_bookreplacements (rd->trie->root);
+    /* Bookmark replacement pattern for faster retrieval; a loaded trie 
+     * has no nodes, and its count comes from the image */
+    if (rd->trie->root)
+        rd->has_replacement = mf_repdata_bookreplacements (rd->trie->root);
     
     if (rd->has_replacement)
     {
@@ -117,20 +127,37 @@ void mf_repdata_allocbuf (MF_REPLACEMENT_DATA_t *rd)
  *****************************************************************************/
 static unsigned int mf_repdata_bookreplacements (ACT_NODE_t *node)
 {
-    size_t i;
-    unsigned int ret;
+    ACT_NODE_WALK_t walk;
+    ACT_NODE_t *nod;
+    unsigned int ret = 0;
+    int leaving;
     
-    ret = node_book_replacement (node);
+    node_walk_init (&walk, node);
     
-    for (i = 0; i < node->outgoing_size; i++)
-    {
-        /* Recursively call itself to traverse all nodes */
-        ret += mf_repdata_bookreplacements (node->outgoing[i].next);
-    }
+    while ((nod = node_walk_next (&walk, &leaving)))
+        if (!leaving)
+            ret += node_book_replacement (nod);
+    
+    node_walk_release (&walk);
     
     return ret;
 }
 
+/**
+ * @brief Gives the to-be-replaced pattern of a final state
+ * 
+ * @param arena
+ * @param state
+ * @return The pattern, or NULL if the state has no to-be-replaced pattern
+ *****************************************************************************/
+static AC_PATTERN_t *mf_repdata_nominee_pattern 
+    (const ACT_ARENA_t *arena, ACT_STATE_t state)
+{
+    uint32_t index = arena->infos[state].to_be_replaced;
+    
+    return (index != ARENA_NONE) ? &arena->matched[index] : NULL;
+}
+
 /**
  * @brief Resets the replacement data and prepares it for a new operation
  * 
@@ -434,7 +461,7 @@ static void mf_repdata_do_replace
         /* Shift the array to the left to eliminate the consumed nominees */
         if (rd->noms_size && index)
         {
-            memcpy (&rd->noms[0], &rd->noms[index], 
+            memmove (&rd->noms[0], &rd->noms[index], 
                     rd->noms_size * sizeof(struct mf_replacement_nominee));
             /* TODO: implement a circular queue */
         }
@@ -469,15 +496,21 @@ static void mf_repdata_do_replace
 int multifast_replace (AC_TRIE_t *thiz, AC_TEXT_t *instr, 
         MF_REPLACE_MODE_t mode, MF_REPLACE_CALBACK_f callback, void *param)
 {
-    ACT_NODE_t *current;
-    ACT_NODE_t *next;
+    ACT_STATE_t current;
+    ACT_STATE_t next;
+    const ACT_ARENA_t *arena = thiz->arena;
+    ACT_DFA_t *dfa = thiz->dfa;
+    const ACT_SKIP_t *skip = thiz->skip;
+    const AC_ALPHABET_t *astring = instr->astring;
+    const AC_ALPHABET_t *end = astring + instr->length;
+    uint32_t state;
     struct mf_replacement_nominee nom;
     MF_REPLACEMENT_DATA_t *rd = &thiz->repdata;
     
     size_t position_r = 0;  /* Relative current position in the input string */
     size_t backlog_pos = 0; /* Relative backlog position in the input string */
     
-    if (thiz->trie_open)
+    if (thiz->trie_open || thiz->wide)
         return -1; /* _finalize() must be called first */
     
     if (!rd->has_replacement)
@@ -490,31 +523,71 @@ int multifast_replace (AC_TRIE_t *thiz, AC_TEXT_t *instr,
     thiz->text = instr; /* Save the input string in a helper variable 
                          * for convenience */
     
-    current = thiz->last_node;
+    current = thiz->last_state;
+    
+    if (dfa)
+    {
+        /* The same loop as below, but using the DFA transition table */
+        state = current;
+        
+        while (position_r < instr->length)
+        {
+            if (state == ARENA_ROOT && skip)
+            {
+                position_r = SKIP_SCAN(skip, &astring[position_r], end) - 
+                        astring;
+                if (position_r == instr->length)
+                    break;
+            }
+            
+            state = dfa->delta[DFA_INDEX(dfa, state, 
+                    ARENA_CLASS(arena, instr->astring[position_r++]))];
+            
+            if (state & DFA_MATCH_FLAG)
+            {
+                nom.pattern = mf_repdata_nominee_pattern 
+                        (arena, state & DFA_STATE_MASK);
+                nom.position = thiz->base_position + position_r;
+                
+                mf_repdata_booknominee (rd, &nom);
+            }
+        }
+        current = state & DFA_STATE_MASK;
+    }
     
     /* Main replace loop: 
      * Find patterns and bookmark them 
      */
     while (position_r < instr->length)
     {
-        if (!(next = node_find_next_bs(current, instr->astring[position_r])))
+        if (current == ARENA_ROOT && skip)
+        {
+            /* Jump to the next alphabet that starts a pattern */
+            position_r = SKIP_SCAN(skip, &astring[position_r], end) - astring;
+            if (position_r == instr->length)
+                break;
+        }
+        
+        next = arena_find_next (arena, current, 
+                ARENA_CLASS(arena, instr->astring[position_r]));
+        
+        if (next == ARENA_NONE)
         {
             /* Failed to follow a pattern */
-            if(current->failure_node)
-                current = current->failure_node;
+            if (current != ARENA_ROOT)
+                current = ARENA_FAILURE(arena, current);
             else
                 position_r++;
-        }
-        else
-        {
-            current = next;
-            position_r++;
+            continue;
         }
         
-        if (current->final && next)
+        current = next;
+        position_r++;
+        
+        if (ARENA_IS_FINAL(arena, current))
         {
             /* Bookmark nominee patterns for replacement */
-            nom.pattern = current->to_be_replaced;
+            nom.pattern = mf_repdata_nominee_pattern (arena, current);
             nom.position = thiz->base_position + position_r;
             
             mf_repdata_booknominee (rd, &nom);
@@ -526,7 +599,8 @@ int multifast_replace (AC_TRIE_t *thiz, AC_TEXT_t *instr,
      * pattern, then we must keep it in the backlog buffer and wait for the 
      * next chunk to decide about it. */
     
-    backlog_pos = thiz->base_position + instr->length - current->depth;
+    backlog_pos = thiz->base_position + instr->length - 
+            arena_depth (arena, current);
     
     /* Now replace the patterns up to the backlog_pos point */
     mf_repdata_do_replace (rd, backlog_pos);
@@ -535,7 +609,7 @@ int multifast_replace (AC_TRIE_t *thiz, AC_TEXT_t *instr,
     mf_repdata_savetobacklog (rd, backlog_pos);
     
     /* Save status variables */
-    thiz->last_node = current;
+    thiz->last_state = current;
     thiz->base_position += position_r;
     
     return 0;
@@ -552,6 +626,9 @@ int multifast_replace (AC_TRIE_t *thiz, AC_TEXT_t *instr,
  *****************************************************************************/
 void multifast_rep_flush (AC_TRIE_t *thiz, int keep)
 {
+    if (!thiz->repdata.cbf)
+        return; /* multifast_replace() has not been called successfully */
+    
     if (!keep)
     {
         mf_repdata_do_replace (&thiz->repdata, thiz->base_position);
@@ -562,7 +639,7 @@ void multifast_rep_flush (AC_TRIE_t *thiz, int keep)
     if (!keep)
     {
         mf_repdata_reset (&thiz->repdata);
-        thiz->last_node = thiz->root;
+        thiz->last_state = ARENA_ROOT;
         thiz->base_position = 0;
     }
 }
@@ -0,0 +1,912 @@
+/*
+ * skip.c: Root-state skip scanner of a finalized trie
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "skip.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+        defined(__SSE2__)
+#define SKIP_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * The bytes that the byte map of the trie folds together
+ */
+struct skip_fold
+{
+    unsigned char map[ARENA_ALPHABET_SIZE];     /**< The byte map */
+    unsigned char bytes[ARENA_ALPHABET_SIZE];   /**< The bytes, sorted by 
+                                                 * what they are mapped to */
+    unsigned short start[ARENA_ALPHABET_SIZE + 1];  /**< Where the bytes of
+                                                     * every mapped byte 
+                                                     * start */
+};
+
+/**
+ * Loops over the bytes that are folded together with the given byte
+ */
+#define SKIP_FOLD_FOR(fold, i, alpha) \
+    for ((i) = (fold)->start[(fold)->map[(unsigned char)(alpha)]]; \
+            (i) < (fold)->start[(fold)->map[(unsigned char)(alpha)] + 1]; \
+            (i)++)
+
+/* Privates */
+static void skip_make_masks (ACT_SKIP_t *thiz);
+static SKIP_SCAN_f skip_choose_scan (const ACT_SKIP_t *thiz);
+static void skip_make_fold (struct skip_fold *fold, const unsigned char *map);
+static int  skip_make_teddy (ACT_SKIP_t *thiz, const ACT_ARENA_t *arena,
+        const struct skip_fold *fold);
+static int  skip_make_shifts (ACT_SKIP_t *thiz, const ACT_ARENA_t *arena, 
+        const struct skip_fold *fold, size_t min_length);
+static int  skip_make_memmem (ACT_SKIP_t *thiz, const ACT_ARENA_t *arena,
+        const struct skip_fold *fold);
+static int  skip_compare_prefix (const void *l, const void *r);
+
+static const AC_ALPHABET_t *skip_scan_memchr (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end);
+static const AC_ALPHABET_t *skip_scan_table (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end);
+static const AC_ALPHABET_t *skip_scan_shift (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end);
+static const AC_ALPHABET_t *skip_scan_memmem_tail (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end);
+
+#ifdef SKIP_X86
+static const AC_ALPHABET_t *skip_scan_teddy_tail (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end);
+static const AC_ALPHABET_t *skip_scan_bytes_sse2 (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end);
+static const AC_ALPHABET_t *skip_scan_nibbles_ssse3 (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end);
+static const AC_ALPHABET_t *skip_scan_nibbles_avx2 (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end);
+static const AC_ALPHABET_t *skip_scan_teddy_ssse3 (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end);
+static const AC_ALPHABET_t *skip_scan_teddy_avx2 (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end);
+static const AC_ALPHABET_t *skip_scan_memmem_sse2 (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end);
+static const AC_ALPHABET_t *skip_scan_memmem_avx2 (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end);
+#endif
+
+
+/**
+ * Makes the block number of the two bytes at the given text
+ */
+#define SKIP_BLOCK(text) \
+    (((size_t)(unsigned char)(text)[0] << 8) | (unsigned char)(text)[1])
+
+/**
+ * @brief Creates the skip scanner of the given arena
+ *
+ * The start bytes come from the classes, so they are folded by the byte map
+ * already; the other prefilters look at the patterns themselves and fold
+ * them through @p map.
+ *
+ * @param arena
+ * @param stats statistics of the patterns
+ * @param map the byte map of the trie, or NULL
+ * @param options OR'ed values of ACT_FINALIZE_OPTION_t
+ * @return The scanner, or NULL if skipping is not worth it
+ *****************************************************************************/
+ACT_SKIP_t *skip_create (const ACT_ARENA_t *arena, 
+        const AC_STATISTICS_t *stats, const unsigned char *map, int options)
+{
+    size_t i, j, min_length = stats->min_length;
+    const struct act_state *root = &arena->states[ARENA_ROOT];
+    unsigned char root_classes[ARENA_ALPHABET_SIZE] = {0};
+    struct skip_fold fold;
+    ACT_SKIP_t *thiz;
+
+    if (root->edges_count == 0 || (options & AC_FINALIZE_NO_PREFILTER))
+        return NULL;
+
+    for (j = 0; j < root->edges_count; j++)
+        root_classes[arena->labels[root->edges + j]] = 1;
+
+    thiz = (ACT_SKIP_t *) malloc (sizeof(ACT_SKIP_t));
+    thiz->bytes_count = 0;
+    thiz->shifts = NULL;
+    thiz->prefixes = NULL;
+
+    for (i = 0; i < ARENA_ALPHABET_SIZE; i++)
+    {
+        thiz->table[i] = root_classes[arena->classes[i]];
+
+        if (thiz->table[i])
+        {
+            if (thiz->bytes_count < sizeof(thiz->bytes))
+                thiz->bytes[thiz->bytes_count] = i;
+            thiz->bytes_count++;
+        }
+    }
+
+    thiz->kind = SKIP_KIND_BYTES;
+    skip_make_fold (&fold, map);
+
+    if ((options & AC_FINALIZE_SHIFT) && 
+            skip_make_shifts (thiz, arena, &fold, min_length))
+        thiz->kind = SKIP_KIND_SHIFT;
+    else if (stats->patterns_count <= SKIP_MEMMEM_MAX_PATTERNS && 
+            skip_make_memmem (thiz, arena, &fold))
+        thiz->kind = SKIP_KIND_MEMMEM;
+    else if (min_length >= SKIP_SHIFT_MIN_LENGTH && 
+            thiz->bytes_count > sizeof(thiz->bytes) && 
+            skip_make_shifts (thiz, arena, &fold, min_length))
+        thiz->kind = SKIP_KIND_SHIFT;
+    else if (thiz->bytes_count > sizeof(thiz->bytes) && 
+            skip_make_teddy (thiz, arena, &fold))
+        thiz->kind = SKIP_KIND_TEDDY;
+    else if (thiz->bytes_count > SKIP_MAX_BYTES)
+    {
+        free (thiz);
+        return NULL;
+    }
+
+    skip_make_masks (thiz);
+    thiz->scan = skip_choose_scan (thiz);
+
+    return thiz;
+}
+
+/**
+ * @brief Makes a copy of a scanner that is read from an image
+ *
+ * The scan function is chosen again, since the image may be made on 
+ * another CPU; the Teddy scanner falls back to the start bytes if the CPU
+ * does not support it.
+ *
+ * @param saved the scanner as it is saved; its pointers are not used
+ * @param shifts the shift table of a shift scanner
+ * @param prefixes the prefix bitmap of a shift scanner
+ * @return The scanner, or NULL if skipping is not worth it on this CPU
+ *****************************************************************************/
+ACT_SKIP_t *skip_restore (const ACT_SKIP_t *saved, const uint8_t *shifts, 
+        const uint8_t *prefixes)
+{
+    ACT_SKIP_t *thiz = (ACT_SKIP_t *) malloc (sizeof(ACT_SKIP_t));
+
+    *thiz = *saved;
+    thiz->shifts = NULL;
+    thiz->prefixes = NULL;
+
+    if (thiz->kind == SKIP_KIND_SHIFT)
+    {
+        thiz->shifts = (uint8_t *) malloc (SKIP_SHIFT_TABLE_SIZE);
+        thiz->prefixes = (uint8_t *) malloc (SKIP_SHIFT_TABLE_SIZE / 8);
+        memcpy (thiz->shifts, shifts, SKIP_SHIFT_TABLE_SIZE);
+        memcpy (thiz->prefixes, prefixes, SKIP_SHIFT_TABLE_SIZE / 8);
+    }
+
+    if (thiz->kind == SKIP_KIND_TEDDY)
+    {
+#ifdef SKIP_X86
+        __builtin_cpu_init ();
+        if (!__builtin_cpu_supports ("ssse3"))
+#endif
+            thiz->kind = SKIP_KIND_BYTES;
+
+        if (thiz->kind == SKIP_KIND_BYTES && 
+                thiz->bytes_count > SKIP_MAX_BYTES)
+        {
+            free (thiz);
+            return NULL;
+        }
+    }
+
+    thiz->scan = skip_choose_scan (thiz);
+
+    return thiz;
+}
+
+/**
+ * @brief Releases the skip scanner
+ *
+ * @param thiz
+ *****************************************************************************/
+void skip_release (ACT_SKIP_t *thiz)
+{
+    if (!thiz)
+        return;
+
+    free (thiz->shifts);
+    free (thiz->prefixes);
+    free (thiz);
+}
+
+/**
+ * @brief Makes the nibble masks of the byte-set lookup
+ *
+ * Every distinct high nibble of the start bytes gets one of the 8 buckets,
+ * and the low nibble mask holds the buckets of the bytes with that low
+ * nibble. A byte is a candidate if its low and high nibble masks share a
+ * bucket. With more than 8 distinct high nibbles, some of them share a
+ * bucket and candidates must be checked against the table.
+ *
+ * @param thiz
+ *****************************************************************************/
+static void skip_make_masks (ACT_SKIP_t *thiz)
+{
+    size_t i;
+    unsigned int bucket = 0;
+    uint8_t bit;
+
+    memset (thiz->lo_masks, 0, sizeof(thiz->lo_masks));
+    memset (thiz->hi_masks, 0, sizeof(thiz->hi_masks));
+
+    for (i = 0; i < ARENA_ALPHABET_SIZE; i++)
+    {
+        if (!thiz->table[i])
+            continue;
+
+        if (!thiz->hi_masks[i >> 4])
+            thiz->hi_masks[i >> 4] = 1 << (bucket++ % 8);
+
+        bit = thiz->hi_masks[i >> 4];
+        thiz->lo_masks[i & 0x0F] |= bit;
+    }
+}
+
+/**
+ * @brief Groups the bytes by what the map makes of them
+ *
+ * @param fold
+ * @param map the byte map, or NULL for none
+ *****************************************************************************/
+static void skip_make_fold (struct skip_fold *fold, const unsigned char *map)
+{
+    size_t i, next[ARENA_ALPHABET_SIZE];
+
+    for (i = 0; i < ARENA_ALPHABET_SIZE; i++)
+        fold->map[i] = map ? map[i] : i;
+
+    memset (fold->start, 0, sizeof(fold->start));
+    for (i = 0; i < ARENA_ALPHABET_SIZE; i++)
+        fold->start[fold->map[i] + 1]++;
+    for (i = 0; i < ARENA_ALPHABET_SIZE; i++)
+        fold->start[i + 1] += fold->start[i];
+
+    for (i = 0; i < ARENA_ALPHABET_SIZE; i++)
+        next[i] = fold->start[i];
+    for (i = 0; i < ARENA_ALPHABET_SIZE; i++)
+        fold->bytes[next[fold->map[i]]++] = i;
+}
+
+/**
+ * @brief Pattern prefix compare function for qsort
+ *****************************************************************************/
+static int skip_compare_prefix (const void *l, const void *r)
+{
+    const AC_PATTERN_t *lp = *(AC_PATTERN_t * const *) l;
+    const AC_PATTERN_t *rp = *(AC_PATTERN_t * const *) r;
+
+    return memcmp (lp->ptext.astring, rp->ptext.astring, 
+            SKIP_TEDDY_MAX_WIDTH < lp->ptext.length && 
+            SKIP_TEDDY_MAX_WIDTH < rp->ptext.length ? SKIP_TEDDY_MAX_WIDTH :
+            (lp->ptext.length < rp->ptext.length ? 
+                lp->ptext.length : rp->ptext.length));
+}
+
+/**
+ * @brief Makes the Teddy fingerprint masks if the pattern set is suitable
+ * and the CPU supports it
+ *
+ * The patterns are sorted by their prefixes and divided into 8 buckets, so
+ * the patterns with similar prefixes share a bucket. Every byte that is
+ * folded together with a pattern byte sets the bits of the pattern too.
+ *
+ * @param thiz
+ * @param arena
+ * @param fold
+ * @return 1 if the masks are made, 0 otherwise
+ *****************************************************************************/
+static int skip_make_teddy (ACT_SKIP_t *thiz, const ACT_ARENA_t *arena,
+        const struct skip_fold *fold)
+{
+    size_t i, j, k, count = arena->matched_count;
+    size_t width = SKIP_TEDDY_MAX_WIDTH;
+    const AC_PATTERN_t **patterns;
+    unsigned char alpha;
+    uint8_t bit;
+
+#ifdef SKIP_X86
+    __builtin_cpu_init ();
+    if (!__builtin_cpu_supports ("ssse3"))
+        return 0;
+#else
+    return 0;
+#endif
+
+    if (count == 0 || count > SKIP_TEDDY_MAX_PATTERNS)
+        return 0;
+
+    for (i = 0; i < count; i++)
+        if (arena->matched[i].ptext.length < width)
+            width = arena->matched[i].ptext.length;
+
+    /* A single byte fingerprint is no better than the start bytes */
+    if (width < 2)
+        return 0;
+
+    patterns = (const AC_PATTERN_t **) malloc (count * sizeof(AC_PATTERN_t *));
+    for (i = 0; i < count; i++)
+        patterns[i] = &arena->matched[i];
+    qsort (patterns, count, sizeof(AC_PATTERN_t *), skip_compare_prefix);
+
+    thiz->teddy_width = width;
+    memset (thiz->teddy_lo, 0, sizeof(thiz->teddy_lo));
+    memset (thiz->teddy_hi, 0, sizeof(thiz->teddy_hi));
+
+    for (i = 0; i < count; i++)
+    {
+        bit = 1 << (i * 8 / count);
+
+        for (k = 0; k < width; k++)
+        {
+            SKIP_FOLD_FOR(fold, j, patterns[i]->ptext.astring[k])
+            {
+                alpha = fold->bytes[j];
+                thiz->teddy_lo[k][alpha & 0x0F] |= bit;
+                thiz->teddy_hi[k][alpha >> 4] |= bit;
+            }
+        }
+    }
+
+    free (patterns);
+
+    return 1;
+}
+
+/**
+ * @brief Takes the first and the last bytes of the patterns for the memmem 
+ * scanner
+ *
+ * The scanner compares single bytes, so a byte that is folded together with
+ * others can not be taken.
+ *
+ * @param thiz
+ * @param arena
+ * @param fold
+ * @return 1 if they are taken, 0 if a pattern is too short to gain anything
+ * or has folded bytes at its ends
+ *****************************************************************************/
+static int skip_make_memmem (ACT_SKIP_t *thiz, const ACT_ARENA_t *arena,
+        const struct skip_fold *fold)
+{
+    size_t i, length;
+    unsigned char first, last;
+
+    thiz->memmem_count = arena->matched_count;
+    thiz->memmem_reach = 0;
+
+    for (i = 0; i < arena->matched_count; i++)
+    {
+        length = arena->matched[i].ptext.length;
+
+        /* The start bytes alone are as good for a single byte pattern */
+        if (length < 2)
+            return 0;
+
+        first = fold->map[(unsigned char) arena->matched[i].ptext.astring[0]];
+        last = fold->map
+                [(unsigned char) arena->matched[i].ptext.astring[length - 1]];
+        if (fold->start[first + 1] - fold->start[first] != 1 || 
+                fold->start[last + 1] - fold->start[last] != 1)
+            return 0;
+
+        thiz->memmem_first[i] = fold->bytes[fold->start[first]];
+        thiz->memmem_last[i] = fold->bytes[fold->start[last]];
+        thiz->memmem_offsets[i] = length - 1;
+
+        if (thiz->memmem_offsets[i] > thiz->memmem_reach)
+            thiz->memmem_reach = thiz->memmem_offsets[i];
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Makes the Wu-Manber shift table
+ *
+ * The shift of a block is the distance between its last occurrence in the
+ * first window-length bytes of any pattern and the end of the window. The
+ * blocks that do not occur there shift the window by its whole length, 
+ * less the block length. A pattern block stands for all the blocks that are
+ * folded together with it.
+ *
+ * @param thiz
+ * @param arena
+ * @param fold
+ * @param min_length length of the shortest pattern
+ * @return 1 if the table is made, 0 if the patterns are too short
+ *****************************************************************************/
+static int skip_make_shifts (ACT_SKIP_t *thiz, const ACT_ARENA_t *arena, 
+        const struct skip_fold *fold, size_t min_length)
+{
+    size_t i, j, x, y, block, window;
+    const AC_ALPHABET_t *ptext;
+
+    if (min_length < SKIP_SHIFT_BLOCK)
+        return 0;
+
+    window = min_length < SKIP_SHIFT_MAX_WINDOW ? 
+            min_length : SKIP_SHIFT_MAX_WINDOW;
+
+    thiz->shift_window = window;
+    thiz->shifts = (uint8_t *) malloc (SKIP_SHIFT_TABLE_SIZE);
+    thiz->prefixes = (uint8_t *) calloc (SKIP_SHIFT_TABLE_SIZE / 8, 1);
+    memset (thiz->shifts, window - SKIP_SHIFT_BLOCK + 1, SKIP_SHIFT_TABLE_SIZE);
+
+    for (i = 0; i < arena->matched_count; i++)
+    {
+        ptext = arena->matched[i].ptext.astring;
+
+        SKIP_FOLD_FOR(fold, x, ptext[0])
+            SKIP_FOLD_FOR(fold, y, ptext[1])
+            {
+                block = ((size_t) fold->bytes[x] << 8) | fold->bytes[y];
+                thiz->prefixes[block >> 3] |= 1 << (block & 7);
+            }
+
+        for (j = SKIP_SHIFT_BLOCK - 1; j < window; j++)
+            SKIP_FOLD_FOR(fold, x, ptext[j - 1])
+                SKIP_FOLD_FOR(fold, y, ptext[j])
+                {
+                    block = ((size_t) fold->bytes[x] << 8) | fold->bytes[y];
+                    if (thiz->shifts[block] > window - 1 - j)
+                        thiz->shifts[block] = window - 1 - j;
+                }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Chooses the scan function from the start bytes and the CPU
+ *
+ * @param thiz
+ * @return
+ *****************************************************************************/
+static SKIP_SCAN_f skip_choose_scan (const ACT_SKIP_t *thiz)
+{
+    if (thiz->kind == SKIP_KIND_SHIFT)
+        return skip_scan_shift;
+
+    if (thiz->kind == SKIP_KIND_MEMMEM)
+    {
+#ifdef SKIP_X86
+        __builtin_cpu_init ();
+        return __builtin_cpu_supports ("avx2") ? 
+                skip_scan_memmem_avx2 : skip_scan_memmem_sse2;
+#else
+        return skip_scan_memmem_tail;
+#endif
+    }
+
+    if (thiz->bytes_count == 1)
+        return skip_scan_memchr;
+
+#ifdef SKIP_X86
+    if (thiz->kind == SKIP_KIND_TEDDY)
+        return __builtin_cpu_supports ("avx2") ? 
+                skip_scan_teddy_avx2 : skip_scan_teddy_ssse3;
+
+    if (thiz->bytes_count <= sizeof(thiz->bytes))
+        return skip_scan_bytes_sse2;
+
+    __builtin_cpu_init ();
+
+    if (__builtin_cpu_supports ("avx2"))
+        return skip_scan_nibbles_avx2;
+
+    if (__builtin_cpu_supports ("ssse3"))
+        return skip_scan_nibbles_ssse3;
+#endif
+
+    return skip_scan_table;
+}
+
+/**
+ * @brief Scans for a single start byte
+ *****************************************************************************/
+static const AC_ALPHABET_t *skip_scan_memchr (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end)
+{
+    const AC_ALPHABET_t *found;
+
+    found = (const AC_ALPHABET_t *) memchr (text, thiz->bytes[0], end - text);
+
+    return found ? found : end;
+}
+
+/**
+ * @brief Scans by looking up every byte in the table
+ *****************************************************************************/
+static const AC_ALPHABET_t *skip_scan_table (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end)
+{
+    const unsigned char *table = thiz->table;
+
+    while (end - text >= 4)
+    {
+        if (table[(unsigned char) text[0]])
+            return text;
+        if (table[(unsigned char) text[1]])
+            return text + 1;
+        if (table[(unsigned char) text[2]])
+            return text + 2;
+        if (table[(unsigned char) text[3]])
+            return text + 3;
+        text += 4;
+    }
+
+    while (text < end && !table[(unsigned char) *text])
+        text++;
+
+    return text;
+}
+
+#ifdef SKIP_X86
+
+/**
+ * @brief Scans the last bytes of the text for a Teddy fingerprint; the bytes
+ * after the end of the text are taken as matching
+ *****************************************************************************/
+static const AC_ALPHABET_t *skip_scan_teddy_tail (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end)
+{
+    size_t k;
+    unsigned char alpha;
+    uint8_t buckets;
+
+    for (; text < end; text++)
+    {
+        buckets = 0xFF;
+
+        for (k = 0; k < thiz->teddy_width && text + k < end; k++)
+        {
+            alpha = (unsigned char) text[k];
+            buckets &= thiz->teddy_lo[k][alpha & 0x0F] & 
+                    thiz->teddy_hi[k][alpha >> 4];
+        }
+
+        if (buckets)
+            break;
+    }
+
+    return text;
+}
+
+#endif
+
+/**
+ * @brief Scans for the first and the last bytes of the patterns, one 
+ * position at a time; a last byte after the end of the text is taken as 
+ * matching
+ *****************************************************************************/
+static const AC_ALPHABET_t *skip_scan_memmem_tail (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end)
+{
+    size_t k;
+
+    for (; text < end; text++)
+        for (k = 0; k < thiz->memmem_count; k++)
+            if ((unsigned char) text[0] == thiz->memmem_first[k] && 
+                    (thiz->memmem_offsets[k] >= (size_t)(end - text) || 
+                    (unsigned char) text[thiz->memmem_offsets[k]] == 
+                    thiz->memmem_last[k]))
+                return text;
+
+    return text;
+}
+
+/**
+ * @brief Scans by shifting the window over the text
+ *
+ * A window that passes the end of the text is returned as a candidate, 
+ * because the rest of the pattern may come in the next chunk.
+ *****************************************************************************/
+static const AC_ALPHABET_t *skip_scan_shift (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end)
+{
+    size_t shift, block;
+    const size_t last = thiz->shift_window - SKIP_SHIFT_BLOCK;
+    const uint8_t *shifts = thiz->shifts;
+
+    while ((size_t)(end - text) >= thiz->shift_window)
+    {
+        shift = shifts[SKIP_BLOCK(&text[last])];
+        if (shift == 0)
+        {
+            block = SKIP_BLOCK(text);
+            if (thiz->prefixes[block >> 3] & (1 << (block & 7)))
+                return text;
+            shift = 1;
+        }
+        text += shift;
+    }
+
+    return text;
+}
+
+#ifdef SKIP_X86
+
+/**
+ * @brief Scans for two or three start bytes, 16 bytes at a time
+ *****************************************************************************/
+static const AC_ALPHABET_t *skip_scan_bytes_sse2 (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end)
+{
+    unsigned int mask;
+    __m128i v;
+    const __m128i b0 = _mm_set1_epi8 ((char) thiz->bytes[0]);
+    const __m128i b1 = _mm_set1_epi8 ((char) thiz->bytes[1]);
+    const __m128i b2 = _mm_set1_epi8 ((char) thiz->bytes
+            [thiz->bytes_count > 2 ? 2 : 1]);
+
+    while (end - text >= 16)
+    {
+        v = _mm_loadu_si128 ((const __m128i *) text);
+        mask = _mm_movemask_epi8 (_mm_or_si128 (_mm_or_si128
+                (_mm_cmpeq_epi8 (v, b0), _mm_cmpeq_epi8 (v, b1)),
+                _mm_cmpeq_epi8 (v, b2)));
+        if (mask)
+            return text + __builtin_ctz (mask);
+        text += 16;
+    }
+
+    return skip_scan_table (thiz, text, end);
+}
+
+/**
+ * @brief Scans for a set of start bytes using the nibble masks, 16 bytes at
+ * a time
+ *****************************************************************************/
+__attribute__((target("ssse3")))
+static const AC_ALPHABET_t *skip_scan_nibbles_ssse3 (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end)
+{
+    unsigned int mask;
+    __m128i v, lo, hi;
+    const __m128i lo_masks = _mm_loadu_si128 ((const __m128i *) thiz->lo_masks);
+    const __m128i hi_masks = _mm_loadu_si128 ((const __m128i *) thiz->hi_masks);
+    const __m128i nibble = _mm_set1_epi8 (0x0F);
+    const __m128i zero = _mm_setzero_si128 ();
+
+    while (end - text >= 16)
+    {
+        v = _mm_loadu_si128 ((const __m128i *) text);
+        lo = _mm_shuffle_epi8 (lo_masks, _mm_and_si128 (v, nibble));
+        hi = _mm_shuffle_epi8 (hi_masks,
+                _mm_and_si128 (_mm_srli_epi16 (v, 4), nibble));
+        mask = _mm_movemask_epi8 (_mm_cmpeq_epi8
+                (_mm_and_si128 (lo, hi), zero)) ^ 0xFFFF;
+
+        /* Drop the false candidates of the shared buckets */
+        for (; mask; mask &= mask - 1)
+            if (thiz->table[(unsigned char) text[__builtin_ctz (mask)]])
+                return text + __builtin_ctz (mask);
+        text += 16;
+    }
+
+    return skip_scan_table (thiz, text, end);
+}
+
+/**
+ * @brief Scans for a set of start bytes using the nibble masks, 32 bytes at
+ * a time
+ *****************************************************************************/
+__attribute__((target("avx2")))
+static const AC_ALPHABET_t *skip_scan_nibbles_avx2 (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end)
+{
+    unsigned int mask;
+    __m256i v, lo, hi;
+    const __m256i lo_masks = _mm256_broadcastsi128_si256
+            (_mm_loadu_si128 ((const __m128i *) thiz->lo_masks));
+    const __m256i hi_masks = _mm256_broadcastsi128_si256
+            (_mm_loadu_si128 ((const __m128i *) thiz->hi_masks));
+    const __m256i nibble = _mm256_set1_epi8 (0x0F);
+    const __m256i zero = _mm256_setzero_si256 ();
+
+    while (end - text >= 32)
+    {
+        v = _mm256_loadu_si256 ((const __m256i *) text);
+        lo = _mm256_shuffle_epi8 (lo_masks, _mm256_and_si256 (v, nibble));
+        hi = _mm256_shuffle_epi8 (hi_masks,
+                _mm256_and_si256 (_mm256_srli_epi16 (v, 4), nibble));
+        mask = ~(unsigned int) _mm256_movemask_epi8 (_mm256_cmpeq_epi8
+                (_mm256_and_si256 (lo, hi), zero));
+
+        /* Drop the false candidates of the shared buckets */
+        for (; mask; mask &= mask - 1)
+            if (thiz->table[(unsigned char) text[__builtin_ctz (mask)]])
+                return text + __builtin_ctz (mask);
+        text += 32;
+    }
+
+    return skip_scan_table (thiz, text, end);
+}
+
+/**
+ * @brief Scans for the Teddy fingerprints, 16 positions at a time
+ *****************************************************************************/
+__attribute__((target("ssse3")))
+static const AC_ALPHABET_t *skip_scan_teddy_ssse3 (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end)
+{
+    size_t k, width = thiz->teddy_width;
+    unsigned int mask;
+    __m128i v, buckets;
+    __m128i lo[SKIP_TEDDY_MAX_WIDTH], hi[SKIP_TEDDY_MAX_WIDTH];
+    const __m128i nibble = _mm_set1_epi8 (0x0F);
+    const __m128i zero = _mm_setzero_si128 ();
+
+    for (k = 0; k < width; k++)
+    {
+        lo[k] = _mm_loadu_si128 ((const __m128i *) thiz->teddy_lo[k]);
+        hi[k] = _mm_loadu_si128 ((const __m128i *) thiz->teddy_hi[k]);
+    }
+
+    while ((size_t)(end - text) >= 16 + width - 1)
+    {
+        buckets = _mm_set1_epi8 ((char) 0xFF);
+
+        for (k = 0; k < width; k++)
+        {
+            v = _mm_loadu_si128 ((const __m128i *) (text + k));
+            buckets = _mm_and_si128 (buckets, _mm_and_si128
+                    (_mm_shuffle_epi8 (lo[k], _mm_and_si128 (v, nibble)),
+                     _mm_shuffle_epi8 (hi[k], 
+                         _mm_and_si128 (_mm_srli_epi16 (v, 4), nibble))));
+        }
+
+        mask = _mm_movemask_epi8 (_mm_cmpeq_epi8 (buckets, zero)) ^ 0xFFFF;
+        if (mask)
+            return text + __builtin_ctz (mask);
+        text += 16;
+    }
+
+    return skip_scan_teddy_tail (thiz, text, end);
+}
+
+/**
+ * @brief Scans for the Teddy fingerprints, 32 positions at a time
+ *****************************************************************************/
+__attribute__((target("avx2")))
+static const AC_ALPHABET_t *skip_scan_teddy_avx2 (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end)
+{
+    size_t k, width = thiz->teddy_width;
+    unsigned int mask;
+    __m256i v, buckets;
+    __m256i lo[SKIP_TEDDY_MAX_WIDTH], hi[SKIP_TEDDY_MAX_WIDTH];
+    const __m256i nibble = _mm256_set1_epi8 (0x0F);
+    const __m256i zero = _mm256_setzero_si256 ();
+
+    for (k = 0; k < width; k++)
+    {
+        lo[k] = _mm256_broadcastsi128_si256
+                (_mm_loadu_si128 ((const __m128i *) thiz->teddy_lo[k]));
+        hi[k] = _mm256_broadcastsi128_si256
+                (_mm_loadu_si128 ((const __m128i *) thiz->teddy_hi[k]));
+    }
+
+    while ((size_t)(end - text) >= 32 + width - 1)
+    {
+        buckets = _mm256_set1_epi8 ((char) 0xFF);
+
+        for (k = 0; k < width; k++)
+        {
+            v = _mm256_loadu_si256 ((const __m256i *) (text + k));
+            buckets = _mm256_and_si256 (buckets, _mm256_and_si256
+                    (_mm256_shuffle_epi8 (lo[k], _mm256_and_si256 (v, nibble)),
+                     _mm256_shuffle_epi8 (hi[k], 
+                         _mm256_and_si256 (_mm256_srli_epi16 (v, 4), nibble))));
+        }
+
+        mask = ~(unsigned int) _mm256_movemask_epi8 
+                (_mm256_cmpeq_epi8 (buckets, zero));
+        if (mask)
+            return text + __builtin_ctz (mask);
+        text += 32;
+    }
+
+    return skip_scan_teddy_tail (thiz, text, end);
+}
+
+/**
+ * @brief Scans for the first and the last bytes of the patterns, 16 
+ * positions at a time
+ *****************************************************************************/
+static const AC_ALPHABET_t *skip_scan_memmem_sse2 (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end)
+{
+    size_t k, count = thiz->memmem_count;
+    unsigned int mask;
+    __m128i v, first[SKIP_MEMMEM_MAX_PATTERNS], last[SKIP_MEMMEM_MAX_PATTERNS];
+
+    for (k = 0; k < count; k++)
+    {
+        first[k] = _mm_set1_epi8 ((char) thiz->memmem_first[k]);
+        last[k] = _mm_set1_epi8 ((char) thiz->memmem_last[k]);
+    }
+
+    while ((size_t)(end - text) >= 16 + thiz->memmem_reach)
+    {
+        v = _mm_loadu_si128 ((const __m128i *) text);
+        mask = 0;
+
+        for (k = 0; k < count; k++)
+            mask |= _mm_movemask_epi8 (_mm_and_si128 
+                    (_mm_cmpeq_epi8 (v, first[k]), _mm_cmpeq_epi8 (last[k], 
+                     _mm_loadu_si128 ((const __m128i *) 
+                         (text + thiz->memmem_offsets[k])))));
+
+        if (mask)
+            return text + __builtin_ctz (mask);
+        text += 16;
+    }
+
+    return skip_scan_memmem_tail (thiz, text, end);
+}
+
+/**
+ * @brief Scans for the first and the last bytes of the patterns, 32 
+ * positions at a time
+ *****************************************************************************/
+__attribute__((target("avx2")))
+static const AC_ALPHABET_t *skip_scan_memmem_avx2 (const ACT_SKIP_t *thiz,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end)
+{
+    size_t k, count = thiz->memmem_count;
+    unsigned int mask;
+    __m256i v, first[SKIP_MEMMEM_MAX_PATTERNS], last[SKIP_MEMMEM_MAX_PATTERNS];
+
+    for (k = 0; k < count; k++)
+    {
+        first[k] = _mm256_set1_epi8 ((char) thiz->memmem_first[k]);
+        last[k] = _mm256_set1_epi8 ((char) thiz->memmem_last[k]);
+    }
+
+    while ((size_t)(end - text) >= 32 + thiz->memmem_reach)
+    {
+        v = _mm256_loadu_si256 ((const __m256i *) text);
+        mask = 0;
+
+        for (k = 0; k < count; k++)
+            mask |= (unsigned int) _mm256_movemask_epi8 (_mm256_and_si256 
+                    (_mm256_cmpeq_epi8 (v, first[k]), _mm256_cmpeq_epi8 
+                     (last[k], _mm256_loadu_si256 ((const __m256i *) 
+                         (text + thiz->memmem_offsets[k])))));
+
+        if (mask)
+            return text + __builtin_ctz (mask);
+        text += 32;
+    }
+
+    return skip_scan_memmem_tail (thiz, text, end);
+}
+
+#endif
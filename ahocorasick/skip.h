@@ -0,0 +1,163 @@
+/*
+ * skip.h: Defines the root-state skip scanner of a finalized trie
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SKIP_H_
+#define _SKIP_H_
+
+#include "arena.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The skip scanner is not built if more than this number of bytes can start
+ * a pattern; the automaton leaves the root too often to gain anything.
+ */
+#define SKIP_MAX_BYTES 128
+
+/**
+ * Limits of the Teddy fingerprint scanner: it is used for small pattern
+ * sets and looks at up to SKIP_TEDDY_MAX_WIDTH bytes of every start 
+ * position.
+ */
+#define SKIP_TEDDY_MAX_PATTERNS 100
+#define SKIP_TEDDY_MAX_WIDTH 3
+
+/**
+ * The memmem scanner is used for the pattern sets that have at most this
+ * number of patterns.
+ */
+#define SKIP_MEMMEM_MAX_PATTERNS 4
+
+/**
+ * The Wu-Manber shift scanner is used when the shortest pattern is at least
+ * SKIP_SHIFT_MIN_LENGTH long. It hashes blocks of SKIP_SHIFT_BLOCK bytes 
+ * and its window is at most SKIP_SHIFT_MAX_WINDOW bytes.
+ */
+#define SKIP_SHIFT_MIN_LENGTH 8
+#define SKIP_SHIFT_BLOCK 2
+#define SKIP_SHIFT_MAX_WINDOW 255
+#define SKIP_SHIFT_TABLE_SIZE 65536
+
+/**
+ * The kinds of the skip scanner
+ */
+typedef enum act_skip_kind
+{
+    SKIP_KIND_BYTES = 0,    /**< Looks for the start bytes */
+    SKIP_KIND_TEDDY,        /**< Looks for the fingerprints of the first 
+                             * bytes of the patterns */
+    SKIP_KIND_SHIFT,        /**< Shifts a window over the text by the 
+                             * Wu-Manber shift table */
+    SKIP_KIND_MEMMEM,       /**< Looks for the first and the last bytes of
+                             * every pattern */
+} ACT_SKIP_KIND_t;
+
+/* Forward Declaration */
+struct act_skip;
+
+/**
+ * Scan function type: returns the first position in [text, end) whose byte
+ * can start a pattern, or end if there is no such position.
+ */
+typedef const AC_ALPHABET_t *(*SKIP_SCAN_f) (const struct act_skip *,
+        const AC_ALPHABET_t *text, const AC_ALPHABET_t *end);
+
+/**
+ * The root-state skip scanner
+ *
+ * While the automaton is in the root state, every byte that does not start
+ * a pattern leaves it in the root without any match. The search loops use
+ * this scanner to jump over those bytes at once. Depending on the number
+ * of the start bytes, it uses memchr, a SIMD compare of two or three bytes,
+ * or a SIMD nibble-mask byte-set lookup. The SIMD kernel is chosen at run
+ * time from the CPU features.
+ *
+ * For small pattern sets, the Teddy scanner compares the first 2 or 3 bytes
+ * of every position against the fingerprints of the patterns, which are
+ * spread over 8 buckets. The found positions are only candidates; the
+ * automaton verifies them as usual.
+ *
+ * When all the patterns are long, the shift scanner slides a window of the
+ * shortest pattern length over the text. The block at the end of the window
+ * tells how far the window can move before a pattern could start in it; a
+ * window that can not move is a candidate if its first block starts a 
+ * pattern.
+ *
+ * For one to four patterns, the memmem scanner compares the first byte of 
+ * every pattern at each position, and its last byte at the position where 
+ * the pattern would end; a pattern can start only where both of them match.
+ */
+typedef struct act_skip
+{
+    ACT_SKIP_KIND_t kind;   /**< Kind of the scanner */
+
+    unsigned char table[ARENA_ALPHABET_SIZE];   /**< Non-zero for the bytes
+                                                 * that start a pattern */
+    unsigned char bytes[3];     /**< The start bytes, if they are few */
+    size_t bytes_count;         /**< Number of the start bytes */
+
+    uint8_t lo_masks[16];   /**< Bucket bits of the low nibbles */
+    uint8_t hi_masks[16];   /**< Bucket bits of the high nibbles */
+
+    size_t teddy_width;     /**< Number of the fingerprint bytes */
+    uint8_t teddy_lo[SKIP_TEDDY_MAX_WIDTH][16]; /**< Bucket bits of the low
+                                                 * nibble of each byte */
+    uint8_t teddy_hi[SKIP_TEDDY_MAX_WIDTH][16]; /**< Bucket bits of the high
+                                                 * nibble of each byte */
+
+    size_t shift_window;    /**< Length of the shift window */
+    uint8_t *shifts;        /**< Shift of every block */
+    uint8_t *prefixes;      /**< Bitmap of the first blocks of the patterns */
+
+    size_t memmem_count;    /**< Number of the patterns */
+    size_t memmem_reach;    /**< The largest of the offsets */
+    size_t memmem_offsets[SKIP_MEMMEM_MAX_PATTERNS];    /**< Offset of the 
+                                                         * last bytes */
+    unsigned char memmem_first[SKIP_MEMMEM_MAX_PATTERNS];   /**< The first 
+                                                             * bytes */
+    unsigned char memmem_last[SKIP_MEMMEM_MAX_PATTERNS];    /**< The last 
+                                                             * bytes */
+
+    SKIP_SCAN_f scan;       /**< The scan function */
+
+} ACT_SKIP_t;
+
+/*
+ * Skip interface functions
+ */
+
+ACT_SKIP_t *skip_create (const ACT_ARENA_t *arena, 
+        const AC_STATISTICS_t *stats, const unsigned char *map, int options);
+ACT_SKIP_t *skip_restore (const ACT_SKIP_t *saved, const uint8_t *shifts, 
+        const uint8_t *prefixes);
+void skip_release (ACT_SKIP_t *thiz);
+
+/**
+ * Scans the text for the next position that can start a pattern
+ */
+#define SKIP_SCAN(skip, text, end) ((skip)->scan ((skip), (text), (end)))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
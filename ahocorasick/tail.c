@@ -0,0 +1,335 @@
+/*
+ * tail.c: Implements the verification of the tail patterns of a truncated 
+ * trie
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tail.h"
+
+/* Privates */
+static void tails_walk (ACT_TAILS_t *thiz, const struct act_tail *tail,
+        const AC_TEXT_t *text, size_t pos, size_t base_position);
+static int tails_compare (const ACT_TAILS_t *thiz, const AC_ALPHABET_t *text,
+        const AC_ALPHABET_t *tail, size_t length);
+static struct act_candidate *tails_add_candidate (ACT_TAILS_t *thiz, 
+        const AC_PATTERN_t *pattern, size_t end, int verified);
+static void tails_add_done (ACT_TAILS_t *thiz, const AC_PATTERN_t *pattern);
+
+/**
+ * Maps the alphabet by the byte map of the tails, if there is one
+ */
+#define TAILS_MAP(tails, alpha) ((tails)->map ? \
+    (AC_ALPHABET_t)(tails)->map[(unsigned char)(alpha)] : (alpha))
+
+
+/**
+ * @brief Creates the tails of a search on the given arena
+ *
+ * @param arena
+ * @param dawg the minimized tails, or NULL
+ * @param map the byte map of the trie, or NULL
+ * @return
+ *****************************************************************************/
+ACT_TAILS_t *tails_create (const ACT_ARENA_t *arena, const ACT_DAWG_t *dawg,
+        const unsigned char *map)
+{
+    ACT_TAILS_t *thiz = (ACT_TAILS_t *) malloc (sizeof(ACT_TAILS_t));
+
+    thiz->arena = arena;
+    thiz->dawg = dawg;
+    thiz->map = map;
+
+    thiz->capacity = 16;
+    thiz->candidates = (struct act_candidate *) malloc 
+            (thiz->capacity * sizeof(struct act_candidate));
+    thiz->count = 0;
+
+    thiz->reserve = arena->matches_max;
+    thiz->done_capacity = thiz->reserve + 16;
+    thiz->done = (AC_PATTERN_t *) malloc 
+            (thiz->done_capacity * sizeof(AC_PATTERN_t));
+    thiz->done_size = 0;
+
+    return thiz;
+}
+
+/**
+ * @brief Releases the tails
+ *
+ * @param thiz
+ *****************************************************************************/
+void tails_release (ACT_TAILS_t *thiz)
+{
+    if (!thiz)
+        return;
+
+    free (thiz->candidates);
+    free (thiz->done);
+    free (thiz);
+}
+
+/**
+ * @brief Drops all the candidates, for a new search
+ *
+ * @param thiz
+ *****************************************************************************/
+void tails_reset (ACT_TAILS_t *thiz)
+{
+    thiz->count = 0;
+    thiz->done_size = 0;
+}
+
+/**
+ * @brief Makes candidates of the tail patterns of the given state
+ *
+ * The search has just reached the state at @p pos of the text. The part of
+ * every tail pattern that falls in the text is compared at once, and the 
+ * pattern is dropped if it does not match. The minimized tails are walked
+ * instead; see tails_walk().
+ *
+ * @param thiz
+ * @param state the state that has tail patterns
+ * @param text the current chunk of the input
+ * @param pos the position of the search in the chunk
+ * @param base_position position of the chunk related to the whole input
+ *****************************************************************************/
+void tails_start (ACT_TAILS_t *thiz, ACT_STATE_t state, 
+        const AC_TEXT_t *text, size_t pos, size_t base_position)
+{
+    const ACT_ARENA_t *arena = thiz->arena;
+    const struct act_tail *tail = arena_find_tail (arena, state);
+    const AC_PATTERN_t *pattern;
+    size_t i, depth = arena->infos[state].depth;
+    size_t rest, available = text->length - pos;
+
+    if (thiz->dawg)
+    {
+        tails_walk (thiz, tail, text, pos, base_position);
+        return;
+    }
+
+    for (i = 0; i < tail->patterns_size; i++)
+    {
+        pattern = &arena->matched[tail->patterns + i];
+        rest = pattern->ptext.length - depth;
+
+        if (tails_compare (thiz, &text->astring[pos], 
+                &pattern->ptext.astring[depth], 
+                rest < available ? rest : available))
+            continue;
+
+        tails_add_candidate (thiz, pattern, base_position + pos + rest, 
+                rest <= available);
+    }
+}
+
+/**
+ * @brief Moves the candidates over the next alphabet of the input
+ *
+ * The candidates that do not match the alphabet are dropped. The ones that
+ * end with it are moved to the done array, which is emptied first.
+ *
+ * @param thiz
+ * @param alpha the alphabet
+ * @param position the position after the alphabet in the whole input
+ *****************************************************************************/
+void tails_advance (ACT_TAILS_t *thiz, AC_ALPHABET_t alpha, size_t position)
+{
+    size_t i, kept = 0;
+    uint32_t edge;
+    struct act_candidate *candidate;
+    const struct act_dawg_state *node;
+    const AC_TEXT_t *ptext;
+
+    thiz->done_size = 0;
+
+    for (i = 0; i < thiz->count; i++)
+    {
+        candidate = &thiz->candidates[i];
+
+        if (!candidate->pattern)
+        {
+            /* A walk on the minimized tails; it has walked up to its end
+             * already */
+            if (position <= candidate->end)
+            {
+                thiz->candidates[kept++] = *candidate;
+                continue;
+            }
+            
+            if ((edge = dawg_find_edge (thiz->dawg, candidate->node, 
+                    TAILS_MAP(thiz, alpha))) == DAWG_NONE)
+                continue;
+
+            candidate->node = thiz->dawg->edges[edge].target;
+            candidate->rank += thiz->dawg->edges[edge].rank;
+            node = &thiz->dawg->states[candidate->node];
+
+            if (node->final)
+                tails_add_done (thiz, &thiz->arena->matched
+                        [candidate->patterns + candidate->rank]);
+            if (node->edges_count)
+            {
+                candidate->end = position;
+                thiz->candidates[kept++] = *candidate;
+            }
+            continue;
+        }
+
+        ptext = &candidate->pattern->ptext;
+
+        if (!candidate->verified && TAILS_MAP(thiz, alpha) != TAILS_MAP(thiz,
+                ptext->astring[ptext->length - (candidate->end - position) - 1]))
+            continue;
+
+        if (candidate->end == position)
+            tails_add_done (thiz, candidate->pattern);
+        else
+            thiz->candidates[kept++] = *candidate;
+    }
+
+    thiz->count = kept;
+}
+
+/**
+ * @brief Walks the minimized tails of the state over the text
+ *
+ * Every tail that ends in the text becomes a verified candidate. If the 
+ * text is over before the walk, the walk itself becomes a candidate that
+ * goes on over the next chunks.
+ *
+ * @param thiz
+ * @param tail the tails of the state
+ * @param text the current chunk of the input
+ * @param pos the position of the search in the chunk
+ * @param base_position position of the chunk related to the whole input
+ *****************************************************************************/
+static void tails_walk (ACT_TAILS_t *thiz, const struct act_tail *tail,
+        const AC_TEXT_t *text, size_t pos, size_t base_position)
+{
+    const ACT_DAWG_t *dawg = thiz->dawg;
+    const struct act_dawg_state *node;
+    struct act_candidate *candidate;
+    uint32_t state = tail->root, rank = 0, edge;
+
+    for (; pos < text->length; pos++)
+    {
+        if ((edge = dawg_find_edge (dawg, state, 
+                TAILS_MAP(thiz, text->astring[pos]))) == DAWG_NONE)
+            return;
+
+        state = dawg->edges[edge].target;
+        rank += dawg->edges[edge].rank;
+        node = &dawg->states[state];
+
+        if (node->final)
+            tails_add_candidate (thiz, 
+                    &thiz->arena->matched[tail->patterns + rank],
+                    base_position + pos + 1, 1);
+        if (!node->edges_count)
+            return;
+    }
+
+    candidate = tails_add_candidate (thiz, NULL, base_position + pos, 0);
+    candidate->node = state;
+    candidate->rank = rank;
+    candidate->patterns = tail->patterns;
+}
+
+/**
+ * @brief Compares the text with the tail through the byte map
+ *
+ * @param thiz
+ * @param text
+ * @param tail
+ * @param length
+ * @return 0 if they match
+ *****************************************************************************/
+static int tails_compare (const ACT_TAILS_t *thiz, const AC_ALPHABET_t *text,
+        const AC_ALPHABET_t *tail, size_t length)
+{
+    size_t i;
+
+    if (!thiz->map)
+        return memcmp (text, tail, length);
+
+    for (i = 0; i < length; i++)
+        if (thiz->map[(unsigned char) text[i]] != 
+                thiz->map[(unsigned char) tail[i]])
+            return 1;
+
+    return 0;
+}
+
+/**
+ * @brief Appends a candidate
+ *
+ * @param thiz
+ * @param pattern
+ * @param end
+ * @param verified
+ * @return the new candidate
+ *****************************************************************************/
+static struct act_candidate *tails_add_candidate (ACT_TAILS_t *thiz, 
+        const AC_PATTERN_t *pattern, size_t end, int verified)
+{
+    struct act_candidate *candidate;
+
+    if (thiz->count == thiz->capacity)
+    {
+        thiz->capacity *= 2;
+        thiz->candidates = (struct act_candidate *) realloc 
+                (thiz->candidates, 
+                 thiz->capacity * sizeof(struct act_candidate));
+    }
+
+    candidate = &thiz->candidates[thiz->count++];
+    candidate->pattern = pattern;
+    candidate->end = end;
+    candidate->verified = verified;
+
+    return candidate;
+}
+
+/**
+ * @brief Appends a pattern to the done array, keeping room for the patterns
+ * of a state after it
+ *
+ * The removed patterns are skipped.
+ *
+ * @param thiz
+ * @param pattern
+ *****************************************************************************/
+static void tails_add_done (ACT_TAILS_t *thiz, const AC_PATTERN_t *pattern)
+{
+    if (thiz->arena->removed && 
+            thiz->arena->removed[pattern - thiz->arena->matched])
+        return;
+
+    if (thiz->done_size + thiz->reserve == thiz->done_capacity)
+    {
+        thiz->done_capacity *= 2;
+        thiz->done = (AC_PATTERN_t *) realloc 
+                (thiz->done, thiz->done_capacity * sizeof(AC_PATTERN_t));
+    }
+
+    thiz->done[thiz->done_size++] = *pattern;
+}
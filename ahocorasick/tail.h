@@ -0,0 +1,102 @@
+/*
+ * tail.h: Defines the verification of the tail patterns of a truncated trie
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _TAIL_H_
+#define _TAIL_H_
+
+#include "arena.h"
+#include "dawg.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * A tail pattern whose beginning is found in the text
+ */
+struct act_candidate
+{
+    const AC_PATTERN_t *pattern;    /**< The tail pattern, or NULL for a 
+                                     * walk on the minimized graph */
+    size_t end;     /**< Where the pattern would end in the whole input, or
+                     * where the walk is */
+    int verified;   /**< The rest of the pattern is compared already */
+    
+    uint32_t node;      /**< The state of the walk */
+    uint32_t rank;      /**< The sum of the ranks along the walk */
+    uint32_t patterns;  /**< Index of the first tail pattern of the walk */
+};
+
+/**
+ * The tail patterns that a search is verifying
+ *
+ * When the search reaches a state that has tail patterns, every tail
+ * pattern becomes a candidate. If the rest of it is in the current chunk,
+ * it is compared at once; otherwise it is compared alphabet by alphabet as
+ * the search goes on, over the next chunks too. A candidate that does not
+ * match is dropped, and one that reaches its end is reported along with the
+ * other patterns that end at the same position.
+ *
+ * If the tails are minimized, a state makes a single candidate that walks
+ * the graph of its tails instead; it reports every tail that ends in the 
+ * states it reaches, and is dropped when the graph has no edge for the 
+ * text.
+ *
+ * The candidates are kept in the order they start, so the patterns that
+ * end at the same position come out the longest first.
+ *
+ * If the trie has a byte map, the text and the tails are compared through 
+ * it; the graph is labeled by the mapped bytes already.
+ */
+typedef struct act_tails
+{
+    struct act_candidate *candidates;   /**< The candidates */
+    size_t count;       /**< Number of the candidates */
+    size_t capacity;    /**< Max capacity of the candidates */
+
+    AC_PATTERN_t *done; /**< The patterns that end at the current position,
+                         * followed by room for the patterns of a state */
+    size_t done_size;       /**< Number of the ended patterns */
+    size_t done_capacity;   /**< Max capacity of the done array */
+    size_t reserve;     /**< The room kept for the patterns of a state */
+
+    const ACT_ARENA_t *arena;   /**< The arena that has the tails */
+    const ACT_DAWG_t *dawg;     /**< The minimized tails, or NULL */
+    const unsigned char *map;   /**< The byte map of the trie, or NULL */
+
+} ACT_TAILS_t;
+
+/*
+ * Tails interface functions
+ */
+
+ACT_TAILS_t *tails_create (const ACT_ARENA_t *arena, 
+        const ACT_DAWG_t *dawg, const unsigned char *map);
+void tails_release (ACT_TAILS_t *thiz);
+void tails_reset (ACT_TAILS_t *thiz);
+void tails_start (ACT_TAILS_t *thiz, ACT_STATE_t state, 
+        const AC_TEXT_t *text, size_t pos, size_t base_position);
+void tails_advance (ACT_TAILS_t *thiz, AC_ALPHABET_t alpha, size_t position);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
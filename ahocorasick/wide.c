@@ -0,0 +1,517 @@
+/*
+ * wide.c: Implements the symbol classes of the tries of wide symbols
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "wide.h"
+
+/**
+ * The slot of a hashed symbol, by Fibonacci hashing
+ */
+#define WIDE_HASH(symbol, bits) \
+        ((uint32_t) ((symbol) * 2654435761u) >> (32 - (bits)))
+
+/* Privates */
+static uint32_t wide_assign (ACT_WIDE_t *thiz, uint32_t symbol);
+static uint32_t wide_code (size_t number);
+static size_t wide_number (const unsigned char *code, size_t *length);
+static void wide_hash_insert (ACT_WIDE_t *thiz, uint32_t symbol,
+        uint32_t code);
+static void wide_hash_put (uint32_t *keys, uint32_t *values,
+        unsigned int bits, uint32_t symbol, uint32_t code);
+
+
+/**
+ * @brief Reads a symbol of the given width
+ *
+ * @param text array of the symbols
+ * @param i index of the symbol
+ * @param width bytes per symbol
+ * @return The symbol
+ *****************************************************************************/
+static inline uint32_t wide_symbol (const void *text, size_t i, size_t width)
+{
+    switch (width)
+    {
+        case 1:
+            return ((const uint8_t *) text)[i];
+        case 2:
+            return ((const uint16_t *) text)[i];
+        default:
+            return ((const uint32_t *) text)[i];
+    }
+}
+
+/**
+ * @brief Finds the code of a symbol
+ *
+ * @param thiz
+ * @param symbol
+ * @return The code, or WIDE_VOID if the symbol is in no pattern
+ *****************************************************************************/
+static inline uint32_t wide_lookup (const ACT_WIDE_t *thiz, uint32_t symbol)
+{
+    const uint32_t *page;
+    size_t slot, mask;
+
+    if (symbol < WIDE_PAGED_SYMBOLS)
+    {
+        page = thiz->pages[symbol / WIDE_PAGE_SIZE];
+        return page ? page[symbol % WIDE_PAGE_SIZE] : WIDE_VOID;
+    }
+
+    if (!thiz->hash_count)
+        return WIDE_VOID;
+
+    mask = ((size_t) 1 << thiz->hash_bits) - 1;
+    for (slot = WIDE_HASH(symbol, thiz->hash_bits); thiz->keys[slot];
+            slot = (slot + 1) & mask)
+        if (thiz->keys[slot] == symbol)
+            return thiz->values[slot];
+
+    return WIDE_VOID;
+}
+
+/**
+ * @brief Creates the symbol classes of a trie, with no symbol
+ *
+ * @param width bytes per symbol: 1, 2 or 4
+ * @return
+ *****************************************************************************/
+ACT_WIDE_t *wide_create (size_t width)
+{
+    ACT_WIDE_t *thiz = (ACT_WIDE_t *) malloc (sizeof(ACT_WIDE_t));
+
+    thiz->width = width;
+    memset (thiz->pages, 0, sizeof(thiz->pages));
+
+    thiz->keys = NULL;
+    thiz->values = NULL;
+    thiz->hash_bits = 0;
+    thiz->hash_count = 0;
+
+    thiz->symbols = NULL;
+    thiz->symbols_count = 0;
+    thiz->symbols_capacity = 0;
+
+    /* A symbol is four code bytes at most */
+    thiz->codes = (unsigned char *) malloc (4 * WIDE_BLOCK_SIZE);
+    thiz->ends = (uint32_t *) malloc (4 * WIDE_BLOCK_SIZE * sizeof(uint32_t));
+    thiz->block_ends = NULL;
+    thiz->code_base = 0;
+    thiz->symbols_base = 0;
+
+    thiz->patterns = NULL;
+    thiz->patterns_capacity = 0;
+    thiz->decoded = NULL;
+    thiz->decoded_capacity = 0;
+
+    thiz->callback = NULL;
+    thiz->user = NULL;
+
+    return thiz;
+}
+
+/**
+ * @brief Releases the symbol classes
+ *
+ * @param thiz
+ *****************************************************************************/
+void wide_release (ACT_WIDE_t *thiz)
+{
+    size_t i;
+
+    if (!thiz)
+        return;
+
+    for (i = 0; i < WIDE_PAGED_SYMBOLS / WIDE_PAGE_SIZE; i++)
+        free (thiz->pages[i]);
+    free (thiz->keys);
+    free (thiz->values);
+    free (thiz->symbols);
+    free (thiz->codes);
+    free (thiz->ends);
+    free (thiz->patterns);
+    free (thiz->decoded);
+    free (thiz);
+}
+
+/**
+ * @brief Codes the symbols of a pattern
+ *
+ * @param thiz
+ * @param symbols the symbols of the pattern
+ * @param length number of the symbols
+ * @param assign give a code to the symbols that have none yet; otherwise
+ * the pattern can not have such a symbol
+ * @param coded the codes of the pattern; they are valid until the next
+ * pattern is coded
+ * @return ACERR_SUCCESS; ACERR_LONG_PATTERN if the codes are longer than
+ * AC_PATTRN_MAX_LENGTH or WIDE_CODES_MAX symbols have codes already;
+ * ACERR_PATTERN_NOT_FOUND if a symbol has no code and @p assign is not set
+ *****************************************************************************/
+AC_STATUS_t wide_encode_pattern (ACT_WIDE_t *thiz, const void *symbols,
+        size_t length, int assign, AC_TEXT_t *coded)
+{
+    size_t i, size = 0;
+    uint32_t symbol, code;
+
+    if (length > AC_PATTRN_MAX_LENGTH)
+        return ACERR_LONG_PATTERN;
+
+    for (i = 0; i < length; i++)
+    {
+        symbol = wide_symbol (symbols, i, thiz->width);
+
+        if (!(code = wide_lookup (thiz, symbol)))
+        {
+            if (!assign)
+                return ACERR_PATTERN_NOT_FOUND;
+            if (!(code = wide_assign (thiz, symbol)))
+                return ACERR_LONG_PATTERN;
+        }
+
+        do
+        {
+            if (size == AC_PATTRN_MAX_LENGTH)
+                return ACERR_LONG_PATTERN;
+            thiz->pattern[size++] = (unsigned char) code;
+            code >>= 8;
+        } while (code);
+    }
+
+    coded->astring = (const AC_ALPHABET_t *) thiz->pattern;
+    coded->length = size;
+
+    return ACERR_SUCCESS;
+}
+
+/**
+ * @brief Codes the next block of the text
+ *
+ * Every symbol is looked up and written as its code, whatever the width is.
+ * The ends of the symbols are noted only when some codes are longer than a
+ * byte; otherwise a code position is a symbol position.
+ *
+ * @param thiz
+ * @param text the symbols of the text
+ * @param length number of the symbols
+ * @param block the codes of up to WIDE_BLOCK_SIZE symbols; they are valid
+ * until the next block is coded
+ * @return Number of the symbols coded
+ *****************************************************************************/
+size_t wide_encode_block (ACT_WIDE_t *thiz, const void *text, size_t length,
+        AC_TEXT_t *block)
+{
+    unsigned char *out = thiz->codes;
+    uint32_t *ends;
+    uint32_t code;
+    size_t i;
+
+    if (length > WIDE_BLOCK_SIZE)
+        length = WIDE_BLOCK_SIZE;
+
+    ends = thiz->symbols_count > WIDE_CODES1 ? thiz->ends : NULL;
+    thiz->block_ends = ends;
+
+    for (i = 0; i < length; i++)
+    {
+        code = wide_lookup (thiz, wide_symbol (text, i, thiz->width));
+
+        do
+        {
+            *out++ = (unsigned char) code;
+            if (ends)
+                *ends++ = i + 1;
+            code >>= 8;
+        } while (code);
+    }
+
+    block->astring = (const AC_ALPHABET_t *) thiz->codes;
+    block->length = out - thiz->codes;
+
+    return length;
+}
+
+/**
+ * @brief Reports a match of the codes as a match of the symbols
+ *
+ * The patterns are decoded into symbols of the width of the trie, and the
+ * position is translated into symbols. The patterns are valid in the
+ * call-back function only.
+ *
+ * @param match the match of the codes of the current block
+ * @param param the symbol classes
+ * @return The return value of the call-back function of the search
+ *****************************************************************************/
+int wide_report (AC_MATCH_t *match, void *param)
+{
+    ACT_WIDE_t *thiz = (ACT_WIDE_t *) param;
+    const AC_PATTERN_t *patt;
+    const unsigned char *code;
+    unsigned char *out;
+    AC_MATCH_t decoded;
+    size_t i, j, size = 0, count, length, end;
+    uint32_t symbol;
+
+    for (i = 0; i < match->size; i++)
+        size += match->patterns[i].ptext.length;
+
+    if (match->size > thiz->patterns_capacity)
+    {
+        thiz->patterns_capacity = 2 * match->size;
+        thiz->patterns = (AC_PATTERN_t *) realloc (thiz->patterns,
+                thiz->patterns_capacity * sizeof(AC_PATTERN_t));
+    }
+
+    /* A symbol is a code byte at least */
+    if (size * thiz->width > thiz->decoded_capacity)
+    {
+        thiz->decoded_capacity = 2 * size * thiz->width;
+        thiz->decoded = (unsigned char *) realloc (thiz->decoded,
+                thiz->decoded_capacity);
+    }
+
+    out = thiz->decoded;
+
+    for (i = 0; i < match->size; i++)
+    {
+        patt = &match->patterns[i];
+        code = (const unsigned char *) patt->ptext.astring;
+
+        thiz->patterns[i] = *patt;
+        thiz->patterns[i].ptext.astring = (const AC_ALPHABET_t *) out;
+
+        for (j = 0, count = 0; j < patt->ptext.length; j += length, count++)
+        {
+            symbol = thiz->symbols[wide_number (&code[j], &length)];
+            switch (thiz->width)
+            {
+                case 1:
+                    *(uint8_t *) out = (uint8_t) symbol;
+                    break;
+                case 2:
+                    *(uint16_t *) out = (uint16_t) symbol;
+                    break;
+                default:
+                    *(uint32_t *) out = symbol;
+            }
+            out += thiz->width;
+        }
+        thiz->patterns[i].ptext.length = count;
+    }
+
+    /* A match ends on the end of a symbol */
+    end = match->position - thiz->code_base;
+    decoded.position = thiz->symbols_base +
+            (thiz->block_ends ? thiz->block_ends[end - 1] : end);
+    decoded.patterns = thiz->patterns;
+    decoded.size = match->size;
+
+    return thiz->callback (&decoded, thiz->user);
+}
+
+/**
+ * @brief Gives the next code to a symbol
+ *
+ * @param thiz
+ * @param symbol a symbol that has no code
+ * @return The code, or WIDE_VOID if there is no code left
+ *****************************************************************************/
+static uint32_t wide_assign (ACT_WIDE_t *thiz, uint32_t symbol)
+{
+    uint32_t code, **page;
+
+    if (thiz->symbols_count == WIDE_CODES_MAX)
+        return WIDE_VOID;
+
+    code = wide_code (thiz->symbols_count);
+
+    if (thiz->symbols_count == thiz->symbols_capacity)
+    {
+        thiz->symbols_capacity = thiz->symbols_capacity ?
+                2 * thiz->symbols_capacity : 256;
+        thiz->symbols = (uint32_t *) realloc (thiz->symbols,
+                thiz->symbols_capacity * sizeof(uint32_t));
+    }
+    thiz->symbols[thiz->symbols_count++] = symbol;
+
+    if (symbol < WIDE_PAGED_SYMBOLS)
+    {
+        page = &thiz->pages[symbol / WIDE_PAGE_SIZE];
+        if (!*page)
+            *page = (uint32_t *) calloc (WIDE_PAGE_SIZE, sizeof(uint32_t));
+        (*page)[symbol % WIDE_PAGE_SIZE] = code;
+    }
+    else
+    {
+        wide_hash_insert (thiz, symbol, code);
+    }
+
+    return code;
+}
+
+/**
+ * @brief Makes the code of the given number
+ *
+ * The codes are numbered from 0, the single bytes first. The continuation
+ * bytes of a longer code are the digits of its number among the codes of
+ * its length, the most significant first, and the lead takes the rest.
+ *
+ * @param number
+ * @return The code
+ *****************************************************************************/
+static uint32_t wide_code (size_t number)
+{
+    uint32_t code = 0;
+    unsigned int lead, i, length;
+
+    if (number < WIDE_CODES1)
+        return number + 1;
+
+    number -= WIDE_CODES1;
+
+    if (number < WIDE_CODES2)
+    {
+        lead = WIDE_LEAD2;
+        length = 2;
+    }
+    else if ((number -= WIDE_CODES2) < WIDE_CODES3)
+    {
+        lead = WIDE_LEAD3;
+        length = 3;
+    }
+    else
+    {
+        number -= WIDE_CODES3;
+        lead = WIDE_LEAD4;
+        length = 4;
+    }
+
+    for (i = 1; i < length; i++)
+    {
+        code = (code << 8) | (WIDE_TRAIL + number % WIDE_TRAILS);
+        number /= WIDE_TRAILS;
+    }
+
+    return (code << 8) | (lead + number);
+}
+
+/**
+ * @brief Finds the number of a code; see wide_code()
+ *
+ * @param code the bytes of the code
+ * @param length on return it holds the length of the code
+ * @return The number
+ *****************************************************************************/
+static size_t wide_number (const unsigned char *code, size_t *length)
+{
+    size_t number, first, i;
+
+    if (code[0] < WIDE_LEAD2)
+    {
+        *length = 1;
+        return code[0] - 1;
+    }
+
+    if (code[0] < WIDE_LEAD3)
+    {
+        number = code[0] - WIDE_LEAD2;
+        first = WIDE_CODES1;
+        *length = 2;
+    }
+    else if (code[0] < WIDE_LEAD4)
+    {
+        number = code[0] - WIDE_LEAD3;
+        first = WIDE_CODES1 + WIDE_CODES2;
+        *length = 3;
+    }
+    else
+    {
+        number = code[0] - WIDE_LEAD4;
+        first = WIDE_CODES1 + WIDE_CODES2 + WIDE_CODES3;
+        *length = 4;
+    }
+
+    for (i = 1; i < *length; i++)
+        number = number * WIDE_TRAILS + code[i] - WIDE_TRAIL;
+
+    return first + number;
+}
+
+/**
+ * @brief Adds a symbol to the hash, growing it to keep it half empty
+ *
+ * @param thiz
+ * @param symbol a symbol of WIDE_PAGED_SYMBOLS or above
+ * @param code
+ *****************************************************************************/
+static void wide_hash_insert (ACT_WIDE_t *thiz, uint32_t symbol,
+        uint32_t code)
+{
+    uint32_t *keys, *values;
+    unsigned int bits;
+    size_t i, size = (size_t) 1 << thiz->hash_bits;
+
+    if (2 * (thiz->hash_count + 1) > size)
+    {
+        bits = thiz->hash_bits ? thiz->hash_bits + 1 : 8;
+        keys = (uint32_t *) calloc ((size_t) 1 << bits, sizeof(uint32_t));
+        values = (uint32_t *) malloc (((size_t) 1 << bits) *
+                sizeof(uint32_t));
+
+        for (i = 0; thiz->keys && i < size; i++)
+            if (thiz->keys[i])
+                wide_hash_put (keys, values, bits, thiz->keys[i],
+                        thiz->values[i]);
+
+        free (thiz->keys);
+        free (thiz->values);
+        thiz->keys = keys;
+        thiz->values = values;
+        thiz->hash_bits = bits;
+    }
+
+    wide_hash_put (thiz->keys, thiz->values, thiz->hash_bits, symbol, code);
+    thiz->hash_count++;
+}
+
+/**
+ * @brief Puts a symbol into the first free slot from its hash
+ *
+ * @param keys
+ * @param values
+ * @param bits
+ * @param symbol
+ * @param code
+ *****************************************************************************/
+static void wide_hash_put (uint32_t *keys, uint32_t *values,
+        unsigned int bits, uint32_t symbol, uint32_t code)
+{
+    size_t mask = ((size_t) 1 << bits) - 1;
+    size_t slot;
+
+    for (slot = WIDE_HASH(symbol, bits); keys[slot]; slot = (slot + 1) & mask)
+        ;
+
+    keys[slot] = symbol;
+    values[slot] = code;
+}
@@ -0,0 +1,136 @@
+/*
+ * wide.h: Defines the symbol classes of the tries of wide symbols
+ * This file is part of multifast.
+ *
+    Copyright 2010-2015 Kamiar Kanani <kamiar.kanani@gmail.com>
+
+    multifast is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    multifast is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with multifast.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _WIDE_H_
+#define _WIDE_H_
+
+#include "actypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The code of a symbol is one to four bytes. Its first byte tells its
+ * length; the other bytes are continuation bytes, which never start a code.
+ * So the codes are prefix free, and a match of the codes of a pattern
+ * starts and ends on the boundaries of the symbols.
+ */
+#define WIDE_VOID 0         /**< The code of the symbols of no pattern */
+#define WIDE_LEAD2 112      /**< The first lead of the 2-byte codes */
+#define WIDE_LEAD3 120      /**< The first lead of the 3-byte codes */
+#define WIDE_LEAD4 124      /**< The first lead of the 4-byte codes */
+#define WIDE_TRAIL 128      /**< The first continuation byte */
+
+#define WIDE_TRAILS (256 - WIDE_TRAIL)
+#define WIDE_CODES1 (WIDE_LEAD2 - 1)
+#define WIDE_CODES2 ((WIDE_LEAD3 - WIDE_LEAD2) * WIDE_TRAILS)
+#define WIDE_CODES3 ((WIDE_LEAD4 - WIDE_LEAD3) * WIDE_TRAILS * WIDE_TRAILS)
+#define WIDE_CODES4 ((WIDE_TRAIL - WIDE_LEAD4) * WIDE_TRAILS * WIDE_TRAILS * \
+        WIDE_TRAILS)
+
+/**
+ * Number of the distinct symbols that the patterns of a trie can have
+ */
+#define WIDE_CODES_MAX (WIDE_CODES1 + WIDE_CODES2 + WIDE_CODES3 + WIDE_CODES4)
+
+/**
+ * The symbols below this are mapped by the pages; the others by the hash
+ */
+#define WIDE_PAGED_SYMBOLS 65536
+#define WIDE_PAGE_SIZE 256
+
+/**
+ * Number of the symbols of the text that are coded and searched at once
+ */
+#define WIDE_BLOCK_SIZE 4096
+
+/**
+ * The symbol classes of a trie of wide symbols
+ *
+ * Every symbol that is in a pattern is given a code when it is first added,
+ * in the order of the symbols; the first WIDE_CODES1 codes are single
+ * bytes. The trie holds the patterns as the strings of the codes of their
+ * symbols, and the text is searched as the codes of its symbols; all the
+ * symbols that are in no pattern share the void code. The codes of the
+ * symbols below WIDE_PAGED_SYMBOLS are looked up in a two-level table, and
+ * the others in an open addressing hash.
+ *
+ * A code is kept as its bytes in a uint32_t, the first one in the lowest
+ * byte; only the void code is 0.
+ */
+typedef struct act_wide
+{
+    size_t width;       /**< Bytes per symbol: 1, 2 or 4 */
+
+    uint32_t *pages[WIDE_PAGED_SYMBOLS / WIDE_PAGE_SIZE];  /**< The codes of
+                         * the paged symbols by their high bits; a page is
+                         * NULL if none of its symbols has a code */
+
+    uint32_t *keys;     /**< The hashed symbols; 0 is a free slot */
+    uint32_t *values;   /**< Their codes */
+    unsigned int hash_bits; /**< The hash has 2 ^ hash_bits slots */
+    size_t hash_count;  /**< Number of the hashed symbols */
+
+    uint32_t *symbols;  /**< The symbol of every code, by its number */
+    size_t symbols_count;   /**< Number of the codes given */
+    size_t symbols_capacity;    /**< Max capacity of the symbols array */
+
+    unsigned char pattern[AC_PATTRN_MAX_LENGTH];  /**< The codes of the
+                                                   * pattern being added */
+
+    unsigned char *codes;   /**< The codes of a block of the text */
+    uint32_t *ends;     /**< The number of the symbols of the block to the
+                         * end of every code byte */
+    const uint32_t *block_ends; /**< The ends, or NULL if every code of the
+                                 * block is a single byte */
+    size_t code_base;   /**< Position of the block in the codes of the
+                         * whole input */
+    size_t symbols_base;    /**< Position of the block in the symbols of the
+                             * whole input */
+
+    AC_PATTERN_t *patterns; /**< The patterns of a match, in symbols */
+    size_t patterns_capacity;   /**< Max capacity of the patterns array */
+    unsigned char *decoded; /**< The symbols of the patterns of a match */
+    size_t decoded_capacity;    /**< Max capacity of the decoded buffer */
+
+    AC_MATCH_CALBACK_f callback;    /**< The call-back function of the
+                                     * search */
+    void *user;         /**< Its parameter */
+
+} ACT_WIDE_t;
+
+/*
+ * Wide interface functions
+ */
+
+ACT_WIDE_t *wide_create (size_t width);
+void wide_release (ACT_WIDE_t *thiz);
+AC_STATUS_t wide_encode_pattern (ACT_WIDE_t *thiz, const void *symbols,
+        size_t length, int assign, AC_TEXT_t *coded);
+size_t wide_encode_block (ACT_WIDE_t *thiz, const void *text, size_t length,
+        AC_TEXT_t *block);
+int  wide_report (AC_MATCH_t *match, void *param);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -79,7 +79,8 @@ int main (int argc, char **argv)
     }
     
     /* Now the preprocessing stage ends. You must finalize the trie. Remember 
-     * that you can not add patterns anymore. */
+     * that the patterns you add or remove after this are not searched until
+     * you finalize the trie again. */
     ac_trie_finalize (trie);
     
     /* Finalizing the trie is the slowest part of the task. It may take a 
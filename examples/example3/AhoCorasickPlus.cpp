@@ -48,7 +48,8 @@ AhoCorasickPlus::EnumReturnStatus AhoCorasickPlus::addPattern
     patt.rtext.astring = NULL;
     patt.rtext.length = 0;
     
-    AC_STATUS_t status = ac_trie_add (m_automata, &patt, 0);
+    // The string may be a temporary one, so the trie keeps a copy
+    AC_STATUS_t status = ac_trie_add (m_automata, &patt, 1);
     
     switch (status)
     {
@@ -67,6 +68,9 @@ AhoCorasickPlus::EnumReturnStatus AhoCorasickPlus::addPattern
         case ACERR_TRIE_CLOSED: 
             rv = RETURNSTATUS_AUTOMATA_CLOSED; 
             break;
+        case ACERR_PATTERN_NOT_FOUND: // Only a removal fails so
+            rv = RETURNSTATUS_FAILED; 
+            break;
     }
     return rv;
 }
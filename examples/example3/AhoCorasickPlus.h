@@ -41,7 +41,7 @@ public:
         RETURNSTATUS_DUPLICATE_PATTERN, // Duplicate patterns
         RETURNSTATUS_LONG_PATTERN,      // Long pattern
         RETURNSTATUS_ZERO_PATTERN,      // Empty pattern (zero length)
-        RETURNSTATUS_AUTOMATA_CLOSED,   // Automata is closed
+        RETURNSTATUS_AUTOMATA_CLOSED,   // Not returned: finalized tries add
         RETURNSTATUS_FAILED,            // General unknown failure
     };
     
@@ -89,6 +89,10 @@ int main (int argc, char **argv)
                 printf ("Add pattern failed: ACERR_AUTOMATA_CLOSED: %s\n", 
                         patt->ptext.astring);
                 break;
+            case ACERR_PATTERN_NOT_FOUND:
+                printf ("Add pattern failed: ACERR_PATTERN_NOT_FOUND: %s\n", 
+                        patt->ptext.astring);
+                break;
             case ACERR_SUCCESS:
                 printf ("Pattern Added: %s\n", patt->ptext.astring);
                 break;
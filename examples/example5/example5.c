@@ -72,6 +72,7 @@ void *child_handler(void * args)
 
     /* Search */
     ac_trie_search_thread_safe(params->trie, search_node, 0, match_handler, 0);
+    ac_search_payload_release(search_node);
 
     /* when the keep option (3rd argument) in set, then the automata considers
      * that the given text is the next chunk of the previous text. To see the
@@ -114,7 +115,8 @@ int main (int argc, char **argv)
     }
     
     /* Now the preprocessing stage ends. You must finalize the trie. Remember 
-     * that you can not add patterns anymore. */
+     * that the patterns you add or remove after this are not searched until
+     * you finalize the trie again. */
     ac_trie_finalize (trie);
     
     /* Finalizing the trie is the slowest part of the task. It may take a 
@@ -81,6 +81,7 @@ void *child_handler(void * args)
 
     /* Search */
     ac_trie_search_thread_safe(params->trie, search_node, 0, match_handler, matchParams);
+    ac_search_payload_release(search_node);
 
     printf("Found %lu matches in \"%s\"\n", matchParams->match_count, params->alphabet);
 
@@ -124,7 +125,8 @@ int main (int argc, char **argv)
     }
     
     /* Now the preprocessing stage ends. You must finalize the trie. Remember 
-     * that you can not add patterns anymore. */
+     * that the patterns you add or remove after this are not searched until
+     * you finalize the trie again. */
     ac_trie_finalize (trie);
     
     /* Finalizing the trie is the slowest part of the task. It may take a 
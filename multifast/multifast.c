@@ -22,7 +22,6 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <ctype.h>
 #include <dirent.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -243,10 +242,6 @@ int search_file (const char *filename, AC_TRIE_t *trie)
         
         intext.length = num_read;
 
-        /* Handle case sensitivity */
-        if (config.insensitive)
-            lower_case(in_stream_buffer, intext.length);
-
         /* Break loop if call-back function has done its work */
         if (ac_trie_search (trie, &intext, keep, match_handler, &mparm))
             break;
@@ -342,10 +337,6 @@ int replace_file (AC_TRIE_t *trie, const char *infile, const char *outfile)
         
         intext.length = num_read;
 
-        /* Handle case sensitivity */
-        if (config.insensitive)
-            lower_case(in_stream_buffer, num_read);
-
         if (config.lazy_replace)
             rpmod = MF_REPLACE_MODE_LAZY;
         
@@ -364,17 +355,6 @@ int replace_file (AC_TRIE_t *trie, const char *infile, const char *outfile)
     return 0;
 }
 
-/******************************************************************************
- * FUNCTION
- *****************************************************************************/
-
-void lower_case (char *s, size_t l)
-{
-    size_t i;
-    for(i = 0; i < l; i++)
-        s[i] = tolower(s[i]);
-}
-
 /******************************************************************************
  * FUNCTION
  *****************************************************************************/
@@ -45,7 +45,6 @@ struct program_config
     short output_show_pattern;  /* Pattern */
 };
 
-void lower_case (char *s, size_t l);
 void print_usage (char *progname);
 int  search_file (const char *filename, AC_TRIE_t *trie);
 int  replace_file (AC_TRIE_t *trie, const char *infile, const char *outfile);
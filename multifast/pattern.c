@@ -64,8 +64,8 @@ int pattern_load (const char *infile, AC_TRIE_t **ptrie)
     /* Initialize string memory */
     strmm_init (&strmem);
 
-    /* Initialize automata */
-    trie = ac_trie_create ();
+    /* Initialize automata; the library folds the case if it is asked to */
+    trie = config.insensitive ? ac_trie_create_nocase () : ac_trie_create ();
 
     /* Main loop to read patterns from pattern file */
     while ((readcount = fread((void*)buffer, 1, READ_BUFFER_SIZE, fd)) > 0)
@@ -99,9 +99,6 @@ int pattern_load (const char *infile, AC_TRIE_t **ptrie)
                 if (last_pattern.id.u.stringy == NULL)
                     pattern_genrep (&last_pattern.id.u.stringy);
                 
-                if (config.insensitive)
-                    lower_case(mytok->value, mytok->length);
-                
                 last_pattern.ptext.astring = mytok->value;
                 last_pattern.ptext.length = mytok->length;
                 pattern_makeacopy (&last_pattern.ptext.astring, 
@@ -0,0 +1,330 @@
+#include <iostream>
+#include <algorithm>
+#include "PatternSet.h"
+
+PatternSet::PatternSet(const unsigned char *map)
+{
+    m_mapped = (map != NULL);
+
+    for (unsigned int i = 0; i < AC_MAP_SIZE; i++)
+        m_map[i] = map ? map[i] : (unsigned char) i;
+}
+
+PatternSet::~PatternSet()
+{
+}
+
+/*
+ * Adds the pattern, unless it is empty or the same as another pattern
+ * under the map. Returns its id, or -1 if it is not added.
+ */
+long PatternSet::add (const std::string &pattern)
+{
+    if (pattern.empty())
+        return -1;
+
+    if (!m_keys.insert(mapped(pattern)).second)
+        return -1;
+
+    m_patterns.push_back(pattern);
+    m_present.push_back(true);
+
+    return (long) m_patterns.size() - 1;
+}
+
+void PatternSet::remove (long id)
+{
+    m_present[id] = false;
+    m_keys.erase(mapped(m_patterns[id]));
+}
+
+/*
+ * Adds up to count factors of the random string. Returns the number of the
+ * patterns added.
+ */
+long PatternSet::fill (RandomString &rs, size_t count, size_t minLen,
+        size_t maxLen)
+{
+    long added = 0;
+
+    for (size_t i = 0; i < count; i++)
+        if (add(rs.getFactor(minLen, maxLen)) >= 0)
+            added++;
+
+    return added;
+}
+
+/*
+ * Finds the patterns by comparing them at every position of the text. The
+ * matches are given by their end positions, and the longer patterns first
+ * at the same position.
+ */
+PatternMatches PatternSet::find (const std::string &text) const
+{
+    PatternMatches result;
+    std::vector<std::pair<size_t, long> > ending;
+    std::vector<std::string> keys;
+    std::string mtext = mapped(text);
+
+    for (size_t i = 0; i < m_patterns.size(); i++)
+        keys.push_back(mapped(m_patterns[i]));
+
+    for (size_t end = 1; end <= mtext.size(); end++)
+    {
+        ending.clear();
+
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            size_t len = keys[i].size();
+
+            if (m_present[i] && len <= end &&
+                    mtext.compare(end - len, len, keys[i]) == 0)
+                ending.push_back(std::make_pair(len, (long) i));
+        }
+
+        std::sort(ending.rbegin(), ending.rend());
+
+        for (size_t k = 0; k < ending.size(); k++)
+            result.push_back(PatternMatch(end, ending[k].second));
+    }
+
+    return result;
+}
+
+/*
+ * Makes a text of whole patterns, of their prefixes, which fail in the
+ * middle of the patterns, and of factors of the random string
+ */
+std::string PatternSet::makeText (RandomString &rs, size_t length) const
+{
+    std::string text;
+
+    while (text.size() < length)
+    {
+        const std::string &patt = m_patterns[rs.RandUInt(0, size() - 1)];
+
+        switch (rs.RandUInt(0, 2))
+        {
+        case 0:
+            text += patt;
+            break;
+        case 1:
+            text += patt.substr(0, rs.RandUInt(0, patt.size()));
+            break;
+        default:
+            text += rs.getFactor(1, 10);
+            break;
+        }
+    }
+
+    return text;
+}
+
+/*
+ * Creates an open trie with the present patterns; it is mapped by the map
+ * of the set, if it has any.
+ */
+AC_TRIE_t *PatternSet::makeTrie (void) const
+{
+    AC_TRIE_t *trie = m_mapped ?
+            ac_trie_create_mapped(m_map) : ac_trie_create();
+
+    for (size_t i = 0; i < m_patterns.size(); i++)
+        if (m_present[i])
+            addTo(trie, (long) i);
+
+    return trie;
+}
+
+AC_STATUS_t PatternSet::addTo (AC_TRIE_t *trie, long id) const
+{
+    AC_PATTERN_t patt;
+
+    patt.ptext.astring = m_patterns[id].c_str();
+    patt.ptext.length = m_patterns[id].size();
+    patt.rtext.astring = NULL;
+    patt.rtext.length = 0;
+    patt.id.u.number = id;
+    patt.id.type = AC_PATTID_TYPE_NUMBER;
+
+    return ac_trie_add (trie, &patt, 1);
+}
+
+AC_STATUS_t PatternSet::removeFrom (AC_TRIE_t *trie, long id) const
+{
+    AC_PATTERN_t patt;
+
+    patt.ptext.astring = m_patterns[id].c_str();
+    patt.ptext.length = m_patterns[id].size();
+    patt.rtext.astring = NULL;
+    patt.rtext.length = 0;
+    patt.id.u.number = id;
+    patt.id.type = AC_PATTID_TYPE_NUMBER;
+
+    return ac_trie_remove (trie, &patt);
+}
+
+std::string PatternSet::mapped (const std::string &str) const
+{
+    std::string result(str);
+
+    for (size_t i = 0; i < result.size(); i++)
+        result[i] = (char) m_map[(unsigned char) result[i]];
+
+    return result;
+}
+
+/*
+ * Collects the matches into the PatternMatches of the param
+ */
+int collectMatches (AC_MATCH_t *m, void *param)
+{
+    PatternMatches *matches = (PatternMatches *) param;
+
+    for (size_t j = 0; j < m->size; j++)
+        matches->push_back(PatternMatch(m->position,
+                m->patterns[j].id.u.number));
+
+    return 0;
+}
+
+PatternMatches searchWhole (AC_TRIE_t *trie, const std::string &text)
+{
+    PatternMatches matches;
+    AC_TEXT_t chunk;
+
+    chunk.astring = text.c_str();
+    chunk.length = text.size();
+
+    ac_trie_search (trie, &chunk, 0, collectMatches, &matches);
+
+    return matches;
+}
+
+/*
+ * Searches the text in chunks of random sizes, from one byte to maxChunk
+ */
+PatternMatches searchChunks (AC_TRIE_t *trie, const std::string &text,
+        RandomString &rs, size_t maxChunk)
+{
+    PatternMatches matches;
+    AC_TEXT_t chunk;
+    size_t offset = 0, size;
+
+    while (offset < text.size())
+    {
+        size = std::min((size_t) rs.RandUInt(1, maxChunk),
+                text.size() - offset);
+        chunk.astring = text.c_str() + offset;
+        chunk.length = size;
+
+        ac_trie_search (trie, &chunk, offset != 0, collectMatches, &matches);
+        offset += size;
+    }
+
+    return matches;
+}
+
+PatternMatches searchNext (AC_TRIE_t *trie, const std::string &text)
+{
+    PatternMatches matches;
+    AC_TEXT_t chunk;
+    AC_MATCH_t match;
+
+    chunk.astring = text.c_str();
+    chunk.length = text.size();
+
+    ac_trie_settext (trie, &chunk, 0);
+
+    while ((match = ac_trie_findnext(trie)).size)
+        collectMatches(&match, &matches);
+
+    return matches;
+}
+
+/*
+ * Searches the text in chunks of random sizes through a search payload,
+ * which keeps the state of the search out of the trie. The given payload
+ * is used again, if any; otherwise one is made for the search.
+ */
+PatternMatches searchPayload (AC_TRIE_t *trie, const std::string &text,
+        RandomString &rs, size_t maxChunk, AC_SEARCH_PAYLOAD_t *payload)
+{
+    PatternMatches matches;
+    AC_SEARCH_PAYLOAD_t *own = payload ?
+            NULL : ac_search_payload_create(trie, "");
+    size_t offset = 0, size;
+
+    if (own)
+        payload = own;
+
+    while (offset < text.size())
+    {
+        size = std::min((size_t) rs.RandUInt(1, maxChunk),
+                text.size() - offset);
+        payload->text->astring = text.c_str() + offset;
+        payload->text->length = size;
+
+        ac_trie_search_thread_safe (trie, payload, offset != 0,
+                collectMatches, &matches);
+        offset += size;
+    }
+
+    if (own)
+        ac_search_payload_release(own);
+
+    return matches;
+}
+
+/*
+ * Searches the texts as a batch; the matches of every text are collected
+ * apart.
+ */
+std::vector<PatternMatches> searchBatch (AC_TRIE_t *trie,
+        const std::vector<std::string> &texts)
+{
+    std::vector<PatternMatches> matches(texts.size());
+    std::vector<AC_TEXT_t> chunks(texts.size());
+    std::vector<void *> params(texts.size());
+
+    for (size_t i = 0; i < texts.size(); i++)
+    {
+        chunks[i].astring = texts[i].c_str();
+        chunks[i].length = texts[i].size();
+        params[i] = &matches[i];
+    }
+
+    ac_trie_search_batch (trie, chunks.data(), chunks.size(),
+            collectMatches, params.data());
+
+    return matches;
+}
+
+/*
+ * Compares the matches in their order. On a mismatch, tells what was
+ * searched and the first difference.
+ */
+bool sameMatches (const PatternMatches &expected,
+        const PatternMatches &found, const std::string &what)
+{
+    size_t i;
+
+    if (expected == found)
+        return true;
+
+    for (i = 0; i < expected.size() && i < found.size(); i++)
+        if (!(expected[i] == found[i]))
+            break;
+
+    std::cout << std::endl << what << ": expected " << expected.size()
+            << " matches, found " << found.size() << std::endl;
+
+    if (i < expected.size())
+        std::cout << "expected #" << i << ": pattern " << expected[i].id
+                << " ending at " << expected[i].position << std::endl;
+    if (i < found.size())
+        std::cout << "found #" << i << ": pattern " << found[i].id
+                << " ending at " << found[i].position << std::endl;
+
+    return false;
+}
@@ -0,0 +1,86 @@
+#ifndef PATTERNSET_H
+#define	PATTERNSET_H
+
+#include <vector>
+#include <string>
+#include <set>
+#include "RandomString.h"
+#include "ahocorasick.h"
+
+/*
+ * A match as the tests compare it: the end position of the match in the
+ * whole text and the id of the pattern.
+ */
+struct PatternMatch
+{
+    PatternMatch(size_t p, long i) : position(p), id(i) {};
+
+    bool operator==(const PatternMatch &r) const
+        { return position == r.position && id == r.id; };
+
+    size_t position;
+    long id;
+};
+
+typedef std::vector<PatternMatch> PatternMatches;
+
+/*
+ * The patterns of a test and the plain search of them, which the tests take
+ * as the expected result. The id of a pattern is its index; a removed
+ * pattern keeps its id, so the ids of the rest do not change.
+ */
+class PatternSet
+{
+public:
+
+    PatternSet(const unsigned char *map = NULL);
+    virtual ~PatternSet();
+
+    long add (const std::string &pattern);
+    void remove (long id);
+    bool has (long id) const { return m_present[id]; };
+    size_t size (void) const { return m_patterns.size(); };
+    const std::string & operator[] (long id) const { return m_patterns[id]; };
+
+    long fill (RandomString &rs, size_t count, size_t minLen, size_t maxLen);
+
+    PatternMatches find (const std::string &text) const;
+    std::string makeText (RandomString &rs, size_t length) const;
+
+    AC_TRIE_t *makeTrie (void) const;
+    AC_STATUS_t addTo (AC_TRIE_t *trie, long id) const;
+    AC_STATUS_t removeFrom (AC_TRIE_t *trie, long id) const;
+
+private:
+
+    std::string mapped (const std::string &str) const;
+
+private:
+
+    std::vector<std::string> m_patterns;
+    std::vector<bool> m_present;
+    std::set<std::string> m_keys;
+    unsigned char m_map[AC_MAP_SIZE];
+    bool m_mapped;
+};
+
+/*
+ * The ways of searching a finalized trie; all of them must give the matches
+ * of PatternSet::find() in the same order.
+ */
+PatternMatches searchWhole (AC_TRIE_t *trie, const std::string &text);
+PatternMatches searchChunks (AC_TRIE_t *trie, const std::string &text,
+        RandomString &rs, size_t maxChunk);
+PatternMatches searchNext (AC_TRIE_t *trie, const std::string &text);
+PatternMatches searchPayload (AC_TRIE_t *trie, const std::string &text,
+        RandomString &rs, size_t maxChunk,
+        AC_SEARCH_PAYLOAD_t *payload = NULL);
+std::vector<PatternMatches> searchBatch (AC_TRIE_t *trie,
+        const std::vector<std::string> &texts);
+
+int collectMatches (AC_MATCH_t *m, void *param);
+
+bool sameMatches (const PatternMatches &expected,
+        const PatternMatches &found, const std::string &what);
+
+#endif	/* PATTERNSET_H */
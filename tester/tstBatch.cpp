@@ -0,0 +1,64 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "RandomString.h"
+#include "PatternSet.h"
+#include "ahocorasick.h"
+
+/*
+ * Searches batches of texts, fewer and more than AC_SEARCH_BATCH_LANES and
+ * some of them empty, and compares the matches of every text with the ones
+ * of ac_trie_search() and of the plain search. The truncated tries have 
+ * tail patterns, which the batch searches one text after another.
+ */
+int main (int argc, char **argv)
+{
+    RandomString rs(200, 800, 6);
+    int j;
+    size_t i, count;
+    int options[4] = {AC_FINALIZE_DEFAULT, AC_FINALIZE_DFA, 
+            AC_FINALIZE_SPARSE | AC_FINALIZE_NO_PREFILTER, 
+            AC_FINALIZE_TRUNCATE};
+
+    std::cout << "Testing 'Batch'" << std::endl;
+
+    for (j = 0; j < 2000; j++)
+    {
+        PatternSet ps;
+        std::vector<std::string> texts;
+
+        rs.roll();
+        ps.fill(rs, rs.RandUInt(1, 60), 1, (j % 4 == 3) ? 40 : 8);
+
+        count = rs.RandUInt(0, 3 * AC_SEARCH_BATCH_LANES);
+        for (i = 0; i < count; i++)
+            texts.push_back(rs.RandUInt(0, 9) ? rs.roll().getString() : "");
+
+        AC_TRIE_t *trie = ps.makeTrie();
+        ac_trie_finalize_opt (trie, options[j % 4]);
+
+        std::vector<PatternMatches> found = searchBatch(trie, texts);
+
+        for (i = 0; i < count; i++)
+        {
+            if (!sameMatches(searchWhole(trie, texts[i]), found[i], 
+                        "batch vs search") ||
+                !sameMatches(ps.find(texts[i]), found[i], "batch"))
+            {
+                std::cout << "text " << i << " of " << count << ": " 
+                        << texts[i] << std::endl;
+                ac_trie_release (trie);
+                return -1;
+            }
+        }
+
+        ac_trie_release (trie);
+
+        if ((j + 1) % 100 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed" << std::endl;
+
+    return 0;
+}
@@ -5,7 +5,7 @@
 #include "SearchResult.h"
 #include "ahocorasick.h"
 
-AC_TRIE_t *loadTrie (const std::set<std::string> &sampleChunks);
+AC_TRIE_t *loadTrie (const std::set<std::string> &sampleChunks, int options);
 SearchResult searchMonoliticStr (AC_TRIE_t *trie, const std::string &input);
 SearchResult searchChunkedStr (AC_TRIE_t *trie, const std::string &input);
 
@@ -25,7 +25,8 @@ int main(int argc, char **argv)
     
     std::string input = rs.getString();
     
-    AC_TRIE_t *trie = loadTrie(sampleChunks);
+    AC_TRIE_t *trie = loadTrie(sampleChunks, AC_FINALIZE_SPARSE);
+    AC_TRIE_t *dfa_trie = loadTrie(sampleChunks, AC_FINALIZE_DFA);
     
     SearchResult sr1 = searchMonoliticStr(trie, input);
     
@@ -33,7 +34,7 @@ int main(int argc, char **argv)
     
     for (j = 0; j < 100000; j++)
     {
-        SearchResult sr2 = searchChunkedStr(trie, input);
+        SearchResult sr2 = searchChunkedStr((j % 2) ? dfa_trie : trie, input);
 
         if (sr1 == sr2)
         {
@@ -57,11 +58,12 @@ int main(int argc, char **argv)
     std::cout << " " << j << " Passed" << std::endl;
     
     ac_trie_release(trie);
+    ac_trie_release(dfa_trie);
     
     return 0;
 }
 
-AC_TRIE_t *loadTrie (const std::set<std::string> &sampleChunks)
+AC_TRIE_t *loadTrie (const std::set<std::string> &sampleChunks, int options)
 {
     unsigned int i = 0;
     AC_TRIE_t *trie = ac_trie_create();
@@ -82,7 +84,7 @@ AC_TRIE_t *loadTrie (const std::set<std::string> &sampleChunks)
         
         // std::cout << *it << " Added Successfully" << std::endl;
     }
-    ac_trie_finalize (trie);
+    ac_trie_finalize_opt (trie, options);
     
     return trie;
 }
@@ -0,0 +1,150 @@
+#include <iostream>
+#include <string>
+#include "RandomString.h"
+#include "PatternSet.h"
+#include "ahocorasick.h"
+
+bool removeSome (AC_TRIE_t *trie, PatternSet &ps, RandomString &rs);
+bool checkTrie (AC_TRIE_t *trie, const PatternSet &ps, RandomString &rs,
+        const std::string &what);
+bool checkStates (AC_TRIE_t *trie, const PatternSet &ps, int options,
+        const std::string &what);
+
+/*
+ * Removes patterns from open tries, which cuts their branches off, and
+ * from finalized tries, which flags them until the tries are rebuilt. The
+ * tries must match as the plain search of the patterns that are left. The
+ * open tries, and the compacted copies of the finalized ones, must have
+ * as many states as the tries built without the removed patterns.
+ */
+int main (int argc, char **argv)
+{
+    RandomString rs(1000, 3000, 8);
+    int j;
+    int options[6] = {AC_FINALIZE_DEFAULT, AC_FINALIZE_DFA,
+            AC_FINALIZE_SHIFT, AC_FINALIZE_SPARSE | AC_FINALIZE_NO_PREFILTER,
+            AC_FINALIZE_TRUNCATE, AC_FINALIZE_MINIMIZE};
+
+    std::cout << "Testing 'Compact'" << std::endl;
+
+    for (j = 0; j < 600; j++)
+    {
+        PatternSet ps;
+        size_t maxLen = (j % 6 >= 4) ? AC_TRUNCATE_DEPTH + 20 : 12;
+
+        rs.roll();
+        ps.fill(rs, rs.RandUInt(1, 300), 1, maxLen);
+
+        /* Remove from the open trie */
+        AC_TRIE_t *trie = ps.makeTrie();
+
+        if (!removeSome(trie, ps, rs))
+            return -1;
+
+        ac_trie_finalize_opt (trie, options[j % 6]);
+
+        if (!checkTrie(trie, ps, rs, "removed from the open trie") ||
+            !checkStates(trie, ps, options[j % 6], "open trie"))
+            return -1;
+
+        /* Remove from the finalized trie, then compact it */
+        PatternSet before(ps);
+
+        if (!removeSome(trie, ps, rs) ||
+            !checkTrie(trie, before, rs, "removed, not finalized yet"))
+            return -1;
+
+        ac_trie_finalize (trie);
+
+        if (!checkTrie(trie, ps, rs, "removed from the finalized trie"))
+            return -1;
+
+        AC_TRIE_t *compact = ac_trie_compact(trie);
+
+        if (!checkTrie(compact, ps, rs, "compacted") ||
+            !checkStates(compact, ps, options[j % 6], "compacted trie") ||
+            !checkTrie(trie, ps, rs, "after compacting"))
+            return -1;
+
+        ac_trie_release (compact);
+        ac_trie_release (trie);
+
+        if ((j + 1) % 30 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed" << std::endl;
+
+    return 0;
+}
+
+/*
+ * Removes every pattern by the chance of one in three; a pattern is
+ * removed twice, to fail the second time
+ */
+bool removeSome (AC_TRIE_t *trie, PatternSet &ps, RandomString &rs)
+{
+    for (long id = 0; id < (long) ps.size(); id++)
+    {
+        if (!ps.has(id) || rs.RandUInt(0, 2))
+            continue;
+
+        if (ps.removeFrom(trie, id) != ACERR_SUCCESS ||
+                ps.removeFrom(trie, id) != ACERR_PATTERN_NOT_FOUND)
+        {
+            std::cout << std::endl << "Removing " << ps[id] << " failed"
+                    << std::endl;
+            return false;
+        }
+        ps.remove(id);
+    }
+
+    return true;
+}
+
+/*
+ * Compares the matches of the trie with the plain search
+ */
+bool checkTrie (AC_TRIE_t *trie, const PatternSet &ps, RandomString &rs,
+        const std::string &what)
+{
+    std::string input = ps.makeText(rs, 2000);
+    PatternMatches expected = ps.find(input);
+
+    if (!sameMatches(expected, searchWhole(trie, input), what) ||
+        !sameMatches(expected, searchChunks(trie, input, rs, 30), what) ||
+        !sameMatches(expected, searchNext(trie, input), what) ||
+        !sameMatches(expected, searchPayload(trie, input, rs, 30), what))
+    {
+        std::cout << input << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/*
+ * Compares the states of the trie with a trie that is built of the
+ * patterns that are left
+ */
+bool checkStates (AC_TRIE_t *trie, const PatternSet &ps, int options,
+        const std::string &what)
+{
+    AC_TRIE_t *fresh = ps.makeTrie();
+    bool same;
+
+    ac_trie_finalize_opt (fresh, options);
+
+    same = trie->stats.states_count == fresh->stats.states_count &&
+            trie->patterns_count == fresh->patterns_count;
+
+    if (!same)
+        std::cout << std::endl << what << ": " << trie->stats.states_count
+                << " states of " << trie->patterns_count << " patterns, "
+                << fresh->stats.states_count << " states of "
+                << fresh->patterns_count << " built anew" << std::endl;
+
+    ac_trie_release (fresh);
+
+    return same;
+}
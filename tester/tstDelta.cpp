@@ -0,0 +1,327 @@
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include "RandomString.h"
+#include "PatternSet.h"
+#include "ahocorasick.h"
+
+bool changeTrie (AC_TRIE_t *trie, PatternSet &ps, RandomString &rs,
+        size_t adding, size_t maxLen, unsigned int removing);
+bool checkTrie (AC_TRIE_t *trie, const PatternSet &ps, RandomString &rs,
+        const std::string &what);
+void searchPart (AC_TRIE_t *trie, AC_SEARCH_PAYLOAD_t *payload,
+        const std::string &text, size_t from, size_t to, RandomString &rs,
+        PatternMatches &matches);
+size_t countFound (AC_TRIE_t *trie, const std::string &text, long id,
+        RandomString &rs);
+
+/*
+ * Adds patterns to and removes patterns from finalized tries. The changes
+ * are not searched until the tries are finalized again; then the tries
+ * must match as the plain search of the changed patterns, with every
+ * engine, the tails and the minimized tails.
+ *
+ * Then the patterns are changed in the middle of a search over chunks,
+ * through the trie and through a payload. The matches that end before the
+ * refresh are the ones of the former patterns, and the matches after it
+ * are the ones of the changed patterns.
+ * 
+ * Last, a single pattern is added, and another one is removed: the first 
+ * is not found and the second is found until the trie is finalized again,
+ * and the other way round after.
+ */
+int main (int argc, char **argv)
+{
+    RandomString rs(1000, 3000, 8);
+    int j, round;
+    int options[6] = {AC_FINALIZE_DEFAULT, AC_FINALIZE_DFA,
+            AC_FINALIZE_SHIFT, AC_FINALIZE_SPARSE | AC_FINALIZE_NO_PREFILTER,
+            AC_FINALIZE_TRUNCATE, AC_FINALIZE_MINIMIZE};
+
+    std::cout << "Testing 'Delta'" << std::endl;
+
+    for (j = 0; j < 600; j++)
+    {
+        PatternSet ps;
+        size_t maxLen = (j % 6 >= 4) ? AC_TRUNCATE_DEPTH + 20 : 12;
+
+        rs.roll();
+        ps.fill(rs, rs.RandUInt(1, 300), 1, maxLen);
+
+        AC_TRIE_t *trie = ps.makeTrie();
+        ac_trie_finalize_opt (trie, options[j % 6]);
+
+        for (round = 0; round < 3; round++)
+        {
+            PatternSet before(ps);
+
+            /* A few patterns, or as many as the trie has, to make the
+             * delta merge */
+            if (!changeTrie(trie, ps, rs, rs.RandUInt(1, (j % 5 == 0) ?
+                    1000 : 10), maxLen, 4))
+                return -1;
+
+            if (!checkTrie(trie, before, rs, "not finalized yet"))
+                return -1;
+
+            ac_trie_finalize (trie);
+
+            if (!checkTrie(trie, ps, rs, "finalized again"))
+                return -1;
+        }
+
+        ac_trie_release (trie);
+
+        if ((j + 1) % 30 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed" << std::endl;
+
+    std::cout << "Testing 'Delta' across a refresh" << std::endl;
+
+    for (j = 0; j < 600; j++)
+    {
+        PatternSet ps;
+        PatternMatches expected, found, viaPayload;
+        size_t maxLen = (j % 6 >= 4) ? AC_TRUNCATE_DEPTH + 20 : 12;
+
+        /* Enough states that a few changes do not merge the delta */
+        rs.roll();
+        ps.fill(rs, 200, 4, maxLen);
+
+        AC_TRIE_t *trie = ps.makeTrie();
+        ac_trie_finalize_opt (trie, options[j % 6]);
+
+        /* The search keeps the bytes for the delta from its start */
+        if (!changeTrie(trie, ps, rs, 1, maxLen, 0))
+            return -1;
+        ac_trie_finalize (trie);
+
+        PatternSet before(ps);
+        std::string input = ps.makeText(rs, 3000);
+        size_t boundary = rs.RandUInt(0, input.size());
+        AC_SEARCH_PAYLOAD_t *payload = ac_search_payload_create(trie, "");
+
+        searchPart(trie, NULL, input, 0, boundary, rs, found);
+        searchPart(trie, payload, input, 0, boundary, rs, viaPayload);
+
+        if (!changeTrie(trie, ps, rs, rs.RandUInt(1, 4), maxLen, 50))
+            return -1;
+        ac_trie_finalize (trie);
+
+        searchPart(trie, NULL, input, boundary, input.size(), rs, found);
+        searchPart(trie, payload, input, boundary, input.size(), rs,
+                viaPayload);
+
+        PatternMatches former = before.find(input);
+        PatternMatches latter = ps.find(input);
+
+        for (size_t i = 0; i < former.size(); i++)
+            if (former[i].position <= boundary)
+                expected.push_back(former[i]);
+        for (size_t i = 0; i < latter.size(); i++)
+            if (latter[i].position > boundary)
+                expected.push_back(latter[i]);
+
+        if (!sameMatches(expected, found, "across a refresh") ||
+            !sameMatches(expected, viaPayload, "payload across a refresh"))
+        {
+            std::cout << "refreshed at " << boundary << std::endl;
+            std::cout << input << std::endl;
+            return -1;
+        }
+
+        ac_search_payload_release (payload);
+        ac_trie_release (trie);
+
+        if ((j + 1) % 30 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed" << std::endl;
+
+    std::cout << "Testing 'Delta' by one pattern" << std::endl;
+
+    for (j = 0; j < 600; j++)
+    {
+        PatternSet ps;
+        size_t maxLen = (j % 6 >= 4) ? AC_TRUNCATE_DEPTH + 20 : 12;
+
+        rs.roll();
+        ps.fill(rs, rs.RandUInt(1, 300), 1, maxLen);
+
+        AC_TRIE_t *trie = ps.makeTrie();
+        ac_trie_finalize_opt (trie, options[j % 6]);
+
+        /* The added pattern has bytes that the others do not have */
+        long added = ps.add("<" + rs.getFactor(1, maxLen) + ">");
+        long removed = rs.RandUInt(0, ps.size() - 2);
+        std::string input = ps.makeText(rs, 500) + ps[added] +
+                ps.makeText(rs, 500) + ps[removed] + ps.makeText(rs, 500);
+
+        if (ps.addTo(trie, added) != ACERR_SUCCESS ||
+            ps.removeFrom(trie, removed) != ACERR_SUCCESS)
+        {
+            std::cout << "Changing " << ps[added] << " and " << ps[removed]
+                    << " failed" << std::endl;
+            return -1;
+        }
+
+        if (countFound(trie, input, added, rs) != 0 ||
+            countFound(trie, input, removed, rs) == 0)
+        {
+            std::cout << ps[added] << " is found, or " << ps[removed]
+                    << " is not, before finalizing" << std::endl;
+            return -1;
+        }
+
+        ac_trie_finalize (trie);
+
+        if (countFound(trie, input, added, rs) == 0 ||
+            countFound(trie, input, removed, rs) != 0)
+        {
+            std::cout << ps[added] << " is not found, or " << ps[removed]
+                    << " is, after finalizing" << std::endl;
+            return -1;
+        }
+
+        ac_trie_release (trie);
+
+        if ((j + 1) % 30 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed" << std::endl;
+
+    return 0;
+}
+
+/*
+ * Adds up to the given number of patterns to the finalized trie, and
+ * removes every pattern by the chance of one in @p removing, or none if it
+ * is 0. A pattern is removed twice, and added twice, to fail the second
+ * time.
+ */
+bool changeTrie (AC_TRIE_t *trie, PatternSet &ps, RandomString &rs,
+        size_t adding, size_t maxLen, unsigned int removing)
+{
+    long id;
+
+    for (size_t i = 0; i < adding; i++)
+    {
+        if ((id = ps.add(rs.getFactor(1, maxLen))) < 0)
+            continue;
+
+        if (ps.addTo(trie, id) != ACERR_SUCCESS ||
+                ps.addTo(trie, id) != ACERR_DUPLICATE_PATTERN)
+        {
+            std::cout << std::endl << "Adding " << ps[id] << " failed"
+                    << std::endl;
+            return false;
+        }
+    }
+
+    for (id = 0; removing && id < (long) ps.size(); id++)
+    {
+        if (!ps.has(id) || rs.RandUInt(1, removing) != 1)
+            continue;
+
+        if (ps.removeFrom(trie, id) != ACERR_SUCCESS ||
+                ps.removeFrom(trie, id) != ACERR_PATTERN_NOT_FOUND)
+        {
+            std::cout << std::endl << "Removing " << ps[id] << " failed"
+                    << std::endl;
+            return false;
+        }
+        ps.remove(id);
+    }
+
+    return true;
+}
+
+/*
+ * Compares the matches of the trie with the plain search in every way of
+ * searching
+ */
+bool checkTrie (AC_TRIE_t *trie, const PatternSet &ps, RandomString &rs,
+        const std::string &what)
+{
+    std::vector<std::string> texts;
+
+    for (size_t i = rs.RandUInt(1, 10); i > 0; i--)
+        texts.push_back(ps.makeText(rs, rs.RandUInt(1, 600)));
+
+    std::string &input = texts[0];
+    PatternMatches expected = ps.find(input);
+    std::vector<PatternMatches> batch = searchBatch(trie, texts);
+
+    if (!sameMatches(expected, searchWhole(trie, input), what) ||
+        !sameMatches(expected, searchChunks(trie, input, rs, 30), what) ||
+        !sameMatches(expected, searchNext(trie, input), what) ||
+        !sameMatches(expected, searchPayload(trie, input, rs, 30), what))
+    {
+        std::cout << input << std::endl;
+        return false;
+    }
+
+    for (size_t i = 0; i < texts.size(); i++)
+        if (!sameMatches(ps.find(texts[i]), batch[i], what + ", batch"))
+            return false;
+
+    return true;
+}
+
+/*
+ * Searches the text from one position to another in chunks of random
+ * sizes, through the payload if one is given, and otherwise through the
+ * trie. The search starts over at the beginning of the text.
+ */
+void searchPart (AC_TRIE_t *trie, AC_SEARCH_PAYLOAD_t *payload,
+        const std::string &text, size_t from, size_t to, RandomString &rs,
+        PatternMatches &matches)
+{
+    AC_TEXT_t chunk;
+    size_t size;
+
+    while (from < to)
+    {
+        size = std::min((size_t) rs.RandUInt(1, 40), to - from);
+        chunk.astring = text.c_str() + from;
+        chunk.length = size;
+
+        if (payload)
+        {
+            *payload->text = chunk;
+            ac_trie_search_thread_safe (trie, payload, from != 0,
+                    collectMatches, &matches);
+        }
+        else
+            ac_trie_search (trie, &chunk, from != 0, collectMatches,
+                    &matches);
+
+        from += size;
+    }
+}
+
+/*
+ * Counts the matches of the pattern in the text, searched whole, in chunks
+ * and by findnext, and fails the count if they do not agree
+ */
+size_t countFound (AC_TRIE_t *trie, const std::string &text, long id,
+        RandomString &rs)
+{
+    PatternMatches ways[3] = {searchWhole(trie, text),
+            searchChunks(trie, text, rs, 30), searchNext(trie, text)};
+    size_t counts[3] = {0, 0, 0};
+
+    for (size_t i = 0; i < 3; i++)
+        for (size_t k = 0; k < ways[i].size(); k++)
+            if (ways[i][k].id == id)
+                counts[i]++;
+
+    if (counts[1] != counts[0] || counts[2] != counts[0])
+        return (size_t) -1;
+
+    return counts[0];
+}
@@ -40,8 +40,9 @@ AC_TRIE_t * buildTrie(size_t pattern_nr)
         patt.id.u.number = i + 1;
         patt.id.type = AC_PATTID_TYPE_NUMBER;
         
-        /* Add pattern to automata */
-        if (ac_trie_add (trie, &patt, 0) == ACERR_SUCCESS) {
+        /* Add pattern to automata; the string of rs is rolled over, so it
+         * is copied */
+        if (ac_trie_add (trie, &patt, 1) == ACERR_SUCCESS) {
             // std::cout << rs.getString() << " - Added Successfully" << std::endl;
             if ((i + 1) % 8000 == 0)
                 std::cout << " " << i + 1 << " Added" << std::endl;
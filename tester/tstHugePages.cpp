@@ -0,0 +1,76 @@
+#include <iostream>
+#include <string>
+#include "RandomString.h"
+#include "PatternSet.h"
+#include "ahocorasick.h"
+
+/*
+ * Maps the search structures on huge pages and warms them up, with and 
+ * without locking them, and compares the matches with the ones of the same
+ * trie finalized without huge pages and with the plain search. The big 
+ * pattern sets make structures of a few huge pages; where huge pages are 
+ * not available, the trie falls back to the normal pages.
+ */
+int main (int argc, char **argv)
+{
+    RandomString rs(20000, 40000, 26);
+    int j, ret;
+    int options[4] = {AC_FINALIZE_DEFAULT, AC_FINALIZE_DFA,
+            AC_FINALIZE_SHIFT, AC_FINALIZE_MINIMIZE};
+
+    std::cout << "Testing 'Huge Pages'" << std::endl;
+
+    for (j = 0; j < 40; j++)
+    {
+        PatternSet ps;
+        std::string input = rs.roll().getString();
+        bool big = (j % 2 == 0);
+
+        ps.fill(rs, big ? 20000 : rs.RandUInt(10, 200), 8, 
+                (j % 4 == 3) ? 40 : 12);
+
+        AC_TRIE_t *trie = ps.makeTrie();
+        AC_TRIE_t *plain = ps.makeTrie();
+
+        if (ac_trie_warmup(trie, 0) != -1)
+        {
+            std::cout << std::endl << "An open trie is warmed up" 
+                    << std::endl;
+            return -1;
+        }
+
+        ac_trie_finalize_opt (trie, options[j % 4] | AC_FINALIZE_HUGE_PAGES);
+        ac_trie_finalize_opt (plain, options[j % 4]);
+
+        ret = ac_trie_warmup(trie, j % 3 == 0);
+        if (ret != 0 && !(ret == -2 && j % 3 == 0))
+        {
+            std::cout << std::endl << "Warming up failed: " << ret 
+                    << std::endl;
+            return -1;
+        }
+
+        PatternMatches expected = searchWhole(plain, input);
+
+        if ((!big && !sameMatches(ps.find(input), expected, "plain")) ||
+            !sameMatches(expected, searchWhole(trie, input), "whole") ||
+            !sameMatches(expected, searchChunks(trie, input, rs, 500),
+                    "chunks") ||
+            !sameMatches(expected, searchPayload(trie, input, rs, 500),
+                    "payload"))
+        {
+            ac_trie_release (trie);
+            ac_trie_release (plain);
+            return -1;
+        }
+
+        ac_trie_release (trie);
+        ac_trie_release (plain);
+
+        std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed" << std::endl;
+
+    return 0;
+}
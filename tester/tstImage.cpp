@@ -0,0 +1,174 @@
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <cstdio>
+#include "RandomString.h"
+#include "PatternSet.h"
+#include "ahocorasick.h"
+
+static const char *imagePath = "tstImage.bin";
+
+std::string readFile (const char *path);
+void writeFile (const char *path, const std::string &data);
+
+/*
+ * Saves finalized tries of every kind and loads them back, with and without
+ * verifying them; the loaded tries must match as the saved ones. Then the 
+ * image is damaged: a byte of the patterns is changed, which only the 
+ * verification finds, and the file is cut short, which loading always 
+ * finds. Last, random bytes of the image are changed: the indices are 
+ * range checked even without verifying, so the image either fails to load
+ * or is searched without reading out of bounds.
+ */
+int main (int argc, char **argv)
+{
+    RandomString rs(1000, 3000, 8);
+    int j, damaged = 0;
+    size_t i, pos;
+    int options[6] = {AC_FINALIZE_DEFAULT, AC_FINALIZE_DFA, 
+            AC_FINALIZE_SHIFT, AC_FINALIZE_SPARSE | AC_FINALIZE_NO_PREFILTER,
+            AC_FINALIZE_TRUNCATE, AC_FINALIZE_MINIMIZE};
+
+    std::cout << "Testing 'Image'" << std::endl;
+
+    if (ac_trie_load("tstImage.none", 0) != NULL)
+    {
+        std::cout << "A missing file is loaded" << std::endl;
+        return -1;
+    }
+
+    for (j = 0; j < 300; j++)
+    {
+        PatternSet ps;
+        size_t maxLen = (j % 6 >= 4) ? AC_TRUNCATE_DEPTH + 20 : 10;
+
+        rs.roll();
+        ps.fill(rs, rs.RandUInt(1, 80), 1, maxLen);
+
+        /* A pattern that is not found elsewhere in the image, to change */
+        long marked = ps.add("{image}" + rs.getFactor(1, 8));
+
+        AC_TRIE_t *trie = ps.makeTrie();
+        ac_trie_finalize_opt (trie, options[j % 6]);
+
+        /* Every other image has patterns added after finalizing, which are
+         * merged when saving */
+        if (j % 2)
+            for (i = rs.RandUInt(1, 5); i > 0; i--)
+            {
+                long id = ps.add(rs.getFactor(1, maxLen));
+                if (id >= 0)
+                    ps.addTo(trie, id);
+            }
+
+        if (ac_trie_save(trie, imagePath) != 0)
+        {
+            std::cout << std::endl << "Saving failed" << std::endl;
+            return -1;
+        }
+
+        std::string input = ps.makeText(rs, 2000);
+        PatternMatches expected = ps.find(input);
+
+        AC_TRIE_t *loaded = ac_trie_load(imagePath, j % 3 == 0);
+
+        if (!loaded || 
+            ac_trie_engine(loaded) != ac_trie_engine(trie) ||
+            ac_trie_prefilter(loaded) != ac_trie_prefilter(trie) ||
+            !sameMatches(expected, searchWhole(trie, input), "saved") ||
+            !sameMatches(expected, searchWhole(loaded, input), "whole") ||
+            !sameMatches(expected, searchChunks(loaded, input, rs, 30),
+                    "chunks") ||
+            !sameMatches(expected, searchNext(loaded, input), "findnext") ||
+            !sameMatches(expected, searchPayload(loaded, input, rs, 30),
+                    "payload"))
+        {
+            std::cout << "Loading failed" << std::endl;
+            return -1;
+        }
+
+        ac_trie_release (loaded);
+        ac_trie_release (trie);
+
+        std::string image = readFile(imagePath);
+
+        /* Change a byte of the text of the marked pattern */
+        pos = image.rfind(ps[marked]);
+        if (pos == std::string::npos)
+        {
+            std::cout << std::endl << "No pattern in the image" << std::endl;
+            return -1;
+        }
+        image[pos] ^= 0x20;
+        writeFile(imagePath, image);
+
+        if (ac_trie_load(imagePath, 1) != NULL)
+        {
+            std::cout << std::endl << "A changed image is verified" 
+                    << std::endl;
+            return -1;
+        }
+        if ((loaded = ac_trie_load(imagePath, 0)) == NULL)
+        {
+            std::cout << std::endl << "A changed section is checked without"
+                    " verifying" << std::endl;
+            return -1;
+        }
+        ac_trie_release (loaded);
+
+        /* Cut the image short, in the header or in the sections */
+        image[pos] ^= 0x20;
+        writeFile(imagePath, image.substr(0, rs.RandUInt(0, 
+                image.size() - 1)));
+
+        if (ac_trie_load(imagePath, 0) != NULL || 
+                ac_trie_load(imagePath, 1) != NULL)
+        {
+            std::cout << std::endl << "A truncated image is loaded" 
+                    << std::endl;
+            return -1;
+        }
+
+        /* Change a few random bytes, and search what loads anyway */
+        for (i = rs.RandUInt(1, 4); i > 0; i--)
+            image[rs.RandUInt(0, image.size() - 1)] ^= 
+                    (char) rs.RandUInt(1, 255);
+        writeFile(imagePath, image);
+
+        if ((loaded = ac_trie_load(imagePath, 0)) != NULL)
+        {
+            searchWhole(loaded, input);
+            searchChunks(loaded, input, rs, 30);
+            searchNext(loaded, input);
+            ac_trie_release (loaded);
+        }
+        else
+            damaged++;
+
+        if ((j + 1) % 15 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::remove(imagePath);
+
+    std::cout << " " << j << " Passed, " << damaged 
+            << " damaged images refused" << std::endl;
+
+    return 0;
+}
+
+std::string readFile (const char *path)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    return std::string(std::istreambuf_iterator<char>(file),
+            std::istreambuf_iterator<char>());
+}
+
+void writeFile (const char *path, const std::string &data)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    file.write(data.data(), data.size());
+}
@@ -0,0 +1,153 @@
+#include <iostream>
+#include <string>
+#include <cctype>
+#include "RandomString.h"
+#include "PatternSet.h"
+#include "ahocorasick.h"
+
+bool checkTrie (AC_TRIE_t *trie, const PatternSet &ps, RandomString &rs,
+        const std::string &what);
+
+/*
+ * Searches tries with a user map that folds pairs of letters and the lower
+ * case letters together, with the engines, the tails and the minimized 
+ * tails. Then patterns are added to and removed from the finalized tries, 
+ * so the delta goes through the map too, and the tries are searched again 
+ * after finalizing them. A pattern that is the same as another under the 
+ * map is a duplicate, in the trie and in its delta.
+ */
+int main (int argc, char **argv)
+{
+    RandomString rs(1000, 3000, 8);
+    unsigned char map[AC_MAP_SIZE];
+    int j, round;
+    size_t i;
+    long id;
+    int options[6] = {AC_FINALIZE_DEFAULT, AC_FINALIZE_DFA, 
+            AC_FINALIZE_SHIFT, AC_FINALIZE_SPARSE | AC_FINALIZE_NO_PREFILTER,
+            AC_FINALIZE_TRUNCATE, AC_FINALIZE_MINIMIZE};
+
+    for (i = 0; i < AC_MAP_SIZE; i++)
+        map[i] = (unsigned char) i;
+    for (i = 'A'; i <= 'Z'; i++)
+        map[i] = map[i - 'A' + 'a'] = (unsigned char) ('A' + (i - 'A') / 2);
+
+    std::cout << "Testing 'Mapped'" << std::endl;
+
+    for (j = 0; j < 600; j++)
+    {
+        PatternSet ps(map);
+        size_t maxLen = (j % 6 >= 4) ? AC_TRUNCATE_DEPTH + 20 : 10;
+
+        rs.roll();
+        for (i = rs.RandUInt(1, 60); i > 0; i--)
+            ps.add(rs.getFactor(1, maxLen));
+
+        AC_TRIE_t *trie = ps.makeTrie();
+        ac_trie_finalize_opt (trie, options[j % 6]);
+
+        if (!checkTrie(trie, ps, rs, "finalized"))
+            return -1;
+
+        for (round = 0; round < 2; round++)
+        {
+            /* A few patterns, or as many as the trie has, to make the 
+             * delta merge */
+            for (i = rs.RandUInt(1, (j % 5 == 0) ? 3000 : 10); i > 0; i--)
+            {
+                std::string patt = rs.getFactor(1, maxLen);
+                std::string twin(patt);
+
+                twin[0] = (char) tolower((unsigned char) twin[0]);
+                if ((id = ps.add(patt)) >= 0)
+                {
+                    if (ps.addTo(trie, id) != ACERR_SUCCESS)
+                    {
+                        std::cout << std::endl << "Adding " << patt 
+                                << " failed" << std::endl;
+                        return -1;
+                    }
+                }
+                else if (ps.add(twin) < 0)
+                {
+                    AC_PATTERN_t dup;
+                    dup.ptext.astring = twin.c_str();
+                    dup.ptext.length = twin.size();
+                    dup.rtext.astring = NULL;
+                    dup.rtext.length = 0;
+                    dup.id.u.number = -1;
+                    dup.id.type = AC_PATTID_TYPE_NUMBER;
+
+                    if (ac_trie_add(trie, &dup, 1) != 
+                            ACERR_DUPLICATE_PATTERN)
+                    {
+                        std::cout << std::endl << twin 
+                                << " is not a duplicate" << std::endl;
+                        return -1;
+                    }
+                }
+            }
+
+            for (id = 0; id < (long) ps.size(); id++)
+            {
+                if (!ps.has(id) || rs.RandUInt(0, 4))
+                    continue;
+                if (ps.removeFrom(trie, id) != ACERR_SUCCESS)
+                {
+                    std::cout << std::endl << "Removing " << ps[id] 
+                            << " failed" << std::endl;
+                    return -1;
+                }
+                ps.remove(id);
+                if (ps.removeFrom(trie, id) != ACERR_PATTERN_NOT_FOUND)
+                {
+                    std::cout << std::endl << ps[id] << " is removed twice"
+                            << std::endl;
+                    return -1;
+                }
+            }
+
+            ac_trie_finalize (trie);
+
+            if (!checkTrie(trie, ps, rs, "finalized again"))
+                return -1;
+        }
+
+        ac_trie_release (trie);
+
+        if ((j + 1) % 30 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed" << std::endl;
+
+    return 0;
+}
+
+/*
+ * Compares the matches of the trie with the plain search, on a text of the
+ * patterns in mixed case
+ */
+bool checkTrie (AC_TRIE_t *trie, const PatternSet &ps, RandomString &rs,
+        const std::string &what)
+{
+    std::string input = ps.makeText(rs, 2000);
+
+    for (size_t i = 0; i < input.size(); i++)
+        if (rs.RandUInt(0, 1))
+            input[i] = (char) tolower((unsigned char) input[i]);
+
+    PatternMatches expected = ps.find(input);
+
+    if (!sameMatches(expected, searchWhole(trie, input), what) ||
+        !sameMatches(expected, searchChunks(trie, input, rs, 30), what) ||
+        !sameMatches(expected, searchNext(trie, input), what) ||
+        !sameMatches(expected, searchPayload(trie, input, rs, 30), what))
+    {
+        std::cout << input << std::endl;
+        ac_trie_release (trie);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,67 @@
+#include <iostream>
+#include <string>
+#include "RandomString.h"
+#include "PatternSet.h"
+#include "ahocorasick.h"
+
+/*
+ * Forces the memmem prefilter with one to four patterns. Every other text
+ * ends with one of the patterns, and the texts are also searched in chunks,
+ * so the patterns end at the very end of the text and of the chunks.
+ */
+int main (int argc, char **argv)
+{
+    RandomString rs(100, 4000, 8);
+    int j;
+    int options[3] = {AC_FINALIZE_DEFAULT, AC_FINALIZE_DFA, 
+            AC_FINALIZE_SPARSE};
+
+    std::cout << "Testing 'Memmem'" << std::endl;
+
+    for (j = 0; j < 3000; j++)
+    {
+        PatternSet ps;
+        std::string input = rs.roll().getString();
+        size_t count = rs.RandUInt(1, 4);
+
+        while (ps.size() < count)
+            ps.add(rs.getFactor(2, 2 + j % 40));
+
+        if (j % 2)
+            input += ps[rs.RandUInt(0, count - 1)];
+
+        AC_TRIE_t *trie = ps.makeTrie();
+        ac_trie_finalize_opt (trie, options[j % 3]);
+
+        if (ac_trie_prefilter(trie) != AC_PREFILTER_MEMMEM)
+        {
+            std::cout << std::endl << "The memmem prefilter is not used"
+                    << std::endl;
+            ac_trie_release (trie);
+            return -1;
+        }
+
+        PatternMatches expected = ps.find(input);
+
+        if (!sameMatches(expected, searchWhole(trie, input), "whole") ||
+            !sameMatches(expected, searchChunks(trie, input, rs, 50),
+                    "chunks") ||
+            !sameMatches(expected, searchNext(trie, input), "findnext") ||
+            !sameMatches(expected, searchPayload(trie, input, rs, 50),
+                    "payload"))
+        {
+            std::cout << input << std::endl;
+            ac_trie_release (trie);
+            return -1;
+        }
+
+        ac_trie_release (trie);
+
+        if ((j + 1) % 100 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed" << std::endl;
+
+    return 0;
+}
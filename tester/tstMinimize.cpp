@@ -0,0 +1,76 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cctype>
+#include "RandomString.h"
+#include "PatternSet.h"
+#include "ahocorasick.h"
+
+/*
+ * Minimizes the tails of truncated tries, with patterns that share their
+ * suffixes so the graph merges them, and compares the matches with the 
+ * ones of the same trie truncated without minimizing: the same patterns 
+ * must be reported in the same order. Every other trie is mapped.
+ */
+int main (int argc, char **argv)
+{
+    RandomString rs(2000, 3000, 4);
+    unsigned char map[AC_MAP_SIZE];
+    std::vector<std::string> suffixes;
+    int j;
+    size_t i;
+
+    for (i = 0; i < AC_MAP_SIZE; i++)
+        map[i] = (unsigned char) toupper((int) i);
+
+    std::cout << "Testing 'Minimize'" << std::endl;
+
+    for (j = 0; j < 1000; j++)
+    {
+        PatternSet ps((j % 2) ? map : NULL);
+
+        rs.roll();
+        suffixes.clear();
+        for (i = rs.RandUInt(1, 6); i > 0; i--)
+            suffixes.push_back(rs.getFactor(1, 30));
+
+        for (i = rs.RandUInt(1, 80); i > 0; i--)
+            ps.add(rs.getFactor(1, AC_TRUNCATE_DEPTH + 10) + 
+                    suffixes[rs.RandUInt(0, suffixes.size() - 1)]);
+
+        std::string input = ps.makeText(rs, 3000);
+
+        AC_TRIE_t *trie = ps.makeTrie();
+        AC_TRIE_t *truncated = ps.makeTrie();
+        ac_trie_finalize_opt (trie, AC_FINALIZE_MINIMIZE | 
+                ((j % 4 < 2) ? AC_FINALIZE_SPARSE : AC_FINALIZE_DFA));
+        ac_trie_finalize_opt (truncated, AC_FINALIZE_TRUNCATE | 
+                ((j % 4 < 2) ? AC_FINALIZE_SPARSE : AC_FINALIZE_DFA));
+
+        PatternMatches expected = searchWhole(truncated, input);
+
+        if (!sameMatches(ps.find(input), expected, "truncated") ||
+            !sameMatches(expected, searchWhole(trie, input), "whole") ||
+            !sameMatches(expected, searchChunks(trie, input, rs, 
+                    AC_TRUNCATE_DEPTH), "chunks") ||
+            !sameMatches(expected, searchNext(trie, input), "findnext") ||
+            !sameMatches(expected, searchPayload(trie, input, rs, 
+                    AC_TRUNCATE_DEPTH), "payload"))
+        {
+            std::cout << input << std::endl;
+            ac_trie_release (trie);
+            ac_trie_release (truncated);
+            return -1;
+        }
+
+        ac_trie_release (trie);
+        ac_trie_release (truncated);
+
+        if ((j + 1) % 50 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <string>
+#include <cctype>
+#include "RandomString.h"
+#include "PatternSet.h"
+#include "ahocorasick.h"
+
+std::string mixCase (const std::string &str, RandomString &rs);
+
+/*
+ * Searches tries that ignore the case, with the patterns and the text in
+ * mixed case, and with the bytes next to the letters ('@', '[', '`' and
+ * '{'), which must not be folded. Every engine and prefilter is forced in
+ * turn. A pattern that differs from another only in case is a duplicate.
+ */
+int main (int argc, char **argv)
+{
+    RandomString rs(1000, 3000, 6);
+    unsigned char map[AC_MAP_SIZE];
+    int j;
+    size_t i;
+    int options[6] = {AC_FINALIZE_DEFAULT, AC_FINALIZE_DFA, 
+            AC_FINALIZE_SHIFT, AC_FINALIZE_SPARSE | AC_FINALIZE_NO_PREFILTER,
+            AC_FINALIZE_TRUNCATE, AC_FINALIZE_MINIMIZE};
+
+    for (i = 0; i < AC_MAP_SIZE; i++)
+        map[i] = (i >= 'A' && i <= 'Z') ? i - 'A' + 'a' : i;
+
+    std::cout << "Testing 'Nocase'" << std::endl;
+
+    for (j = 0; j < 1200; j++)
+    {
+        PatternSet ps(map);
+        std::string input;
+        long id;
+
+        rs.roll();
+        for (i = rs.RandUInt(1, 80); i > 0; i--)
+            ps.add(mixCase(rs.getFactor(1, (j % 6 >= 4) ? 40 : 10), rs));
+
+        input = mixCase(ps.makeText(rs, 2000), rs);
+
+        AC_TRIE_t *trie = ac_trie_create_nocase();
+        for (id = 0; id < (long) ps.size(); id++)
+            ps.addTo(trie, id);
+
+        std::string twin(ps[0]);
+        for (i = 0; i < twin.size(); i++)
+            twin[i] = isupper((unsigned char) twin[i]) ? 
+                    tolower((unsigned char) twin[i]) : 
+                    toupper((unsigned char) twin[i]);
+
+        AC_PATTERN_t patt;
+        patt.ptext.astring = twin.c_str();
+        patt.ptext.length = twin.size();
+        patt.rtext.astring = NULL;
+        patt.rtext.length = 0;
+        patt.id.u.number = -1;
+        patt.id.type = AC_PATTID_TYPE_NUMBER;
+
+        if (ac_trie_add(trie, &patt, 1) != ACERR_DUPLICATE_PATTERN)
+        {
+            std::cout << std::endl << twin << " is not a duplicate of " 
+                    << ps[0] << std::endl;
+            ac_trie_release (trie);
+            return -1;
+        }
+
+        ac_trie_finalize_opt (trie, options[j % 6]);
+
+        PatternMatches expected = ps.find(input);
+
+        if (!sameMatches(expected, searchWhole(trie, input), "whole") ||
+            !sameMatches(expected, searchChunks(trie, input, rs, 30),
+                    "chunks") ||
+            !sameMatches(expected, searchNext(trie, input), "findnext") ||
+            !sameMatches(expected, searchPayload(trie, input, rs, 30),
+                    "payload"))
+        {
+            std::cout << input << std::endl;
+            ac_trie_release (trie);
+            return -1;
+        }
+
+        ac_trie_release (trie);
+
+        if ((j + 1) % 60 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed" << std::endl;
+
+    return 0;
+}
+
+/*
+ * Turns some letters to lower case, and some to the bytes that are next to
+ * the letters but are not letters
+ */
+std::string mixCase (const std::string &str, RandomString &rs)
+{
+    static const char neighbours[] = "@[`{";
+    std::string result(str);
+
+    for (size_t i = 0; i < result.size(); i++)
+    {
+        switch (rs.RandUInt(0, 9))
+        {
+        case 0:
+            result[i] = neighbours[rs.RandUInt(0, 3)];
+            break;
+        case 1: case 2: case 3: case 4:
+            result[i] = (char) tolower((unsigned char) result[i]);
+            break;
+        default:
+            break;
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "RandomString.h"
+#include "PatternSet.h"
+#include "ahocorasick.h"
+
+/*
+ * Renumbers the states of finalized tries by sample texts, and compares the
+ * matches after it with the ones before it and with the plain search. A 
+ * search payload that is made before renumbering is used after it too.
+ */
+int main (int argc, char **argv)
+{
+    RandomString rs(1000, 3000, 8);
+    int j;
+    size_t i;
+    int options[5] = {AC_FINALIZE_DEFAULT, AC_FINALIZE_DFA, 
+            AC_FINALIZE_SPARSE, AC_FINALIZE_TRUNCATE, AC_FINALIZE_MINIMIZE};
+
+    std::cout << "Testing 'Optimize'" << std::endl;
+
+    for (j = 0; j < 1000; j++)
+    {
+        PatternSet ps;
+        std::string input = rs.roll().getString();
+        std::vector<std::string> samples;
+        std::vector<AC_TEXT_t> texts;
+
+        ps.fill(rs, rs.RandUInt(1, 100), 1, (j % 5 >= 3) ? 30 : 8);
+
+        for (i = 0; i < 4; i++)
+            samples.push_back(rs.roll().getString());
+        texts.resize(samples.size());
+        for (i = 0; i < samples.size(); i++)
+        {
+            texts[i].astring = samples[i].c_str();
+            texts[i].length = samples[i].size();
+        }
+
+        AC_TRIE_t *trie = ps.makeTrie();
+        ac_trie_finalize_opt (trie, options[j % 5]);
+
+        AC_SEARCH_PAYLOAD_t *payload = ac_search_payload_create(trie, "");
+        PatternMatches before = searchWhole(trie, input), after;
+        size_t half = input.size() / 2;
+
+        payload->text->astring = input.c_str();
+        payload->text->length = half;
+        ac_trie_search_thread_safe (trie, payload, 0, collectMatches, 
+                &after);
+
+        if (ac_trie_optimize(trie, texts.data(), texts.size()) != 0)
+        {
+            std::cout << std::endl << "Optimizing failed" << std::endl;
+            return -1;
+        }
+
+        /* The payload starts over at the rest of the text, as the state 
+         * it stopped at is renumbered */
+        PatternMatches expected = ps.find(input);
+        PatternMatches rest = ps.find(input.substr(half));
+
+        for (i = 0; i < rest.size(); i++)
+            rest[i].position += half;
+
+        after.clear();
+        payload->text->astring = input.c_str() + half;
+        payload->text->length = input.size() - half;
+        ac_trie_search_thread_safe (trie, payload, 1, collectMatches, 
+                &after);
+        ac_search_payload_release(payload);
+
+        if (!sameMatches(expected, before, "before") ||
+            !sameMatches(before, searchWhole(trie, input), "whole") ||
+            !sameMatches(before, searchChunks(trie, input, rs, 60), 
+                    "chunks") ||
+            !sameMatches(before, searchNext(trie, input), "findnext") ||
+            !sameMatches(rest, after, "old payload"))
+        {
+            std::cout << input << std::endl;
+            ac_trie_release (trie);
+            return -1;
+        }
+
+        ac_trie_release (trie);
+
+        if ((j + 1) % 50 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed" << std::endl;
+
+    return 0;
+}
@@ -6,7 +6,7 @@
 #include "ahocorasick.h"
 
 SearchResult findUsingAC (const std::set<std::string> &sampleChunks, 
-        const std::string &input);
+        const std::string &input, int options);
 
 SearchResult findUsingStr (const std::set<std::string> &sampleChunks, 
         const std::string &input);
@@ -16,6 +16,8 @@ int main (int argc, char **argv)
     std::set<std::string> sampleChunks;
     RandomString rs(100, 150, 4);
     int i, j;
+    int options[3] = {AC_FINALIZE_DEFAULT, AC_FINALIZE_DFA, 
+            AC_FINALIZE_SPARSE | AC_FINALIZE_NO_PREFILTER};
     
     // std::cout << rs << std::endl;
     // std::cout << rs.roll() << std::endl;
@@ -33,7 +35,8 @@ int main (int argc, char **argv)
         std::string input = rs.getString();
 
         SearchResult sr1 = findUsingStr(sampleChunks, input);
-        SearchResult sr2 = findUsingAC(sampleChunks, input);
+        SearchResult sr2 = findUsingAC(sampleChunks, input, 
+                options[j % 3]);
 
 
 
@@ -61,7 +64,7 @@ int main (int argc, char **argv)
 }
 
 SearchResult findUsingAC (const std::set<std::string> &sampleChunks, 
-        const std::string &input)
+        const std::string &input, int options)
 {
     SearchResult sr;
     unsigned int i = 0;
@@ -85,7 +88,7 @@ SearchResult findUsingAC (const std::set<std::string> &sampleChunks,
         
         // std::cout << *it << " Added Successfully" << std::endl;
     }
-    ac_trie_finalize (trie);
+    ac_trie_finalize_opt (trie, options);
     
     chunk.astring = input.c_str();
     chunk.length = input.size();
@@ -0,0 +1,128 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "RandomString.h"
+#include "PatternSet.h"
+#include "ahocorasick.h"
+
+bool checkAttached (const std::string &name, const PatternSet &ps,
+        const std::string &input, RandomString &rs);
+
+/*
+ * Shares finalized tries as shared memory objects and attaches to them, in
+ * this process and in a child one; the attached tries must match like the
+ * plain search. Sharing another trie under the same name leaves the tries
+ * already attached on the old one. After unsharing, the name can not be
+ * attached, while the attached tries keep working.
+ */
+int main (int argc, char **argv)
+{
+    RandomString rs(1000, 3000, 8);
+    std::ostringstream os;
+    int j, status;
+    pid_t child;
+    int options[3] = {AC_FINALIZE_DEFAULT, AC_FINALIZE_DFA,
+            AC_FINALIZE_MINIMIZE};
+
+    os << "/multifast_tstShare_" << getpid();
+    const std::string name = os.str();
+
+    std::cout << "Testing 'Share'" << std::endl;
+
+    for (j = 0; j < 60; j++)
+    {
+        PatternSet ps, next;
+
+        rs.roll();
+        ps.fill(rs, rs.RandUInt(1, 80), 1, AC_TRUNCATE_DEPTH + 10);
+        next.fill(rs, rs.RandUInt(1, 80), 1, AC_TRUNCATE_DEPTH + 10);
+        std::string input = ps.makeText(rs, 2000) + next.makeText(rs, 1000);
+
+        AC_TRIE_t *trie = ps.makeTrie();
+        if (ac_trie_share(trie, name.c_str()) != -1)
+        {
+            std::cout << "An open trie is shared" << std::endl;
+            return -1;
+        }
+        ac_trie_finalize_opt (trie, options[j % 3]);
+
+        if (ac_trie_share(trie, name.c_str()) != 0)
+        {
+            std::cout << "Sharing failed" << std::endl;
+            return -1;
+        }
+        ac_trie_release (trie);
+
+        /* Another process attaches to the trie */
+        if ((child = fork()) == 0)
+            _exit (checkAttached(name, ps, input, rs) ? 0 : 1);
+        if (child < 0 || waitpid(child, &status, 0) != child ||
+                !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            std::cout << "The child process failed" << std::endl;
+            return -1;
+        }
+
+        AC_TRIE_t *attached = ac_trie_attach(name.c_str(), j % 2);
+        if (!attached || !sameMatches(ps.find(input),
+                searchWhole(attached, input), "attached"))
+            return -1;
+
+        /* Share another trie under the same name */
+        trie = next.makeTrie();
+        ac_trie_finalize_opt (trie, options[j % 3]);
+        if (ac_trie_share(trie, name.c_str()) != 0 ||
+                !checkAttached(name, next, input, rs))
+        {
+            std::cout << "Sharing again failed" << std::endl;
+            return -1;
+        }
+        ac_trie_release (trie);
+
+        if (ac_trie_unshare(name.c_str()) != 0 ||
+                ac_trie_unshare(name.c_str()) != -1 ||
+                ac_trie_attach(name.c_str(), 0) != NULL)
+        {
+            std::cout << "Unsharing failed" << std::endl;
+            return -1;
+        }
+
+        if (!sameMatches(ps.find(input), searchPayload(attached, input,
+                rs, 50), "attached after unsharing"))
+            return -1;
+
+        ac_trie_release (attached);
+
+        if ((j + 1) % 3 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed" << std::endl;
+
+    return 0;
+}
+
+bool checkAttached (const std::string &name, const PatternSet &ps,
+        const std::string &input, RandomString &rs)
+{
+    AC_TRIE_t *trie = ac_trie_attach(name.c_str(), 1);
+    PatternMatches expected = ps.find(input);
+    bool same;
+
+    if (!trie)
+    {
+        std::cout << "Attaching failed" << std::endl;
+        return false;
+    }
+
+    same = sameMatches(expected, searchWhole(trie, input), "whole") &&
+        sameMatches(expected, searchChunks(trie, input, rs, 30), "chunks") &&
+        sameMatches(expected, searchPayload(trie, input, rs, 30), "payload");
+
+    ac_trie_release (trie);
+
+    return same;
+}
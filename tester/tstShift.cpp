@@ -0,0 +1,66 @@
+#include <iostream>
+#include <string>
+#include "RandomString.h"
+#include "PatternSet.h"
+#include "ahocorasick.h"
+
+/*
+ * Forces the Wu-Manber shift prefilter on long pattern sets, with the
+ * shortest pattern from 2 to 12 bytes long. The text is also searched in 
+ * chunks that are shorter than most patterns, so the matches cross the 
+ * chunk boundaries and the windows pass the end of the chunks.
+ */
+int main (int argc, char **argv)
+{
+    RandomString rs(3000, 8000, 26);
+    int j;
+    size_t minLen;
+    int options[3] = {AC_FINALIZE_SHIFT, AC_FINALIZE_SHIFT | AC_FINALIZE_DFA,
+            AC_FINALIZE_SHIFT | AC_FINALIZE_SPARSE};
+
+    std::cout << "Testing 'Shift'" << std::endl;
+
+    for (j = 0; j < 300; j++)
+    {
+        PatternSet ps;
+        std::string input = rs.roll().getString();
+
+        minLen = 2 + j % 11;
+        ps.fill(rs, rs.RandUInt(100, 1000), minLen, minLen + 20);
+
+        AC_TRIE_t *trie = ps.makeTrie();
+        ac_trie_finalize_opt (trie, options[j % 3]);
+
+        if (ac_trie_prefilter(trie) != AC_PREFILTER_SHIFT)
+        {
+            std::cout << std::endl << "The shift prefilter is not used"
+                    << std::endl;
+            ac_trie_release (trie);
+            return -1;
+        }
+
+        PatternMatches expected = ps.find(input);
+
+        if (!sameMatches(expected, searchWhole(trie, input), "whole") ||
+            !sameMatches(expected, searchChunks(trie, input, rs, 
+                    minLen + 1), "short chunks") ||
+            !sameMatches(expected, searchChunks(trie, input, rs, 300),
+                    "chunks") ||
+            !sameMatches(expected, searchPayload(trie, input, rs, 
+                    minLen + 1), "payload"))
+        {
+            std::cout << input << std::endl;
+            ac_trie_release (trie);
+            return -1;
+        }
+
+        ac_trie_release (trie);
+
+        if ((j + 1) % 10 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed" << std::endl;
+
+    return 0;
+}
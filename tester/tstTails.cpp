@@ -0,0 +1,89 @@
+#include <iostream>
+#include <string>
+#include <cctype>
+#include "RandomString.h"
+#include "PatternSet.h"
+#include "ahocorasick.h"
+
+std::string mixCase (const std::string &str, RandomString &rs);
+
+/*
+ * Truncates tries with patterns longer than AC_TRUNCATE_DEPTH, so most of
+ * them are tail patterns. The text is made of whole patterns, of their 
+ * prefixes, which fail in the middle of the tails, and of random letters;
+ * it is searched whole and in chunks that split the tails. Every other trie
+ * is mapped, with the patterns and the text in mixed case.
+ */
+int main (int argc, char **argv)
+{
+    RandomString rs(2000, 3000, 4);
+    unsigned char map[AC_MAP_SIZE];
+    int j;
+    size_t i;
+
+    for (i = 0; i < AC_MAP_SIZE; i++)
+        map[i] = (unsigned char) toupper((int) i);
+
+    std::cout << "Testing 'Tails'" << std::endl;
+
+    for (j = 0; j < 1000; j++)
+    {
+        bool mapped = (j % 2 == 1);
+        PatternSet ps(mapped ? map : NULL);
+
+        rs.roll();
+        for (i = rs.RandUInt(1, 60); i > 0; i--)
+        {
+            std::string patt = rs.getFactor(1, AC_TRUNCATE_DEPTH + 40);
+            ps.add(mapped ? mixCase(patt, rs) : patt);
+        }
+
+        std::string input = ps.makeText(rs, 3000);
+        if (mapped)
+            input = mixCase(input, rs);
+
+        AC_TRIE_t *trie = ps.makeTrie();
+        ac_trie_finalize_opt (trie, AC_FINALIZE_TRUNCATE | 
+                ((j % 4 < 2) ? AC_FINALIZE_SPARSE : AC_FINALIZE_DFA));
+
+        /* The payload is searched twice, to see it starts over */
+        AC_SEARCH_PAYLOAD_t *payload = ac_search_payload_create(trie, "");
+        PatternMatches expected = ps.find(input);
+
+        if (!sameMatches(expected, searchWhole(trie, input), "whole") ||
+            !sameMatches(expected, searchChunks(trie, input, rs, 
+                    AC_TRUNCATE_DEPTH), "chunks") ||
+            !sameMatches(expected, searchNext(trie, input), "findnext") ||
+            !sameMatches(expected, searchPayload(trie, input, rs, 
+                    AC_TRUNCATE_DEPTH, payload), "payload") ||
+            !sameMatches(expected, searchPayload(trie, input, rs, 
+                    100, payload), "payload again"))
+        {
+            std::cout << input << std::endl;
+            ac_search_payload_release(payload);
+            ac_trie_release (trie);
+            return -1;
+        }
+
+        ac_search_payload_release(payload);
+        ac_trie_release (trie);
+
+        if ((j + 1) % 50 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed" << std::endl;
+
+    return 0;
+}
+
+std::string mixCase (const std::string &str, RandomString &rs)
+{
+    std::string result(str);
+
+    for (size_t i = 0; i < result.size(); i++)
+        if (rs.RandUInt(0, 1))
+            result[i] = (char) tolower((unsigned char) result[i]);
+
+    return result;
+}
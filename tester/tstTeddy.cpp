@@ -0,0 +1,76 @@
+#include <iostream>
+#include <string>
+#include "RandomString.h"
+#include "PatternSet.h"
+#include "ahocorasick.h"
+
+/*
+ * Forces the Teddy prefilter: more start bytes than the byte scanner takes,
+ * a few tens of short patterns, and no more than SKIP_TEDDY_MAX_PATTERNS.
+ * The matches must be the ones of the plain search, whole, in chunks, by
+ * findnext and through a payload. Where the CPU has SSSE3, every trie must
+ * be prefiltered by Teddy.
+ */
+int main (int argc, char **argv)
+{
+    RandomString rs(2000, 6000, 26);
+    int j, teddy = 0;
+    int options[2] = {AC_FINALIZE_DEFAULT, AC_FINALIZE_SPARSE};
+    bool supported = false;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+        defined(__SSE2__)
+    __builtin_cpu_init ();
+    supported = __builtin_cpu_supports ("ssse3");
+#endif
+
+    std::cout << "Testing 'Teddy'" << std::endl;
+
+    for (j = 0; j < 2000; j++)
+    {
+        PatternSet ps;
+        std::string input = rs.roll().getString();
+
+        ps.fill(rs, rs.RandUInt(8, 80), 2, 6);
+
+        AC_TRIE_t *trie = ps.makeTrie();
+        ac_trie_finalize_opt (trie, options[j % 2]);
+
+        if (ac_trie_prefilter(trie) == AC_PREFILTER_TEDDY)
+            teddy++;
+        else if (supported)
+        {
+            std::cout << std::endl << "Teddy is not chosen for "
+                    << ps.size() << " patterns" << std::endl;
+            ac_trie_release (trie);
+            return -1;
+        }
+
+        PatternMatches expected = ps.find(input);
+
+        if (!sameMatches(expected, searchWhole(trie, input), "whole") ||
+            !sameMatches(expected, searchChunks(trie, input, rs, 40),
+                    "chunks") ||
+            !sameMatches(expected, searchNext(trie, input), "findnext") ||
+            !sameMatches(expected, searchPayload(trie, input, rs, 40),
+                    "payload"))
+        {
+            std::cout << input << std::endl;
+            ac_trie_release (trie);
+            return -1;
+        }
+
+        ac_trie_release (trie);
+
+        if ((j + 1) % 100 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed, " << teddy << " by Teddy";
+    if (!supported)
+        std::cout << " (Teddy is not supported on this CPU; the start"
+                " bytes scanner was tested)";
+    std::cout << std::endl;
+
+    return 0;
+}
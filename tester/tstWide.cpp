@@ -0,0 +1,422 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <stdint.h>
+#include "RandomString.h"
+#include "PatternSet.h"
+#include "ahocorasick.h"
+
+/*
+ * The wide patterns of a test and the plain search of them; the id of a
+ * pattern is its index, as in PatternSet
+ */
+template <typename T>
+struct WideSet
+{
+    typedef std::vector<T> Symbols;
+
+    long add (const Symbols &pattern);
+    PatternMatches find (const Symbols &text) const;
+
+    std::vector<Symbols> patterns;
+    std::vector<bool> present;
+    std::set<Symbols> keys;
+};
+
+/*
+ * The matches that a search reports; the patterns must be reported with
+ * their symbols
+ */
+template <typename T>
+struct WideFound
+{
+    const WideSet<T> *set;
+    PatternMatches matches;
+    bool decoded;
+    size_t stopAfter;
+};
+
+template <typename T>
+bool testWidth (RandomString &rs, int option, unsigned int alphabet,
+        size_t maxLen);
+template <typename T>
+T symbolOf (unsigned int k);
+template <typename T>
+std::vector<T> makeSymbols (RandomString &rs, unsigned int alphabet,
+        size_t length);
+template <typename T>
+bool checkTrie (AC_TRIE_t *trie, const WideSet<T> &ws, RandomString &rs,
+        unsigned int alphabet, const std::string &what);
+template <typename T>
+int collectWide (AC_MATCH_t *m, void *param);
+bool checkRefusals (void);
+
+/*
+ * Searches tries of 8, 16 and 32-bit symbols, with the engines, the tails
+ * and the minimized tails. The symbol sets are small enough for the single
+ * byte codes, or so big that the codes of the symbols take two and three
+ * bytes; the 32-bit symbols are spread over the whole range, so they are
+ * hashed. The matches must be those of the plain search of the symbols,
+ * with the symbols of the patterns, searched whole and in chunks. Then
+ * patterns of new symbols too are added to and removed from the finalized
+ * tries, and the tries are searched again after finalizing them.
+ */
+int main (int argc, char **argv)
+{
+    RandomString rs(1000, 3000, 8);
+    int j;
+    int options[6] = {AC_FINALIZE_DEFAULT, AC_FINALIZE_DFA,
+            AC_FINALIZE_SHIFT, AC_FINALIZE_SPARSE | AC_FINALIZE_NO_PREFILTER,
+            AC_FINALIZE_TRUNCATE, AC_FINALIZE_MINIMIZE};
+    unsigned int alphabets[3] = {4, 100, 3000};
+
+    std::cout << "Testing 'Wide'" << std::endl;
+
+    if (!checkRefusals())
+        return -1;
+
+    for (j = 0; j < 360; j++)
+    {
+        int option = options[j % 6];
+        unsigned int alphabet = alphabets[(j / 6) % 3];
+        size_t maxLen = (j % 6 >= 4) ? AC_TRUNCATE_DEPTH + 8 : 10;
+
+        rs.roll();
+
+        if (!testWidth<uint8_t>(rs, option, std::min(alphabet, 256u),
+                maxLen) ||
+            !testWidth<uint16_t>(rs, option, alphabet, maxLen) ||
+            !testWidth<uint32_t>(rs, option, alphabet, maxLen))
+        {
+            std::cout << "option " << option << ", alphabet " << alphabet
+                    << std::endl;
+            return -1;
+        }
+
+        if ((j + 1) % 30 == 0)
+            std::cout << "." << std::flush;
+    }
+
+    std::cout << " " << j << " Passed" << std::endl;
+
+    return 0;
+}
+
+/*
+ * Builds a trie of the width of T, searches it, changes it after
+ * finalizing and searches it again
+ */
+template <typename T>
+bool testWidth (RandomString &rs, int option, unsigned int alphabet,
+        size_t maxLen)
+{
+    WideSet<T> ws;
+    AC_TRIE_t *trie = ac_trie_create_wide (sizeof(T));
+    AC_PATTID_t id;
+    size_t i, count;
+    int round;
+    long k;
+
+    id.type = AC_PATTID_TYPE_NUMBER;
+
+    for (count = rs.RandUInt(1, alphabet > 100 ? 600 : 100); count > 0;
+            count--)
+    {
+        std::vector<T> patt = makeSymbols<T>(rs, alphabet,
+                rs.RandUInt(1, maxLen));
+        AC_STATUS_t expected = ACERR_DUPLICATE_PATTERN;
+
+        if ((k = ws.add(patt)) >= 0)
+            expected = ACERR_SUCCESS;
+        id.u.number = k;
+
+        if (ac_trie_add_wide (trie, &patt[0], patt.size(), id) != expected)
+        {
+            std::cout << std::endl << "Adding a pattern of " << patt.size()
+                    << " symbols did not return " << expected << std::endl;
+            return false;
+        }
+    }
+
+    ac_trie_finalize_opt (trie, option);
+
+    if (!checkTrie(trie, ws, rs, alphabet, "finalized"))
+        return false;
+
+    for (round = 0; round < 2; round++)
+    {
+        /* A few patterns, or as many as the trie has, to make the delta
+         * merge; some of them have symbols that the trie did not have */
+        for (count = rs.RandUInt(0, 4) ? rs.RandUInt(1, 10) :
+                rs.RandUInt(100, 1000); count > 0; count--)
+        {
+            std::vector<T> patt = makeSymbols<T>(rs, alphabet + 50,
+                    rs.RandUInt(1, maxLen));
+
+            if ((k = ws.add(patt)) < 0)
+                continue;
+            id.u.number = k;
+            if (ac_trie_add_wide (trie, &patt[0], patt.size(), id) !=
+                    ACERR_SUCCESS)
+            {
+                std::cout << std::endl << "Adding pattern " << k 
+                        << " failed" << std::endl;
+                return false;
+            }
+        }
+
+        for (i = 0; i < ws.patterns.size(); i++)
+        {
+            if (!ws.present[i] || rs.RandUInt(0, 4))
+                continue;
+            const std::vector<T> &patt = ws.patterns[i];
+            if (ac_trie_remove_wide (trie, &patt[0], patt.size()) !=
+                    ACERR_SUCCESS)
+            {
+                std::cout << std::endl << "Removing pattern " << i 
+                        << " failed" << std::endl;
+                return false;
+            }
+            ws.present[i] = false;
+            ws.keys.erase(patt);
+            if (ac_trie_remove_wide (trie, &patt[0], patt.size()) !=
+                    ACERR_PATTERN_NOT_FOUND)
+            {
+                std::cout << std::endl << "Pattern " << i 
+                        << " is removed twice" << std::endl;
+                return false;
+            }
+        }
+
+        ac_trie_finalize (trie);
+
+        if (!checkTrie(trie, ws, rs, alphabet + 50, "finalized again"))
+            return false;
+    }
+
+    ac_trie_release (trie);
+
+    return true;
+}
+
+/*
+ * The symbol of the given number; the 16 and 32-bit symbols are spread
+ * over their range
+ */
+template <typename T>
+T symbolOf (unsigned int k)
+{
+    if (sizeof(T) == 1)
+        return (T) k;
+    if (sizeof(T) == 2)
+        return (T) (k * 40503u);
+    return (T) (k * 2654435761u);
+}
+
+template <typename T>
+std::vector<T> makeSymbols (RandomString &rs, unsigned int alphabet,
+        size_t length)
+{
+    std::vector<T> symbols;
+
+    /* The 8-bit symbols can not go beyond 256 */
+    if (sizeof(T) == 1 && alphabet > 256)
+        alphabet = 256;
+
+    for (size_t i = 0; i < length; i++)
+        symbols.push_back(symbolOf<T>(rs.RandUInt(0, alphabet - 1)));
+
+    return symbols;
+}
+
+/*
+ * Compares the matches of the trie with the plain search, on a text of the
+ * patterns and of the symbols of the patterns and of no pattern. Then the
+ * search is stopped on a match, and the next one must start over.
+ */
+template <typename T>
+bool checkTrie (AC_TRIE_t *trie, const WideSet<T> &ws, RandomString &rs,
+        unsigned int alphabet, const std::string &what)
+{
+    std::vector<T> text;
+    WideFound<T> whole, chunks, stopped;
+    size_t length = rs.RandUInt(0, 3) ? 1000 : 10000, offset, size;
+    int keep = 0;
+
+    while (text.size() < length)
+    {
+        long k = rs.RandUInt(0, ws.patterns.size() - 1);
+
+        if (rs.RandUInt(0, 1) && ws.present[k])
+            text.insert(text.end(), ws.patterns[k].begin(),
+                    ws.patterns[k].end());
+        else
+        {
+            std::vector<T> other = makeSymbols<T>(rs, alphabet + 10,
+                    rs.RandUInt(1, 10));
+            text.insert(text.end(), other.begin(), other.end());
+        }
+    }
+
+    PatternMatches expected = ws.find(text);
+
+    whole.set = chunks.set = stopped.set = &ws;
+    whole.decoded = chunks.decoded = stopped.decoded = true;
+    whole.stopAfter = chunks.stopAfter = (size_t) -1;
+    stopped.stopAfter = 0;
+
+    if (ac_trie_search_wide (trie, &text[0], text.size(), 0,
+            collectWide<T>, &whole) != 0)
+    {
+        std::cout << std::endl << what << ": the search failed" << std::endl;
+        return false;
+    }
+
+    for (offset = 0; offset < text.size(); offset += size)
+    {
+        size = std::min((size_t) rs.RandUInt(1, 3000),
+                text.size() - offset);
+        ac_trie_search_wide (trie, &text[offset], size, keep,
+                collectWide<T>, &chunks);
+        keep = 1;
+    }
+
+    /* The stopped search leaves nothing behind */
+    if (ac_trie_search_wide (trie, &text[0], text.size(), 0,
+            collectWide<T>, &stopped) != (expected.empty() ? 0 : 1))
+    {
+        std::cout << std::endl << what << ": the search did not stop"
+                << std::endl;
+        return false;
+    }
+    stopped.matches.clear();
+    stopped.stopAfter = (size_t) -1;
+    ac_trie_search_wide (trie, &text[0], text.size(), 1, collectWide<T>,
+            &stopped);
+
+    if (!whole.decoded || !chunks.decoded || !stopped.decoded)
+    {
+        std::cout << std::endl << what << ": a pattern is reported with "
+                "other symbols" << std::endl;
+        return false;
+    }
+
+    if (!sameMatches(expected, whole.matches, what) ||
+        !sameMatches(expected, chunks.matches, what + " in chunks") ||
+        !sameMatches(expected, stopped.matches, what + " after a stop"))
+        return false;
+
+    return true;
+}
+
+template <typename T>
+int collectWide (AC_MATCH_t *m, void *param)
+{
+    WideFound<T> *found = (WideFound<T> *) param;
+
+    for (size_t j = 0; j < m->size; j++)
+    {
+        const AC_PATTERN_t &patt = m->patterns[j];
+        const T *symbols = (const T *) patt.ptext.astring;
+        const std::vector<T> &added = found->set->patterns[patt.id.u.number];
+
+        if (patt.ptext.length != added.size() ||
+                !std::equal(added.begin(), added.end(), symbols))
+            found->decoded = false;
+
+        found->matches.push_back(PatternMatch(m->position,
+                patt.id.u.number));
+    }
+
+    return found->matches.size() > found->stopAfter;
+}
+
+template <typename T>
+long WideSet<T>::add (const Symbols &pattern)
+{
+    if (!keys.insert(pattern).second)
+        return -1;
+
+    patterns.push_back(pattern);
+    present.push_back(true);
+
+    return patterns.size() - 1;
+}
+
+template <typename T>
+PatternMatches WideSet<T>::find (const Symbols &text) const
+{
+    PatternMatches result;
+    std::vector<std::pair<size_t, long> > ending;
+
+    for (size_t end = 1; end <= text.size(); end++)
+    {
+        ending.clear();
+
+        for (size_t i = 0; i < patterns.size(); i++)
+        {
+            size_t len = patterns[i].size();
+
+            if (present[i] && len <= end && std::equal(patterns[i].begin(),
+                    patterns[i].end(), text.begin() + (end - len)))
+                ending.push_back(std::make_pair(len, (long) i));
+        }
+
+        std::sort(ending.rbegin(), ending.rend());
+
+        for (size_t k = 0; k < ending.size(); k++)
+            result.push_back(PatternMatch(end, ending[k].second));
+    }
+
+    return result;
+}
+
+/*
+ * The byte functions refuse the wide tries, and the wide ones the byte
+ * tries
+ */
+bool checkRefusals (void)
+{
+    AC_TRIE_t *wide = ac_trie_create_wide (2);
+    AC_TRIE_t *bytes = ac_trie_create ();
+    AC_PATTERN_t patt;
+    AC_PATTID_t id;
+    AC_TEXT_t text;
+    uint16_t symbols[2] = {'a', 'b'};
+    bool refused;
+
+    patt.ptext.astring = "ab";
+    patt.ptext.length = 2;
+    patt.rtext.astring = NULL;
+    patt.rtext.length = 0;
+    patt.id.u.number = 0;
+    patt.id.type = AC_PATTID_TYPE_NUMBER;
+    id = patt.id;
+    text = patt.ptext;
+
+    ac_trie_add (bytes, &patt, 0);
+    ac_trie_add_wide (wide, symbols, 2, id);
+    ac_trie_finalize (bytes);
+    ac_trie_finalize (wide);
+
+    refused = ac_trie_create_wide (3) == NULL &&
+            ac_trie_add (wide, &patt, 0) == ACERR_TRIE_CLOSED &&
+            ac_trie_remove (wide, &patt) == ACERR_TRIE_CLOSED &&
+            ac_trie_search (wide, &text, 0, collectMatches, NULL) == -1 &&
+            ac_trie_compact (wide) == NULL &&
+            ac_trie_add_wide (bytes, symbols, 2, id) == ACERR_TRIE_CLOSED &&
+            ac_trie_remove_wide (bytes, symbols, 2) == ACERR_TRIE_CLOSED &&
+            ac_trie_search_wide (bytes, symbols, 2, 0, collectMatches,
+                    NULL) == -1;
+
+    ac_trie_release (wide);
+    ac_trie_release (bytes);
+
+    if (!refused)
+        std::cout << "A byte trie takes a wide call, or the other way round"
+                << std::endl;
+
+    return refused;
+}